@@ -8,8 +8,14 @@
 SOURCES+=\
 	$(wildcard $(CY_AFR_ROOT)/freertos_kernel/*.c)\
 	$(wildcard $(CY_AFR_ROOT)/freertos_kernel/portable/$(CY_AFR_TOOLCHAIN)/ARM_CM4F/*.c)\
-	$(wildcard $(CY_AFR_ROOT)/freertos_kernel/portable/$(CY_AFR_TOOLCHAIN)/ARM_CM4F/*.s)\
+	$(wildcard $(CY_AFR_ROOT)/freertos_kernel/portable/$(CY_AFR_TOOLCHAIN)/ARM_CM4F/*.s)
+
+# With APP_HEAP=1 the heap of the application (source/heap_operation.c)
+# provides pvPortMalloc and vPortFree instead of heap_3.c
+ifeq ($(filter APP_HEAP=1,$(DEFINES)),)
+SOURCES+=\
 	$(CY_AFR_ROOT)/freertos_kernel/portable/MemMang/heap_3.c
+endif
 
 INCLUDES+=\
 	$(CY_AFR_ROOT)/freertos_kernel\
@@ -7,6 +7,7 @@
 *******************************************************************************
 * $ Copyright 2020-2021 Cypress Semiconductor $
 *******************************************************************************/
+#include <stddef.h>
 #include "cyhal.h"
 #include "cybsp.h"
 #include "FreeRTOS.h"
@@ -16,6 +17,11 @@
 #include "GUI.h"
 #include "afe_shield_operation.h"
 #include "display_interface.h"
+#include "history_operation.h"
+#include "fleet_operation.h"
+#include "notify_operation.h"
+#include "i2c_operation.h"
+#include "filter_operation.h"
 
 /***************************************
 *            Defines
@@ -35,182 +41,232 @@
 #define ALL_MASK                                (0x0F)
 #define CHANGE_IN_THING_NUM_ON_BTN3_PRESS                 (10)
 
-/* Thread delays */
+/* Thread delays, the periods of the subscribers are multiples of the
+ * polling period */
+#define AFE_POLLING_PERIOD_MS                   (100)
 #define WEATHER_DATA_POLLING_PERIOD_MS          (500)
 #define CAPSENSE_DATA_POLLING_PERIOD_MS         (100)
+#define AFE_SUBSCRIBERS                         (sizeof(afe_subscribers) / sizeof(afe_subscribers[0]))
 
 /* Strings size to hold the results to print */
 #define RESULT_STRING_SIZE                      (30)
 
+/* Alerting things listed on the fleet summary */
+#define DISPLAY_ALERT_THINGS                    (4)
+
+/* Lines of the display, as bits of the lines to redraw */
+#define LINE_TITLE                              (1u << 0)
+#define LINE_IP                                 (1u << 1)
+#define LINE_TEMPERATURE                        (1u << 2)
+#define LINE_HUMIDITY                           (1u << 3)
+#define LINE_LIGHT                              (1u << 4)
+#define LINE_ALL                                (0x1Fu)
+
+/***************************************
+*            Types
+****************************************/
+/* Register window of the PSoC from TOUCH_BUTTON_OFFSET_REG on, the CapSense
+ * buttons and then the weather data */
+typedef struct {
+    uint8_t buttons;
+    float temp;
+    float humidity;
+    float light;
+} __attribute__((packed)) afe_registers_t;
+
+_Static_assert(offsetof(afe_registers_t, temp) == (WEATHER_DATA_OFFSET_REG - TOUCH_BUTTON_OFFSET_REG),
+               "The weather data has to follow the CapSense buttons");
+
+/* User of the registers, called every period_ms */
+typedef struct {
+    void (*handler)(const afe_registers_t *registers);
+    uint32_t period_ms;
+} afe_subscriber_t;
+
 /***************************************
 *          Global Variables
 ****************************************/
 volatile uint8_t disp_thing = MY_THING;  /* Which thing to display data for, on the OLED */
+volatile bool disp_fleet = false;        /* Show the fleet summary instead of a thing, on the OLED */
 
-/*************** Weather Data Acquisition Thread ***************/
+/*************** Weather Data Handler ***************/
 /*
- * Summary: Thread to read temperature, humidity, and light from
- * the PSoC analog Co-processor
+ * Summary: Store temperature, humidity, and light from the PSoC analog
+ * Co-processor as the data of my thing
  *
- *  @param[in] arg argument for the thread
+ *  @param[in] registers The registers read from the PSoC
  *
  */
-void getWeatherDataThread(void* arg)
+static void handle_weather_data(const afe_registers_t *registers)
 {
-    ( void )arg; /* Suppress compiler warning */
-
-    /* Weather data from the PSoC Analog Co-processor  */
-    struct {
-        float temp;
-        float humidity;
-        float light;
-    } __attribute__((packed)) weather_data;
-
     /* Variables to remember previous values */
-    static float tempPrev = 0;
-    static float humPrev = 0;
-    static float lightPrev = 0;
+    static int16_t tempPrev = 0;
+    static int16_t humPrev = 0;
+    static int16_t lightPrev = 0;
+    int16_t temp;
+    int16_t humidity;
+    int16_t light;
+    uint32_t changed;
+
+    /* Filter the weather data, so jitter doesn't reach the display and MQTT */
+    temp =     filter_apply(IOT_TEMPERATURE, iot_data_to_fixed(registers->temp, IOT_TEMPERATURE_SCALE));
+    humidity = filter_apply(IOT_HUMIDITY, iot_data_to_fixed(registers->humidity, IOT_HUMIDITY_SCALE));
+    light =    filter_apply(IOT_LIGHT, iot_data_to_fixed(registers->light, IOT_LIGHT_SCALE));
+
+    /* Copy weather data into my thing's data structure */
+    iot_data_write_begin(MY_THING);
+    iot_fleet.temp[MY_THING] =     temp;
+    iot_fleet.humidity[MY_THING] = humidity;
+    iot_fleet.light[MY_THING] =    light;
+    iot_data_write_end(MY_THING);
+    history_append(MY_THING, iot_fleet.temp[MY_THING], iot_fleet.humidity[MY_THING], iot_fleet.light[MY_THING]);
+
+    /* Look at weather data - only notify the fields that have changed */
+    changed = 0;
+    if(tempPrev != iot_fleet.temp[MY_THING])
+    {
+        tempPrev = iot_fleet.temp[MY_THING];
+        changed |= NOTIFY_TEMPERATURE;
+    }
+    if(humPrev != iot_fleet.humidity[MY_THING])
+    {
+        humPrev = iot_fleet.humidity[MY_THING];
+        changed |= NOTIFY_HUMIDITY;
+    }
+    if(lightPrev != iot_fleet.light[MY_THING])
+    {
+        lightPrev = iot_fleet.light[MY_THING];
+        changed |= NOTIFY_LIGHT;
+    }
+    if(changed != 0)
+    {
+        notify_publish(MY_THING, changed);
+    }
+}
 
-    /* Buffer to set the offset */
-    uint8_t offset = WEATHER_DATA_OFFSET_REG;
+/*************** CapSense Button Handler ***************/
+/* Summary: Change the screen of the OLED on CapSense button presses
+ *
+ *  @param[in] registers The registers read from the PSoC
+ *
+ */
+static void handle_capsense(const afe_registers_t *registers)
+{
+    static bool buttonPressed = false;
+    uint8_t capSenseValues = registers->buttons;
 
-    while(1)
+    /* Look for CapSense button presses */
+    if(buttonPressed == false) /* Only look for new button presses */
     {
-        /* Get I2C data - use a Mutex to prevent conflicts */
-        xSemaphoreTake( i2c_mutex, portMAX_DELAY);
-
-        /* Set the offset */
-        cyhal_i2c_master_write(&afe_shield_i2c_obj,
-                               SHIELD_PSOC_I2C_ADDRESS,
-                               &offset, sizeof(offset),
-                               0,
-                               true);
-
-        /* Get data */
-        cyhal_i2c_master_read(&afe_shield_i2c_obj,
-                              SHIELD_PSOC_I2C_ADDRESS,
-                              (uint8_t *)&weather_data,
-                              sizeof(weather_data),
-                              0,
-                              true);
-
-        xSemaphoreGive(i2c_mutex);
-
-        /* Copy weather data into my thing's data structure */
-        iot_data[MY_THING].temp =     weather_data.temp;
-        iot_data[MY_THING].humidity = weather_data.humidity;
-        iot_data[MY_THING].light =    weather_data.light;
-
-        /* Look at weather data - only update display if a value has changed*/
-        if((tempPrev != iot_data[MY_THING].temp)    ||
-           (humPrev != iot_data[MY_THING].humidity) ||
-           (lightPrev != iot_data[MY_THING].light))
+        /* Any button leaves the fleet summary */
+        if((capSenseValues & ALL_MASK) != 0)
         {
-            /* Save the new values as previous for next time around */
-            tempPrev  = iot_data[MY_THING].temp;
-            humPrev   = iot_data[MY_THING].humidity;
-            lightPrev = iot_data[MY_THING].light;
-
-            /* Set a semaphore for the OLED to update the display */
-            xSemaphoreGive(display_semaphore);
+            disp_fleet = false;
         }
-
-        vTaskDelay(pdMS_TO_TICKS(WEATHER_DATA_POLLING_PERIOD_MS));
+        /* Button 0 goes to the local thing's screen */
+        if((capSenseValues & TOUCH_BTN0_MASK) == TOUCH_BTN0_MASK)
+        {
+            buttonPressed = true;
+            disp_thing = MY_THING;
+            notify_publish(NOTIFY_NO_THING, NOTIFY_VIEW);
+        }
+        /* Button 1 goes to next thing's screen */
+        if((capSenseValues & TOUCH_BTN1_MASK) == TOUCH_BTN1_MASK)
+        {
+            buttonPressed = true;
+            if(disp_thing == 0) /* Handle wrap-around case */
+            {
+                disp_thing = MAX_THING;
+            }
+            else
+            {
+                disp_thing--;
+            }
+            notify_publish(NOTIFY_NO_THING, NOTIFY_VIEW);
+        }
+        /* Button 2 goes to previous thing's screen */
+        if((capSenseValues & TOUCH_BTN2_MASK) == TOUCH_BTN2_MASK)
+        {
+            buttonPressed = true;
+            disp_thing++;
+            if(disp_thing > MAX_THING) /* Handle wrap-around case */
+            {
+                disp_thing = 0;
+            }
+            notify_publish(NOTIFY_NO_THING, NOTIFY_VIEW);
+        }
+        /* Button 3 increments by 10 things */
+        if((capSenseValues & TOUCH_BTN3_MASK) == TOUCH_BTN3_MASK)
+        {
+            buttonPressed = true;
+            disp_thing += CHANGE_IN_THING_NUM_ON_BTN3_PRESS;
+            if(disp_thing > MAX_THING) /* Handle wrap-around case */
+            {
+                disp_thing -= (MAX_THING + 1);
+            }
+            notify_publish(NOTIFY_NO_THING, NOTIFY_VIEW);
+        }
+    }
+    if((capSenseValues & ALL_MASK) == 0) /* All buttons released */
+    {
+        buttonPressed = false;
     }
 }
 
-/*************** CapSense Button Monitor Thread ***************/
-/* Summary: Thread to read CapSense button values
+/* Users of the registers of the PSoC and how often they want them */
+static const afe_subscriber_t afe_subscribers[] =
+{
+    { handle_capsense,      CAPSENSE_DATA_POLLING_PERIOD_MS },
+    { handle_weather_data,  WEATHER_DATA_POLLING_PERIOD_MS },
+};
+
+/*************** AFE Acquisition Thread ***************/
+/*
+ * Summary: Thread to read the CapSense buttons and the temperature, humidity,
+ * and light from the PSoC analog Co-processor in one I2C transaction and hand
+ * them to the subscribers that are due
  *
  *  @param[in] arg argument for the thread
  *
  */
-void getCapSenseThread(void* arg)
+void afeThread(void* arg)
 {
     ( void )arg; /* Suppress compiler warning */
 
-    uint8_t capSenseValues = 0;
-    bool buttonPressed = false;
+    afe_registers_t registers;
+    uint32_t poll = 0;
+    bool result;
+    uint8_t loop;
 
-    /* Buffer to set the offset */
+    /* Buffer to set the offset - the buttons come right before the weather data */
     uint8_t offset = TOUCH_BUTTON_OFFSET_REG;
 
     while(1)
     {
-        /* Get I2C data - use a Mutex to prevent conflicts */
-        xSemaphoreTake( i2c_mutex, portMAX_DELAY);
-
-        /* Set the offset */
-        cyhal_i2c_master_write(&afe_shield_i2c_obj,
-                               SHIELD_PSOC_I2C_ADDRESS,
-                               &offset,
-                               sizeof(offset),
-                               0,
-                               true);
-
-        /* Get data */
-        cyhal_i2c_master_read(&afe_shield_i2c_obj,
-                              SHIELD_PSOC_I2C_ADDRESS,
-                              &capSenseValues,
-                              sizeof(capSenseValues),
-                              0,
-                              true);
-
-        xSemaphoreGive(i2c_mutex);
-
-        /* Look for CapSense button presses */
-        if(buttonPressed == false) /* Only look for new button presses */
+        /* Get I2C data - lock the bus to prevent conflicts */
+        i2c_lock(I2C_CLIENT_AFE);
+
+        /* Set the offset and read the whole window after a repeated start */
+        result = i2c_transfer(SHIELD_PSOC_I2C_ADDRESS,
+                              &offset, sizeof(offset),
+                              (uint8_t *)&registers, sizeof(registers));
+
+        i2c_unlock(I2C_CLIENT_AFE);
+
+        /* Hand the registers to the subscribers that are due */
+        if(result)
         {
-            /* Button 0 goes to the local thing's screen */
-            if((capSenseValues & TOUCH_BTN0_MASK) == TOUCH_BTN0_MASK)
-            {
-                buttonPressed = true;
-                disp_thing = MY_THING;
-                xSemaphoreGive(display_semaphore);
-            }
-            /* Button 1 goes to next thing's screen */
-            if((capSenseValues & TOUCH_BTN1_MASK) == TOUCH_BTN1_MASK)
-            {
-                buttonPressed = true;
-                if(disp_thing == 0) /* Handle wrap-around case */
-                {
-                    disp_thing = MAX_THING;
-                }
-                else
-                {
-                    disp_thing--;
-                }
-                xSemaphoreGive(display_semaphore);
-            }
-            /* Button 2 goes to previous thing's screen */
-            if((capSenseValues & TOUCH_BTN2_MASK) == TOUCH_BTN2_MASK)
-            {
-                buttonPressed = true;
-                disp_thing++;
-                if(disp_thing > MAX_THING) /* Handle wrap-around case */
-                {
-                    disp_thing = 0;
-                }
-                xSemaphoreGive(display_semaphore);
-            }
-            /* Button 3 increments by 10 things */
-            if((capSenseValues & TOUCH_BTN3_MASK) == TOUCH_BTN3_MASK)
+            for(loop = 0; loop < AFE_SUBSCRIBERS; loop++)
             {
-                buttonPressed = true;
-                disp_thing += CHANGE_IN_THING_NUM_ON_BTN3_PRESS;
-                if(disp_thing > MAX_THING) /* Handle wrap-around case */
+                if((poll % (afe_subscribers[loop].period_ms / AFE_POLLING_PERIOD_MS)) == 0)
                 {
-                    disp_thing -= (MAX_THING + 1);
+                    afe_subscribers[loop].handler(&registers);
                 }
-                xSemaphoreGive(display_semaphore);
             }
         }
-        if((capSenseValues & ALL_MASK) == 0) /* All buttons released */
-        {
-            buttonPressed = false;
-        }
+        poll++;
 
-         vTaskDelay(pdMS_TO_TICKS(CAPSENSE_DATA_POLLING_PERIOD_MS));
+        vTaskDelay(pdMS_TO_TICKS(AFE_POLLING_PERIOD_MS));
     }
 }
 
@@ -230,42 +286,123 @@ void displayThread(void* arg)
     char temp_str[RESULT_STRING_SIZE];
     char humidity_str[RESULT_STRING_SIZE];
     char light_str[RESULT_STRING_SIZE];
+    char ip_str[RESULT_STRING_SIZE];
+    iot_data_t thing;
+    fleet_summary_t fleet;
+    notify_changes_t changes;
+    uint8_t lines = LINE_ALL;   /* Draw everything the first time */
+    int line_height;
+    uint8_t alert_thing;
+    uint8_t loop;
+    int length;
+
+    /* Hear about all changes */
+    int8_t subscriber = notify_subscribe(NOTIFY_ALL_FIELDS);
+    configASSERT(subscriber >= 0);
 
     /* Clear screen, set font size, background color, and text mode */
+    i2c_lock(I2C_CLIENT_DISPLAY);
     GUI_Clear();
+    i2c_unlock(I2C_CLIENT_DISPLAY);
     GUI_SetFont(GUI_FONT_13_1);
     GUI_SetBkColor(GUI_BLACK);
     GUI_SetColor(GUI_WHITE);
     GUI_SetTextMode(GUI_TM_NORMAL);
+    line_height = GUI_GetFontDistY();
 
     while(1)
     {
-        /* Wait until new data is ready to display */
-        xSemaphoreTake( display_semaphore, portMAX_DELAY);
-
         /* Set UTF8 character display */
         GUI_UC_SetEncodeUTF8();
 
-        /* Setup Display Strings */
-        if(iot_data[disp_thing].alert)
+        if(disp_fleet)
+        {
+            /* Setup Display Strings with the minimum/mean/maximum of all things */
+            fleet_get_summary(&fleet);
+            snprintf(thing_str,     sizeof(thing_str),    "Fleet: %u things    \n", fleet.reporting);
+            /* List the first alerting things */
+            length = snprintf(ip_str, sizeof(ip_str), "Alerts: %u", fleet.alerts);
+            alert_thing = fleet_next_alert(0);
+            for(loop = 0; (loop < DISPLAY_ALERT_THINGS) && (alert_thing != FLEET_NO_THING); loop++)
+            {
+                length += snprintf(&ip_str[length], sizeof(ip_str) - length, " %02u", alert_thing);
+                alert_thing = fleet_next_alert(alert_thing + 1);
+            }
+            snprintf(temp_str,      sizeof(temp_str),     "T: %.1f/%.1f/%.1f    \n",
+                     (float)fleet.min[IOT_TEMPERATURE] / IOT_TEMPERATURE_SCALE,
+                     (float)fleet.mean[IOT_TEMPERATURE] / IOT_TEMPERATURE_SCALE,
+                     (float)fleet.max[IOT_TEMPERATURE] / IOT_TEMPERATURE_SCALE);
+            snprintf(humidity_str,  sizeof(humidity_str), "H: %.1f/%.1f/%.1f    \n",
+                     (float)fleet.min[IOT_HUMIDITY] / IOT_HUMIDITY_SCALE,
+                     (float)fleet.mean[IOT_HUMIDITY] / IOT_HUMIDITY_SCALE,
+                     (float)fleet.max[IOT_HUMIDITY] / IOT_HUMIDITY_SCALE);
+            snprintf(light_str,     sizeof(light_str),    "L: %d/%d/%d    \n",
+                     fleet.min[IOT_LIGHT] / IOT_LIGHT_SCALE,
+                     fleet.mean[IOT_LIGHT] / IOT_LIGHT_SCALE,
+                     fleet.max[IOT_LIGHT] / IOT_LIGHT_SCALE);
+        }
+        else
+        {
+            /* Take a consistent copy of the thing being displayed */
+            iot_data_snapshot(disp_thing, &thing);
+
+            /* Setup Display Strings */
+            if(thing.alert)
+            {
+                snprintf(thing_str, sizeof(thing_str),    "Thing_%02d  *ALERT*\n", thing.thingNumber);
+            } else {
+                snprintf(thing_str, sizeof(thing_str),    "Thing_%02d                \n", thing.thingNumber);
+            }
+            snprintf(temp_str,      sizeof(temp_str),     "Temp:        %.1f °C  \n", (float)thing.temp / IOT_TEMPERATURE_SCALE);
+            snprintf(humidity_str,  sizeof(humidity_str), "Humidity:   %.1f %%  \n", (float)thing.humidity / IOT_HUMIDITY_SCALE);
+            snprintf(light_str,     sizeof(light_str),    "Light:         %03d lx  \n", thing.light / IOT_LIGHT_SCALE);
+            iot_data_format_ip(thing.ip, ip_str);
+        }
+
+        /* Print the lines that changed on display - lock the bus to prevent
+         * conflict, the AFE can still read between the transfers */
+        i2c_lock(I2C_CLIENT_DISPLAY);
+        if(lines & LINE_TITLE)
+        {
+            GUI_DispStringAt(thing_str, 0, 0);
+        }
+        if(lines & LINE_IP)
+        {
+            GUI_DispStringAt(ip_str, 0, line_height);
+            GUI_DispString("            \n");
+        }
+        if(lines & LINE_TEMPERATURE)
+        {
+            GUI_DispStringAt(temp_str, 0, 2 * line_height);
+        }
+        if(lines & LINE_HUMIDITY)
+        {
+            GUI_DispStringAt(humidity_str, 0, 3 * line_height);
+        }
+        if(lines & LINE_LIGHT)
+        {
+            GUI_DispStringAt(light_str, 0, 4 * line_height);
+        }
+        i2c_unlock(I2C_CLIENT_DISPLAY);
+
+        /* Wait until something on the display has changed */
+        lines = 0;
+        while(lines == 0)
         {
-            snprintf(thing_str, sizeof(thing_str),    "Thing_%02d  *ALERT*\n", disp_thing);
-        } else {
-            snprintf(thing_str, sizeof(thing_str),    "Thing_%02d                \n", disp_thing);
+            notify_wait(subscriber, &changes, portMAX_DELAY);
+            if((changes.fields & NOTIFY_VIEW) || (disp_fleet && (changes.fields != 0)))
+            {
+                /* Other screen or another thing, or the fleet summary may have changed */
+                lines = LINE_ALL;
+            }
+            else if(NOTIFY_THING_CHANGED(&changes, disp_thing))
+            {
+                lines |= (changes.fields & NOTIFY_ALERT)       ? LINE_TITLE : 0;
+                lines |= (changes.fields & NOTIFY_IP)          ? LINE_IP : 0;
+                lines |= (changes.fields & NOTIFY_TEMPERATURE) ? LINE_TEMPERATURE : 0;
+                lines |= (changes.fields & NOTIFY_HUMIDITY)    ? LINE_HUMIDITY : 0;
+                lines |= (changes.fields & NOTIFY_LIGHT)       ? LINE_LIGHT : 0;
+            }
         }
-        snprintf(temp_str,      sizeof(temp_str),     "Temp:        %.1f °C  \n", iot_data[disp_thing].temp);
-        snprintf(humidity_str,  sizeof(humidity_str), "Humidity:   %.1f %%  \n", iot_data[disp_thing].humidity);
-        snprintf(light_str,     sizeof(light_str),    "Light:         %03.0f lx  \n", iot_data[disp_thing].light);
-
-        /* Print data on display - use a mutex to prevent conflict*/
-        xSemaphoreTake( i2c_mutex, portMAX_DELAY);
-        GUI_GotoXY(0, 0);
-        GUI_DispString(thing_str);
-        GUI_DispString(iot_data[disp_thing].ip_str);
-        GUI_DispString("            \n");
-        GUI_DispString(temp_str);
-        GUI_DispString(humidity_str);
-        GUI_DispString(light_str);
-        xSemaphoreGive(i2c_mutex);
     }
 }
@@ -13,8 +13,7 @@
 #include "common_resource.h"
 
 /* Shield interaction threads */
-void getWeatherDataThread(void* arg);
-void getCapSenseThread(void* arg);
+void afeThread(void* arg);
 void displayThread(void* arg);
 
 #endif /* SOURCE_AFE_SHIELD_OPERATION_H_ */
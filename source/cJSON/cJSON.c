@@ -124,6 +124,20 @@ static int case_insensitive_strcmp(const unsigned char *string1, const unsigned
     return tolower(*string1) - tolower(*string2);
 }
 
+/* 32 bit FNV-1a hash of length bytes, case folded so that it serves both comparison modes */
+static unsigned long hash_key(const unsigned char *key, size_t length)
+{
+    unsigned long hash = 2166136261UL;
+
+    for (; length > 0; (void)key++, length--)
+    {
+        hash ^= (unsigned long)tolower(*key);
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+    return hash;
+}
+
 typedef struct internal_hooks
 {
     void *(CJSON_CDECL *allocate)(size_t size);
@@ -154,7 +168,194 @@ static void * CJSON_CDECL internal_realloc(void *pointer, size_t size)
 /* strlen of character literals resolved at compile time */
 #define static_strlen(string_literal) (sizeof(string_literal) - sizeof(""))
 
+#if (CJSON_POOL_NODES > 0) || (CJSON_POOL_SMALL_STRINGS > 0) || (CJSON_POOL_LARGE_STRINGS > 0)
+#define CJSON_POOL_ENABLED
+#endif
+
+#ifdef CJSON_POOL_ENABLED
+/* the pool sits between cJSON and the allocator the hooks were set to */
+static internal_hooks backing_hooks = { internal_malloc, internal_free, internal_realloc };
+
+/* blocks are made of words so that they are aligned for any member of cJSON */
+typedef union pool_word
+{
+    double number;
+    void *pointer;
+    long integer;
+} pool_word;
+
+#define pool_block_words(size) (((size) + sizeof(pool_word) - 1) / sizeof(pool_word))
+
+/* one extra word avoids zero sized arrays for disabled classes */
+static pool_word pool_small_strings[(pool_block_words(CJSON_POOL_SMALL_STRING_SIZE) * CJSON_POOL_SMALL_STRINGS) + 1];
+static pool_word pool_large_strings[(pool_block_words(CJSON_POOL_LARGE_STRING_SIZE) * CJSON_POOL_LARGE_STRINGS) + 1];
+static pool_word pool_nodes[(pool_block_words(sizeof(cJSON)) * CJSON_POOL_NODES) + 1];
+
+typedef struct pool_class
+{
+    unsigned char *storage;
+    size_t block_size;
+    size_t block_count;
+    size_t carved; /* blocks taken from the storage so far, the rest has never been used */
+    void *free_list; /* the first word of a free block points to the next one */
+    size_t in_use;
+    size_t peak;
+    unsigned long hits;
+    unsigned long misses;
+} pool_class;
+
+/* ordered by block size, the first class that fits serves an allocation */
+static pool_class pool_classes[CJSON_POOL_CLASSES] =
+{
+    { (unsigned char*)pool_small_strings, pool_block_words(CJSON_POOL_SMALL_STRING_SIZE) * sizeof(pool_word), CJSON_POOL_SMALL_STRINGS, 0, NULL, 0, 0, 0, 0 },
+    { (unsigned char*)pool_large_strings, pool_block_words(CJSON_POOL_LARGE_STRING_SIZE) * sizeof(pool_word), CJSON_POOL_LARGE_STRINGS, 0, NULL, 0, 0, 0, 0 },
+    { (unsigned char*)pool_nodes, pool_block_words(sizeof(cJSON)) * sizeof(pool_word), CJSON_POOL_NODES, 0, NULL, 0, 0, 0, 0 }
+};
+
+static void (*pool_lock)(void) = NULL;
+static void (*pool_unlock)(void) = NULL;
+
+static void * CJSON_CDECL pool_allocate(size_t size)
+{
+    pool_class *first_fit = NULL;
+    pool_class *pool = NULL;
+    void *block = NULL;
+
+    if (pool_lock != NULL)
+    {
+        pool_lock();
+    }
+    for (pool = pool_classes; pool < (pool_classes + CJSON_POOL_CLASSES); pool++)
+    {
+        if ((pool->block_size < size) || (pool->block_count == 0))
+        {
+            continue;
+        }
+        if (first_fit == NULL)
+        {
+            first_fit = pool;
+        }
+
+        if (pool->free_list != NULL)
+        {
+            block = pool->free_list;
+            pool->free_list = *(void**)block;
+        }
+        else if (pool->carved < pool->block_count)
+        {
+            block = pool->storage + (pool->carved * pool->block_size);
+            pool->carved++;
+        }
+        else
+        {
+            /* exhausted, try a larger class */
+            continue;
+        }
+
+        pool->hits++;
+        pool->in_use++;
+        if (pool->in_use > pool->peak)
+        {
+            pool->peak = pool->in_use;
+        }
+        break;
+    }
+    if ((block == NULL) && (first_fit != NULL))
+    {
+        first_fit->misses++;
+    }
+    if (pool_unlock != NULL)
+    {
+        pool_unlock();
+    }
+
+    if (block == NULL)
+    {
+        block = backing_hooks.allocate(size);
+    }
+
+    return block;
+}
+
+static void CJSON_CDECL pool_deallocate(void *pointer)
+{
+    pool_class *pool = NULL;
+
+    /* the class is found by address, so blocks don't need a header */
+    for (pool = pool_classes; pool < (pool_classes + CJSON_POOL_CLASSES); pool++)
+    {
+        if (((unsigned char*)pointer >= pool->storage) && ((unsigned char*)pointer < (pool->storage + (pool->block_count * pool->block_size))))
+        {
+            if (pool_lock != NULL)
+            {
+                pool_lock();
+            }
+            *(void**)pointer = pool->free_list;
+            pool->free_list = pointer;
+            pool->in_use--;
+            if (pool_unlock != NULL)
+            {
+                pool_unlock();
+            }
+            return;
+        }
+    }
+
+    backing_hooks.deallocate(pointer);
+}
+
+/* realloc can't be used on pool blocks, cJSON allocates and copies instead if it is NULL */
+static internal_hooks global_hooks = { pool_allocate, pool_deallocate, NULL };
+#else
 static internal_hooks global_hooks = { internal_malloc, internal_free, internal_realloc };
+#define backing_hooks global_hooks
+#endif
+
+CJSON_PUBLIC(cJSON_bool) cJSON_GetPoolStats(cJSON_PoolStats stats[CJSON_POOL_CLASSES])
+{
+#ifdef CJSON_POOL_ENABLED
+    size_t class_index = 0;
+
+    if (stats == NULL)
+    {
+        return false;
+    }
+
+    if (pool_lock != NULL)
+    {
+        pool_lock();
+    }
+    for (class_index = 0; class_index < CJSON_POOL_CLASSES; class_index++)
+    {
+        stats[class_index].block_size = pool_classes[class_index].block_size;
+        stats[class_index].block_count = pool_classes[class_index].block_count;
+        stats[class_index].in_use = pool_classes[class_index].in_use;
+        stats[class_index].peak = pool_classes[class_index].peak;
+        stats[class_index].hits = pool_classes[class_index].hits;
+        stats[class_index].misses = pool_classes[class_index].misses;
+    }
+    if (pool_unlock != NULL)
+    {
+        pool_unlock();
+    }
+
+    return true;
+#else
+    (void)stats;
+    return false;
+#endif
+}
+
+CJSON_PUBLIC(void) cJSON_SetPoolLock(void (*lock)(void), void (*unlock)(void))
+{
+#ifdef CJSON_POOL_ENABLED
+    pool_lock = lock;
+    pool_unlock = unlock;
+#else
+    (void)lock;
+    (void)unlock;
+#endif
+}
 
 static unsigned char* cJSON_strdup(const unsigned char* string, const internal_hooks * const hooks)
 {
@@ -182,29 +383,29 @@ CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks)
     if (hooks == NULL)
     {
         /* Reset hooks */
-        global_hooks.allocate = malloc;
-        global_hooks.deallocate = free;
-        global_hooks.reallocate = realloc;
+        backing_hooks.allocate = malloc;
+        backing_hooks.deallocate = free;
+        backing_hooks.reallocate = realloc;
         return;
     }
 
-    global_hooks.allocate = malloc;
+    backing_hooks.allocate = malloc;
     if (hooks->malloc_fn != NULL)
     {
-        global_hooks.allocate = hooks->malloc_fn;
+        backing_hooks.allocate = hooks->malloc_fn;
     }
 
-    global_hooks.deallocate = free;
+    backing_hooks.deallocate = free;
     if (hooks->free_fn != NULL)
     {
-        global_hooks.deallocate = hooks->free_fn;
+        backing_hooks.deallocate = hooks->free_fn;
     }
 
     /* use realloc only if both free and malloc are used */
-    global_hooks.reallocate = NULL;
-    if ((global_hooks.allocate == malloc) && (global_hooks.deallocate == free))
+    backing_hooks.reallocate = NULL;
+    if ((backing_hooks.allocate == malloc) && (backing_hooks.deallocate == free))
     {
-        global_hooks.reallocate = realloc;
+        backing_hooks.reallocate = realloc;
     }
 }
 
@@ -220,18 +421,144 @@ static cJSON *cJSON_New_Item(const internal_hooks * const hooks)
     return node;
 }
 
+/* Open addressing hash table over the members of an object, the slots follow the header.
+ * Members are inserted in list order, so with linear probing the first member with a
+ * given key is always found first, just like with the linear search. */
+struct cJSON_Index
+{
+    size_t mask; /* number of slots - 1, the number of slots is a power of two */
+    size_t count; /* number of members */
+};
+
+#define index_slots(key_index) ((cJSON**)((key_index) + 1))
+
+static size_t index_memory(const struct cJSON_Index * const key_index)
+{
+    return sizeof(struct cJSON_Index) + ((key_index->mask + 1) * sizeof(cJSON*));
+}
+
+static void drop_index(cJSON * const object)
+{
+    if (object->index != NULL)
+    {
+        global_hooks.deallocate(object->index);
+        object->index = NULL;
+    }
+}
+
+/* build the index of an object with count members, fails silently so lookups fall back to the linear search */
+static void build_index(cJSON * const object, const size_t count)
+{
+    struct cJSON_Index *key_index = NULL;
+    cJSON **slots = NULL;
+    cJSON *child = NULL;
+    size_t slot_count = 1;
+    size_t position = 0;
+
+    /* keep the load factor at or below 1/2 */
+    while (slot_count < (count * 2))
+    {
+        slot_count <<= 1;
+    }
+
+    key_index = (struct cJSON_Index*)global_hooks.allocate(sizeof(struct cJSON_Index) + (slot_count * sizeof(cJSON*)));
+    if (key_index == NULL)
+    {
+        return;
+    }
+    key_index->mask = slot_count - 1;
+    key_index->count = count;
+    slots = index_slots(key_index);
+    memset(slots, '\0', slot_count * sizeof(cJSON*));
+
+    for (child = object->child; child != NULL; child = child->next)
+    {
+        if (child->string == NULL)
+        {
+            continue;
+        }
+
+        position = hash_key((const unsigned char*)child->string, strlen(child->string)) & key_index->mask;
+        while (slots[position] != NULL)
+        {
+            position = (position + 1) & key_index->mask;
+        }
+        slots[position] = child;
+    }
+
+    object->index = key_index;
+}
+
+static cJSON *index_lookup(const struct cJSON_Index * const key_index, const char * const name, const cJSON_bool case_sensitive)
+{
+    cJSON * const *slots = index_slots(key_index);
+    size_t position = hash_key((const unsigned char*)name, strlen(name)) & key_index->mask;
+
+    for (; slots[position] != NULL; position = (position + 1) & key_index->mask)
+    {
+        if ((slots[position]->string == name) || (case_sensitive ? (strcmp(name, slots[position]->string) == 0) : (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)slots[position]->string) == 0)))
+        {
+            return slots[position];
+        }
+    }
+
+    return NULL;
+}
+
+CJSON_PUBLIC(void) cJSON_InvalidateIndex(cJSON * const object)
+{
+    if (object != NULL)
+    {
+        drop_index(object);
+    }
+}
+
+CJSON_PUBLIC(size_t) cJSON_GetIndexMemory(const cJSON * const item)
+{
+    const cJSON *child = NULL;
+    size_t memory = 0;
+
+    if (item == NULL)
+    {
+        return 0;
+    }
+
+    if (item->index != NULL)
+    {
+        memory += index_memory(item->index);
+    }
+    if (!(item->type & cJSON_IsReference))
+    {
+        for (child = item->child; child != NULL; child = child->next)
+        {
+            memory += cJSON_GetIndexMemory(child);
+        }
+    }
+
+    return memory;
+}
+
 /* Delete a cJSON structure. */
 CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
 {
     cJSON *next = NULL;
+    cJSON *last_child = NULL;
     while (item != NULL)
     {
-        next = item->next;
         if (!(item->type & cJSON_IsReference) && (item->child != NULL))
         {
-            cJSON_Delete(item->child);
+            /* instead of recursing, splice the children in front of the remaining siblings */
+            last_child = item->child;
+            while (last_child->next != NULL)
+            {
+                last_child = last_child->next;
+            }
+            last_child->next = item->next;
+            item->next = item->child;
+            item->child = NULL;
         }
-        if (!(item->type & cJSON_IsReference) && (item->valuestring != NULL))
+        next = item->next;
+        if (!(item->type & (cJSON_IsReference | cJSON_IsLazy)) && (item->valuestring != NULL))
         {
             global_hooks.deallocate(item->valuestring);
         }
@@ -239,6 +566,7 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
         {
             global_hooks.deallocate(item->string);
         }
+        drop_index(item);
         global_hooks.deallocate(item);
         item = next;
     }
@@ -271,6 +599,8 @@ typedef struct
 #define cannot_access_at_index(buffer, index) (!can_access_at_index(buffer, index))
 /* get a pointer to the buffer at the position */
 #define buffer_at_offset(buffer) ((buffer)->content + (buffer)->offset)
+/* type of a parsed value, keeps the flag of an interned key */
+#define parsed_type(item, new_type) (((item)->type & cJSON_StringIsConst) | (new_type))
 
 /* Parse the input text to generate a number, and populate the result into item. */
 static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_buffer)
@@ -343,7 +673,7 @@ loop_end:
         item->valueint = (int)number;
     }
 
-    item->type = cJSON_Number;
+    item->type = parsed_type(item, cJSON_Number);
 
     input_buffer->offset += (size_t)(after_end - number_c_string);
     return true;
@@ -704,54 +1034,56 @@ fail:
     return 0;
 }
 
-/* Parse the input text into an unescaped cinput, and populate item. */
-static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_buffer)
+/* Find the closing quote of the string literal at the current offset without decoding it.
+ * string_end is set to the closing quote, skipped_bytes (optional) to the number of bytes
+ * the escape sequences will shrink by. */
+static cJSON_bool scan_string(const parse_buffer * const input_buffer, const unsigned char **string_end, size_t *skipped_bytes)
 {
-    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
     const unsigned char *input_end = buffer_at_offset(input_buffer) + 1;
-    unsigned char *output_pointer = NULL;
-    unsigned char *output = NULL;
+    size_t skipped = 0;
 
     /* not a string */
     if (buffer_at_offset(input_buffer)[0] != '\"')
     {
-        goto fail;
+        return false;
     }
 
+    while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
     {
-        /* calculate approximate size of the output (overestimate) */
-        size_t allocation_length = 0;
-        size_t skipped_bytes = 0;
-        while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
+        /* is escape sequence */
+        if (input_end[0] == '\\')
         {
-            /* is escape sequence */
-            if (input_end[0] == '\\')
+            if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length)
             {
-                if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length)
-                {
-                    /* prevent buffer overflow when last input character is a backslash */
-                    goto fail;
-                }
-                skipped_bytes++;
-                input_end++;
+                /* prevent buffer overflow when last input character is a backslash */
+                return false;
             }
+            skipped++;
             input_end++;
         }
-        if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"'))
-        {
-            goto fail; /* string ended unexpectedly */
-        }
+        input_end++;
+    }
+    if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"'))
+    {
+        return false; /* string ended unexpectedly */
+    }
 
-        /* This is at most how much we need for the output */
-        allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
-        output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
-        if (output == NULL)
-        {
-            goto fail; /* allocation failure */
-        }
+    *string_end = input_end;
+    if (skipped_bytes != NULL)
+    {
+        *skipped_bytes = skipped;
     }
 
-    output_pointer = output;
+    return true;
+}
+
+/* Unescape the string literal between *input and input_end into output, which has to hold at least
+ * (input_end - *input) bytes. Returns a pointer behind the last byte written, or NULL with *input
+ * pointing at the offending escape sequence. */
+static unsigned char *unescape_string(const unsigned char **input, const unsigned char * const input_end, unsigned char *output_pointer)
+{
+    const unsigned char *input_pointer = *input;
+
     /* loop through the string literal */
     while (input_pointer < input_end)
     {
@@ -808,10 +1140,50 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
         }
     }
 
+    *input = input_pointer;
+    return output_pointer;
+
+fail:
+    *input = input_pointer;
+    return NULL;
+}
+
+/* Parse the input text into an unescaped cinput, and populate item. */
+static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_buffer)
+{
+    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
+    const unsigned char *input_end = buffer_at_offset(input_buffer) + 1;
+    unsigned char *output_pointer = NULL;
+    unsigned char *output = NULL;
+
+    {
+        /* calculate approximate size of the output (overestimate) */
+        size_t allocation_length = 0;
+        size_t skipped_bytes = 0;
+        if (!scan_string(input_buffer, &input_end, &skipped_bytes))
+        {
+            goto fail;
+        }
+
+        /* This is at most how much we need for the output */
+        allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
+        output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        if (output == NULL)
+        {
+            goto fail; /* allocation failure */
+        }
+    }
+
+    output_pointer = unescape_string(&input_pointer, input_end, output);
+    if (output_pointer == NULL)
+    {
+        goto fail;
+    }
+
     /* zero terminate the output */
     *output_pointer = '\0';
 
-    item->type = cJSON_String;
+    item->type = parsed_type(item, cJSON_String);
     item->valuestring = (char*)output;
 
     input_buffer->offset = (size_t) (input_end - input_buffer->content);
@@ -962,12 +1334,9 @@ static cJSON_bool print_string(const cJSON * const item, printbuffer * const p)
 }
 
 /* Predeclare these prototypes. */
-static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer);
-static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer);
-static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buffer);
-static cJSON_bool print_array(const cJSON * const item, printbuffer * const output_buffer);
-static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_buffer);
-static cJSON_bool print_object(const cJSON * const item, printbuffer * const output_buffer);
+static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer, cJSON ** const stack, const size_t stack_size);
+static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer, const cJSON ** const stack, const size_t stack_size);
+static void* cast_away_const(const void* string);
 
 /* Utility to jump whitespace and cr/lf */
 static parse_buffer *buffer_skip_whitespace(parse_buffer * const buffer)
@@ -1008,6 +1377,13 @@ static parse_buffer *skip_utf8_bom(parse_buffer * const buffer)
 
 /* Parse an object - create a new root, and populate. */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    cJSON *stack[CJSON_STACK_DEPTH];
+
+    return cJSON_ParseWithStack(value, return_parse_end, require_null_terminated, stack, CJSON_STACK_DEPTH);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithStack(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated, cJSON **stack, const size_t stack_size)
 {
     parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
     cJSON *item = NULL;
@@ -1016,7 +1392,7 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return
     global_error.json = NULL;
     global_error.position = 0;
 
-    if (value == NULL)
+    if ((value == NULL) || (stack == NULL))
     {
         goto fail;
     }
@@ -1032,7 +1408,7 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return
         goto fail;
     }
 
-    if (!parse_value(item, buffer_skip_whitespace(skip_utf8_bom(&buffer))))
+    if (!parse_value(item, buffer_skip_whitespace(skip_utf8_bom(&buffer)), stack, stack_size))
     {
         /* parse failure. ep is set. */
         goto fail;
@@ -1092,738 +1468,2922 @@ CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value)
     return cJSON_ParseWithOpts(value, 0, 0);
 }
 
-#define cjson_min(a, b) ((a < b) ? a : b)
-
-static unsigned char *print(const cJSON * const item, cJSON_bool format, const internal_hooks * const hooks)
+/* Like buffer_skip_whitespace, but never steps back onto the last character when the end of
+ * the buffer is reached. Used by the parsers that work on buffers which are not zero terminated. */
+static void skip_whitespace_to_end(parse_buffer * const buffer)
 {
-    static const size_t default_buffer_size = 256;
-    printbuffer buffer[1];
-    unsigned char *printed = NULL;
-
-    memset(buffer, 0, sizeof(buffer));
-
-    /* create buffer */
-    buffer->buffer = (unsigned char*) hooks->allocate(default_buffer_size);
-    buffer->length = default_buffer_size;
-    buffer->format = format;
-    buffer->hooks = *hooks;
-    if (buffer->buffer == NULL)
+    while (can_access_at_index(buffer, 0) && (buffer_at_offset(buffer)[0] <= 32))
     {
-        goto fail;
+       buffer->offset++;
     }
+}
 
-    /* print the value */
-    if (!print_value(item, buffer))
-    {
-        goto fail;
-    }
-    update_offset(buffer);
+/* Skip the value at the current offset without building it. Containers are only matched
+ * bracket by bracket (strings are scanned so that brackets inside them are ignored),
+ * scalars up to the next delimiter. */
+static cJSON_bool skip_value(parse_buffer * const input_buffer)
+{
+    size_t depth = 0;
+    const unsigned char *string_end = NULL;
 
-    /* check if reallocate is available */
-    if (hooks->reallocate != NULL)
+    do
     {
-        printed = (unsigned char*) hooks->reallocate(buffer->buffer, buffer->offset + 1);
-        if (printed == NULL) {
+        if (cannot_access_at_index(input_buffer, 0))
+        {
+            return false;
+        }
+
+        switch (buffer_at_offset(input_buffer)[0])
+        {
+            case '{':
+            case '[':
+                depth++;
+                break;
+
+            case '}':
+            case ']':
+                if (depth == 0)
+                {
+                    return false;
+                }
+                depth--;
+                break;
+
+            case '\"':
+                if (!scan_string(input_buffer, &string_end, NULL))
+                {
+                    return false;
+                }
+                input_buffer->offset = (size_t)(string_end - input_buffer->content);
+                break;
+
+            default:
+                if (depth == 0)
+                {
+                    /* scalar, skip up to the next delimiter */
+                    size_t start = input_buffer->offset;
+                    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] > 32)
+                           && (strchr(",:]}", buffer_at_offset(input_buffer)[0]) == NULL))
+                    {
+                        input_buffer->offset++;
+                    }
+                    return input_buffer->offset != start;
+                }
+                break;
+        }
+        input_buffer->offset++;
+    }
+    while (depth > 0);
+
+    return true;
+}
+
+/* Report a string or key to a SAX callback. Strings without escape sequences are passed straight
+ * from the input, the others are unescaped into the scratch buffer first. */
+static int sax_string(parse_buffer * const input_buffer, int (*callback)(void *user_data, const char *string, size_t length), void *user_data, unsigned char * const scratch)
+{
+    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
+    const unsigned char *input_end = NULL;
+    unsigned char *output_end = NULL;
+    size_t skipped_bytes = 0;
+    int result = cJSON_SAX_Continue;
+
+    if (!scan_string(input_buffer, &input_end, &skipped_bytes))
+    {
+        return -1;
+    }
+
+    if (skipped_bytes == 0)
+    {
+        if (callback != NULL)
+        {
+            result = callback(user_data, (const char*)input_pointer, (size_t)(input_end - input_pointer));
+        }
+    }
+    else
+    {
+        if ((size_t)(input_end - input_pointer) >= CJSON_SAX_SCRATCH_SIZE)
+        {
+            return -1; /* escaped string doesn't fit into the scratch buffer */
+        }
+
+        output_end = unescape_string(&input_pointer, input_end, scratch);
+        if (output_end == NULL)
+        {
+            input_buffer->offset = (size_t)(input_pointer - input_buffer->content);
+            return -1;
+        }
+        *output_end = '\0';
+
+        if (callback != NULL)
+        {
+            result = callback(user_data, (const char*)scratch, (size_t)(output_end - scratch));
+        }
+    }
+
+    input_buffer->offset = (size_t)(input_end - input_buffer->content) + 1;
+
+    return result;
+}
+
+/* Nesting bookkeeping of the SAX parser: one bit per level, set for objects. */
+#define sax_push(stack, depth, is_object) \
+    ((is_object) ? ((stack)[(depth) / 8] |= (unsigned char)(1U << ((depth) % 8))) : ((stack)[(depth) / 8] &= (unsigned char)~(1U << ((depth) % 8))))
+#define sax_in_object(stack, depth) (((stack)[((depth) - 1) / 8] & (1U << (((depth) - 1) % 8))) != 0)
+
+typedef enum
+{
+    sax_expect_value,
+    sax_expect_key,
+    sax_after_value
+} sax_state;
+
+CJSON_PUBLIC(cJSON_bool) cJSON_ParseSAX(const char *value, size_t buffer_length, const cJSON_SAXHandler * const handler, void *user_data, const char **return_parse_end)
+{
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    unsigned char nesting[(CJSON_NESTING_LIMIT + 7) / 8];
+    unsigned char scratch[CJSON_SAX_SCRATCH_SIZE];
+    sax_state state = sax_expect_value;
+    int result = cJSON_SAX_Continue;
+    cJSON scalar;
+
+    /* reset error position */
+    global_error.json = NULL;
+    global_error.position = 0;
+
+    if ((value == NULL) || (handler == NULL) || (buffer_length == 0))
+    {
+        goto fail;
+    }
+
+    buffer.content = (const unsigned char*)value;
+    buffer.length = buffer_length;
+    buffer.offset = 0;
+    buffer.hooks = global_hooks;
+
+    if (skip_utf8_bom(&buffer) == NULL)
+    {
+        goto fail;
+    }
+    skip_whitespace_to_end(&buffer);
+
+    for (;;)
+    {
+        if (state == sax_after_value)
+        {
+            skip_whitespace_to_end(&buffer);
+            if (buffer.depth == 0)
+            {
+                break; /* done with the root value */
+            }
+            if (cannot_access_at_index(&buffer, 0))
+            {
+                goto fail;
+            }
+
+            switch (buffer_at_offset(&buffer)[0])
+            {
+                case ',':
+                    buffer.offset++;
+                    state = sax_in_object(nesting, buffer.depth) ? sax_expect_key : sax_expect_value;
+                    continue;
+
+                case '}':
+                case ']':
+                    if ((buffer_at_offset(&buffer)[0] == '}') != sax_in_object(nesting, buffer.depth))
+                    {
+                        goto fail; /* mismatched bracket */
+                    }
+                    buffer.offset++;
+                    buffer.depth--;
+                    if (sax_in_object(nesting, buffer.depth + 1))
+                    {
+                        result = (handler->object_end != NULL) ? handler->object_end(user_data) : cJSON_SAX_Continue;
+                    }
+                    else
+                    {
+                        result = (handler->array_end != NULL) ? handler->array_end(user_data) : cJSON_SAX_Continue;
+                    }
+                    break;
+
+                default:
+                    goto fail;
+            }
+        }
+        else if (state == sax_expect_key)
+        {
+            skip_whitespace_to_end(&buffer);
+            if (cannot_access_at_index(&buffer, 0) || (buffer_at_offset(&buffer)[0] != '\"'))
+            {
+                goto fail;
+            }
+            result = sax_string(&buffer, handler->key, user_data, scratch);
+            if (result < 0)
+            {
+                goto fail;
+            }
+
+            skip_whitespace_to_end(&buffer);
+            if (cannot_access_at_index(&buffer, 0) || (buffer_at_offset(&buffer)[0] != ':'))
+            {
+                goto fail;
+            }
+            buffer.offset++;
+            skip_whitespace_to_end(&buffer);
+
+            if (result == cJSON_SAX_Skip)
+            {
+                /* skip the value of this member */
+                if (!skip_value(&buffer))
+                {
+                    goto fail;
+                }
+                state = sax_after_value;
+                continue;
+            }
+            state = sax_expect_value;
+        }
+        else
+        {
+            skip_whitespace_to_end(&buffer);
+            if (cannot_access_at_index(&buffer, 0))
+            {
+                goto fail;
+            }
+
+            state = sax_after_value;
+            switch (buffer_at_offset(&buffer)[0])
+            {
+                case '{':
+                case '[':
+                {
+                    cJSON_bool is_object = (buffer_at_offset(&buffer)[0] == '{');
+                    if (is_object)
+                    {
+                        result = (handler->object_start != NULL) ? handler->object_start(user_data) : cJSON_SAX_Continue;
+                    }
+                    else
+                    {
+                        result = (handler->array_start != NULL) ? handler->array_start(user_data) : cJSON_SAX_Continue;
+                    }
+
+                    if (result == cJSON_SAX_Skip)
+                    {
+                        if (!skip_value(&buffer))
+                        {
+                            goto fail;
+                        }
+                        continue;
+                    }
+                    if (buffer.depth >= CJSON_NESTING_LIMIT)
+                    {
+                        goto fail; /* to deeply nested */
+                    }
+                    sax_push(nesting, buffer.depth, is_object);
+                    buffer.depth++;
+                    buffer.offset++;
+
+                    /* empty object or array */
+                    skip_whitespace_to_end(&buffer);
+                    if (can_access_at_index(&buffer, 0) && (buffer_at_offset(&buffer)[0] == (is_object ? '}' : ']')))
+                    {
+                        break;
+                    }
+                    state = is_object ? sax_expect_key : sax_expect_value;
+                    break;
+                }
+
+                case '\"':
+                    result = sax_string(&buffer, handler->string, user_data, scratch);
+                    if (result < 0)
+                    {
+                        goto fail;
+                    }
+                    break;
+
+                case 'n':
+                    if (!can_read(&buffer, 4) || (strncmp((const char*)buffer_at_offset(&buffer), "null", 4) != 0))
+                    {
+                        goto fail;
+                    }
+                    buffer.offset += 4;
+                    result = (handler->null != NULL) ? handler->null(user_data) : cJSON_SAX_Continue;
+                    break;
+
+                case 't':
+                case 'f':
+                {
+                    cJSON_bool boolean = (buffer_at_offset(&buffer)[0] == 't');
+                    size_t literal_length = boolean ? 4 : 5;
+                    if (!can_read(&buffer, literal_length) || (strncmp((const char*)buffer_at_offset(&buffer), boolean ? "true" : "false", literal_length) != 0))
+                    {
+                        goto fail;
+                    }
+                    buffer.offset += literal_length;
+                    result = (handler->boolean != NULL) ? handler->boolean(user_data, boolean) : cJSON_SAX_Continue;
+                    break;
+                }
+
+                default:
+                    if ((buffer_at_offset(&buffer)[0] != '-') && ((buffer_at_offset(&buffer)[0] < '0') || (buffer_at_offset(&buffer)[0] > '9')))
+                    {
+                        goto fail;
+                    }
+                    memset(&scalar, '\0', sizeof(scalar));
+                    if (!parse_number(&scalar, &buffer))
+                    {
+                        goto fail;
+                    }
+                    result = (handler->number != NULL) ? handler->number(user_data, scalar.valuedouble) : cJSON_SAX_Continue;
+                    break;
+            }
+        }
+
+        if (result == cJSON_SAX_Abort)
+        {
+            goto fail;
+        }
+    }
+
+    /* only whitespace may follow the root value */
+    if (can_access_at_index(&buffer, 0) && (buffer_at_offset(&buffer)[0] != '\0'))
+    {
+        goto fail;
+    }
+    if (return_parse_end != NULL)
+    {
+        *return_parse_end = (const char*)buffer_at_offset(&buffer);
+    }
+
+    return true;
+
+fail:
+    if (value != NULL)
+    {
+        error local_error;
+        local_error.json = (const unsigned char*)value;
+        local_error.position = 0;
+
+        if (buffer.offset < buffer.length)
+        {
+            local_error.position = buffer.offset;
+        }
+        else if (buffer.length > 0)
+        {
+            local_error.position = buffer.length - 1;
+        }
+
+        if (return_parse_end != NULL)
+        {
+            *return_parse_end = (const char*)local_error.json + local_error.position;
+        }
+
+        global_error = local_error;
+    }
+
+    return false;
+}
+
+/* Check that the four characters behind a \u are hex digits. */
+static cJSON_bool is_hex4(const unsigned char * const input)
+{
+    size_t i = 0;
+
+    for (i = 0; i < 4; i++)
+    {
+        if (!(((input[i] >= '0') && (input[i] <= '9')) || ((input[i] >= 'A') && (input[i] <= 'F')) || ((input[i] >= 'a') && (input[i] <= 'f'))))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Check the string literal at the current offset and move behind it. On failure the offset points
+ * at the offending escape sequence or at the end of the buffer. */
+static cJSON_bool validate_string(parse_buffer * const input_buffer)
+{
+    const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
+    const unsigned char * const input_end = input_buffer->content + input_buffer->length;
+    unsigned char utf8[4];
+    unsigned char *output_pointer = NULL;
+    unsigned char sequence_length = 0;
+
+    while ((input_pointer < input_end) && (*input_pointer != '\"'))
+    {
+        if (*input_pointer != '\\')
+        {
+            input_pointer++;
+            continue;
+        }
+
+        if ((input_end - input_pointer) < 2)
+        {
             goto fail;
         }
-        buffer->buffer = NULL;
+        switch (input_pointer[1])
+        {
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+            case '\"':
+            case '\\':
+            case '/':
+                input_pointer += 2;
+                break;
+
+            case 'u':
+                if (((input_end - input_pointer) < 6) || !is_hex4(input_pointer + 2))
+                {
+                    goto fail;
+                }
+                /* surrogate pairs are checked the same way as when parsing */
+                output_pointer = utf8;
+                sequence_length = utf16_literal_to_utf8(input_pointer, input_end, &output_pointer);
+                if (sequence_length == 0)
+                {
+                    goto fail;
+                }
+                input_pointer += sequence_length;
+                break;
+
+            default:
+                goto fail;
+        }
+    }
+    if (input_pointer >= input_end)
+    {
+        goto fail; /* string ended unexpectedly */
+    }
+
+    input_buffer->offset = (size_t)(input_pointer - input_buffer->content) + 1;
+    return true;
+
+fail:
+    input_buffer->offset = (size_t)(input_pointer - input_buffer->content);
+    return false;
+}
+
+/* Move behind the digits at the current offset, returns false if there are none. */
+static cJSON_bool validate_digits(parse_buffer * const input_buffer)
+{
+    const size_t start = input_buffer->offset;
+
+    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9'))
+    {
+        input_buffer->offset++;
+    }
+
+    return input_buffer->offset != start;
+}
+
+/* Check a number against the JSON grammar without converting it:
+ * -? (0 | [1-9][0-9]*) (.[0-9]+)? ([eE][+-]?[0-9]+)? */
+static cJSON_bool validate_number(parse_buffer * const input_buffer)
+{
+    if (buffer_at_offset(input_buffer)[0] == '-')
+    {
+        input_buffer->offset++;
+    }
+
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '0'))
+    {
+        input_buffer->offset++;
+    }
+    else if (!validate_digits(input_buffer))
+    {
+        return false;
+    }
+
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '.'))
+    {
+        input_buffer->offset++;
+        if (!validate_digits(input_buffer))
+        {
+            return false;
+        }
+    }
+
+    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == 'e') || (buffer_at_offset(input_buffer)[0] == 'E')))
+    {
+        input_buffer->offset++;
+        if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '+') || (buffer_at_offset(input_buffer)[0] == '-')))
+        {
+            input_buffer->offset++;
+        }
+        if (!validate_digits(input_buffer))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_Validate(const char *value, size_t buffer_length, size_t max_depth, size_t *error_offset)
+{
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    unsigned char nesting[(CJSON_NESTING_LIMIT + 7) / 8];
+    sax_state state = sax_expect_value;
+    cJSON_bool is_object = false;
+    size_t literal_length = 0;
+
+    if ((value == NULL) || (buffer_length == 0))
+    {
+        goto fail;
+    }
+    if ((max_depth == 0) || (max_depth > CJSON_NESTING_LIMIT))
+    {
+        max_depth = CJSON_NESTING_LIMIT;
+    }
+
+    buffer.content = (const unsigned char*)value;
+    buffer.length = buffer_length;
+    buffer.offset = 0;
+
+    if (skip_utf8_bom(&buffer) == NULL)
+    {
+        goto fail;
+    }
+    skip_whitespace_to_end(&buffer);
+
+    for (;;)
+    {
+        if (state == sax_after_value)
+        {
+            skip_whitespace_to_end(&buffer);
+            if (buffer.depth == 0)
+            {
+                break; /* done with the root value */
+            }
+            if (cannot_access_at_index(&buffer, 0))
+            {
+                goto fail;
+            }
+
+            switch (buffer_at_offset(&buffer)[0])
+            {
+                case ',':
+                    buffer.offset++;
+                    state = sax_in_object(nesting, buffer.depth) ? sax_expect_key : sax_expect_value;
+                    break;
+
+                case '}':
+                case ']':
+                    if ((buffer_at_offset(&buffer)[0] == '}') != sax_in_object(nesting, buffer.depth))
+                    {
+                        goto fail; /* mismatched bracket */
+                    }
+                    buffer.offset++;
+                    buffer.depth--;
+                    break;
+
+                default:
+                    goto fail;
+            }
+        }
+        else if (state == sax_expect_key)
+        {
+            skip_whitespace_to_end(&buffer);
+            if (cannot_access_at_index(&buffer, 0) || (buffer_at_offset(&buffer)[0] != '\"') || !validate_string(&buffer))
+            {
+                goto fail;
+            }
+
+            skip_whitespace_to_end(&buffer);
+            if (cannot_access_at_index(&buffer, 0) || (buffer_at_offset(&buffer)[0] != ':'))
+            {
+                goto fail;
+            }
+            buffer.offset++;
+            skip_whitespace_to_end(&buffer);
+            state = sax_expect_value;
+        }
+        else
+        {
+            skip_whitespace_to_end(&buffer);
+            if (cannot_access_at_index(&buffer, 0))
+            {
+                goto fail;
+            }
+
+            state = sax_after_value;
+            switch (buffer_at_offset(&buffer)[0])
+            {
+                case '{':
+                case '[':
+                    is_object = (buffer_at_offset(&buffer)[0] == '{');
+                    if (buffer.depth >= max_depth)
+                    {
+                        goto fail; /* to deeply nested */
+                    }
+                    sax_push(nesting, buffer.depth, is_object);
+                    buffer.depth++;
+                    buffer.offset++;
+
+                    /* empty object or array */
+                    skip_whitespace_to_end(&buffer);
+                    if (can_access_at_index(&buffer, 0) && (buffer_at_offset(&buffer)[0] == (is_object ? '}' : ']')))
+                    {
+                        break;
+                    }
+                    state = is_object ? sax_expect_key : sax_expect_value;
+                    break;
+
+                case '\"':
+                    if (!validate_string(&buffer))
+                    {
+                        goto fail;
+                    }
+                    break;
+
+                case 'n':
+                case 't':
+                case 'f':
+                {
+                    const char * const literal = (buffer_at_offset(&buffer)[0] == 'n') ? "null" : ((buffer_at_offset(&buffer)[0] == 't') ? "true" : "false");
+                    literal_length = strlen(literal);
+                    if (!can_read(&buffer, literal_length) || (strncmp((const char*)buffer_at_offset(&buffer), literal, literal_length) != 0))
+                    {
+                        goto fail;
+                    }
+                    buffer.offset += literal_length;
+                    break;
+                }
+
+                default:
+                    if (((buffer_at_offset(&buffer)[0] != '-') && ((buffer_at_offset(&buffer)[0] < '0') || (buffer_at_offset(&buffer)[0] > '9')))
+                        || !validate_number(&buffer))
+                    {
+                        goto fail;
+                    }
+                    break;
+            }
+        }
+    }
+
+    /* only whitespace may follow the root value */
+    if (can_access_at_index(&buffer, 0) && (buffer_at_offset(&buffer)[0] != '\0'))
+    {
+        goto fail;
+    }
+
+    return true;
+
+fail:
+    if (error_offset != NULL)
+    {
+        *error_offset = (buffer.offset < buffer_length) ? buffer.offset : buffer_length;
+    }
+
+    return false;
+}
+
+/* States of the incremental parser. */
+typedef enum
+{
+    stream_value,        /* expecting a value */
+    stream_value_or_end, /* expecting a value or ']' right after '[' */
+    stream_key,          /* expecting a key */
+    stream_key_or_end,   /* expecting a key or '}' right after '{' */
+    stream_colon,        /* expecting ':' after a key */
+    stream_after_value,  /* expecting ',' or the end of the current object/array */
+    stream_string,       /* inside a string or key, collected in the token buffer */
+    stream_number,       /* inside a number, collected in the token buffer */
+    stream_literal,      /* inside true, false or null */
+    stream_skip,         /* skipping a value the handler isn't interested in */
+    stream_done,         /* the root value is complete, only whitespace may follow */
+    stream_error
+} stream_state;
+
+/* Flags of the incremental parser. */
+#define STREAM_KEY        0x01U /* the string being collected is a key */
+#define STREAM_ESCAPE     0x02U /* the previous character was a backslash */
+#define STREAM_IN_STRING  0x04U /* skipping through a string */
+#define STREAM_SKIP_VALUE 0x08U /* the handler asked to skip the value of the current member */
+
+/* Step results of the incremental parser. */
+#define STREAM_REPROCESS 0  /* look at the character again in the new state */
+#define STREAM_CONSUMED  1
+#define STREAM_FAILED    -1
+
+CJSON_PUBLIC(void) cJSON_StreamParserInit(cJSON_StreamParser * const parser, const cJSON_SAXHandler * const handler, void *user_data)
+{
+    if (parser == NULL)
+    {
+        return;
+    }
+
+    memset(parser, '\0', sizeof(cJSON_StreamParser));
+    parser->handler = handler;
+    parser->user_data = user_data;
+    parser->state = (handler != NULL) ? stream_value : stream_error;
+}
+
+static int stream_append(cJSON_StreamParser * const parser, const unsigned char character)
+{
+    if (parser->token_length >= (CJSON_STREAM_TOKEN_SIZE - 1))
+    {
+        return STREAM_FAILED; /* token doesn't fit into the token buffer */
+    }
+    parser->token[parser->token_length++] = character;
+
+    return STREAM_CONSUMED;
+}
+
+/* A value (scalar or closed object/array) is complete, figure out what comes next. */
+static void stream_value_complete(cJSON_StreamParser * const parser)
+{
+    parser->state = (parser->depth == 0) ? stream_done : stream_after_value;
+}
+
+/* Translate a callback result into a step result. */
+static int stream_result(const int result, const int step)
+{
+    if ((result < 0) || (result == cJSON_SAX_Abort))
+    {
+        return STREAM_FAILED;
+    }
+
+    return step;
+}
+
+static int stream_emit_string(cJSON_StreamParser * const parser)
+{
+    const unsigned char *input_pointer = parser->token;
+    unsigned char *output_end = NULL;
+    int (*callback)(void *user_data, const char *string, size_t length) = NULL;
+
+    /* unescape in place, the output is never longer than the input */
+    output_end = unescape_string(&input_pointer, parser->token + parser->token_length, parser->token);
+    if (output_end == NULL)
+    {
+        return -1;
+    }
+    *output_end = '\0';
+
+    callback = (parser->flags & STREAM_KEY) ? parser->handler->key : parser->handler->string;
+    if (callback == NULL)
+    {
+        return cJSON_SAX_Continue;
+    }
+
+    return callback(parser->user_data, (const char*)parser->token, (size_t)(output_end - parser->token));
+}
+
+static int stream_emit_number(cJSON_StreamParser * const parser)
+{
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    cJSON scalar;
+
+    buffer.content = parser->token;
+    buffer.length = parser->token_length;
+    memset(&scalar, '\0', sizeof(scalar));
+    if (!parse_number(&scalar, &buffer) || (buffer.offset != parser->token_length))
+    {
+        return -1;
+    }
+
+    if (parser->handler->number == NULL)
+    {
+        return cJSON_SAX_Continue;
+    }
+
+    return parser->handler->number(parser->user_data, scalar.valuedouble);
+}
+
+static int stream_close(cJSON_StreamParser * const parser, const unsigned char character)
+{
+    int result = cJSON_SAX_Continue;
+    cJSON_bool is_object = sax_in_object(parser->nesting, parser->depth);
+
+    if ((parser->depth == 0) || ((character == '}') != is_object))
+    {
+        return STREAM_FAILED; /* mismatched bracket */
+    }
+    parser->depth--;
+
+    if (is_object)
+    {
+        result = (parser->handler->object_end != NULL) ? parser->handler->object_end(parser->user_data) : cJSON_SAX_Continue;
+    }
+    else
+    {
+        result = (parser->handler->array_end != NULL) ? parser->handler->array_end(parser->user_data) : cJSON_SAX_Continue;
+    }
+    stream_value_complete(parser);
+
+    return stream_result(result, STREAM_CONSUMED);
+}
+
+static int stream_open(cJSON_StreamParser * const parser, const unsigned char character)
+{
+    int result = cJSON_SAX_Continue;
+    cJSON_bool is_object = (character == '{');
+
+    if (is_object)
+    {
+        result = (parser->handler->object_start != NULL) ? parser->handler->object_start(parser->user_data) : cJSON_SAX_Continue;
+    }
+    else
+    {
+        result = (parser->handler->array_start != NULL) ? parser->handler->array_start(parser->user_data) : cJSON_SAX_Continue;
+    }
+    if ((result < 0) || (result == cJSON_SAX_Abort))
+    {
+        return STREAM_FAILED;
+    }
+
+    if (result == cJSON_SAX_Skip)
+    {
+        /* skip up to the matching bracket */
+        parser->skip_depth = 1;
+        parser->state = stream_skip;
+        return STREAM_CONSUMED;
+    }
+
+    if (parser->depth >= CJSON_NESTING_LIMIT)
+    {
+        return STREAM_FAILED; /* to deeply nested */
+    }
+    sax_push(parser->nesting, parser->depth, is_object);
+    parser->depth++;
+    parser->state = is_object ? stream_key_or_end : stream_value_or_end;
+
+    return STREAM_CONSUMED;
+}
+
+static int stream_skip_step(cJSON_StreamParser * const parser, const unsigned char character)
+{
+    if (parser->flags & STREAM_IN_STRING)
+    {
+        if (parser->flags & STREAM_ESCAPE)
+        {
+            parser->flags &= ~STREAM_ESCAPE;
+        }
+        else if (character == '\\')
+        {
+            parser->flags |= STREAM_ESCAPE;
+        }
+        else if (character == '\"')
+        {
+            parser->flags &= ~STREAM_IN_STRING;
+            if (parser->skip_depth == 0)
+            {
+                stream_value_complete(parser);
+            }
+        }
+        return STREAM_CONSUMED;
+    }
+
+    switch (character)
+    {
+        case '{':
+        case '[':
+            parser->skip_depth++;
+            break;
+
+        case '}':
+        case ']':
+            if (parser->skip_depth == 0)
+            {
+                /* end of a skipped scalar */
+                stream_value_complete(parser);
+                return STREAM_REPROCESS;
+            }
+            parser->skip_depth--;
+            if (parser->skip_depth == 0)
+            {
+                stream_value_complete(parser);
+            }
+            break;
+
+        case '\"':
+            parser->flags |= STREAM_IN_STRING;
+            break;
+
+        default:
+            if ((parser->skip_depth == 0) && ((character <= 32) || (character == ',')))
+            {
+                /* end of a skipped scalar */
+                stream_value_complete(parser);
+                return STREAM_REPROCESS;
+            }
+            break;
+    }
+
+    return STREAM_CONSUMED;
+}
+
+/* Advance the incremental parser by one character. */
+static int stream_step(cJSON_StreamParser * const parser, const unsigned char character)
+{
+    int result = cJSON_SAX_Continue;
+
+    switch (parser->state)
+    {
+        case stream_string:
+            if (parser->flags & STREAM_ESCAPE)
+            {
+                parser->flags &= ~STREAM_ESCAPE;
+                return stream_append(parser, character);
+            }
+            if (character == '\\')
+            {
+                parser->flags |= STREAM_ESCAPE;
+                return stream_append(parser, character);
+            }
+            if (character != '\"')
+            {
+                return stream_append(parser, character);
+            }
+
+            /* end of the string */
+            result = stream_emit_string(parser);
+            if (parser->flags & STREAM_KEY)
+            {
+                if (result == cJSON_SAX_Skip)
+                {
+                    parser->flags |= STREAM_SKIP_VALUE;
+                }
+                parser->state = stream_colon;
+            }
+            else
+            {
+                stream_value_complete(parser);
+            }
+            return stream_result(result, STREAM_CONSUMED);
+
+        case stream_number:
+            if ((character != '\0') && (strchr("0123456789+-.eE", character) != NULL))
+            {
+                return stream_append(parser, character);
+            }
+
+            /* the number ended with the previous character */
+            result = stream_emit_number(parser);
+            stream_value_complete(parser);
+            return stream_result(result, STREAM_REPROCESS);
+
+        case stream_literal:
+            if (character != (unsigned char)parser->literal[parser->token_length])
+            {
+                return STREAM_FAILED;
+            }
+            parser->token_length++;
+            if (parser->literal[parser->token_length] != '\0')
+            {
+                return STREAM_CONSUMED;
+            }
+
+            if (parser->literal[0] == 'n')
+            {
+                result = (parser->handler->null != NULL) ? parser->handler->null(parser->user_data) : cJSON_SAX_Continue;
+            }
+            else if (parser->handler->boolean != NULL)
+            {
+                result = parser->handler->boolean(parser->user_data, parser->literal[0] == 't');
+            }
+            stream_value_complete(parser);
+            return stream_result(result, STREAM_CONSUMED);
+
+        case stream_skip:
+            return stream_skip_step(parser, character);
+
+        case stream_error:
+            return STREAM_FAILED;
+
+        default:
+            break;
+    }
+
+    /* whitespace between tokens */
+    if (character <= 32)
+    {
+        return STREAM_CONSUMED;
+    }
+
+    switch (parser->state)
+    {
+        case stream_colon:
+            if (character != ':')
+            {
+                return STREAM_FAILED;
+            }
+            parser->state = stream_value;
+            return STREAM_CONSUMED;
+
+        case stream_after_value:
+            if (character == ',')
+            {
+                parser->state = sax_in_object(parser->nesting, parser->depth) ? stream_key : stream_value;
+                return STREAM_CONSUMED;
+            }
+            return stream_close(parser, character);
+
+        case stream_key_or_end:
+            if (character == '}')
+            {
+                return stream_close(parser, character);
+            }
+            /* fall through */
+        case stream_key:
+            if (character != '\"')
+            {
+                return STREAM_FAILED;
+            }
+            parser->token_length = 0;
+            parser->flags |= STREAM_KEY;
+            parser->state = stream_string;
+            return STREAM_CONSUMED;
+
+        case stream_value_or_end:
+            if (character == ']')
+            {
+                return stream_close(parser, character);
+            }
+            /* fall through */
+        case stream_value:
+            if (parser->flags & STREAM_SKIP_VALUE)
+            {
+                parser->flags &= ~STREAM_SKIP_VALUE;
+                parser->skip_depth = 0;
+                parser->state = stream_skip;
+                return STREAM_REPROCESS;
+            }
+
+            parser->token_length = 0;
+            switch (character)
+            {
+                case '{':
+                case '[':
+                    return stream_open(parser, character);
+
+                case '\"':
+                    parser->flags &= ~STREAM_KEY;
+                    parser->state = stream_string;
+                    return STREAM_CONSUMED;
+
+                case 't':
+                case 'f':
+                case 'n':
+                    parser->literal = (character == 't') ? "true" : ((character == 'f') ? "false" : "null");
+                    parser->token_length = 1;
+                    parser->state = stream_literal;
+                    return STREAM_CONSUMED;
+
+                default:
+                    if ((character == '-') || ((character >= '0') && (character <= '9')))
+                    {
+                        parser->state = stream_number;
+                        return stream_append(parser, character);
+                    }
+                    return STREAM_FAILED;
+            }
+
+        default:
+            /* stream_done: garbage after the root value */
+            return STREAM_FAILED;
+    }
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_StreamParserFeed(cJSON_StreamParser * const parser, const char *chunk, size_t length)
+{
+    size_t i = 0;
+    int step = STREAM_CONSUMED;
+
+    if ((parser == NULL) || ((chunk == NULL) && (length > 0)))
+    {
+        return false;
+    }
+
+    while (i < length)
+    {
+        step = stream_step(parser, (const unsigned char)chunk[i]);
+        if (step == STREAM_FAILED)
+        {
+            parser->state = stream_error;
+            return false;
+        }
+        if (step == STREAM_CONSUMED)
+        {
+            i++;
+            parser->position++;
+        }
+    }
+
+    return true;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_StreamParserFinish(cJSON_StreamParser * const parser)
+{
+    if (parser == NULL)
+    {
+        return false;
+    }
+
+    /* a number or skipped scalar at the very end is only terminated by the end of the input */
+    if ((parser->state == stream_number) || ((parser->state == stream_skip) && (parser->skip_depth == 0) && !(parser->flags & STREAM_IN_STRING)))
+    {
+        if (stream_step(parser, ' ') == STREAM_FAILED)
+        {
+            parser->state = stream_error;
+        }
+    }
+
+    if (parser->state != stream_done)
+    {
+        parser->state = stream_error;
+        return false;
+    }
+
+    return true;
+}
+
+#define cjson_min(a, b) ((a < b) ? a : b)
+
+static unsigned char *print(const cJSON * const item, cJSON_bool format, const internal_hooks * const hooks)
+{
+    static const size_t default_buffer_size = 256;
+    printbuffer buffer[1];
+    unsigned char *printed = NULL;
+    const cJSON *stack[CJSON_STACK_DEPTH];
+
+    memset(buffer, 0, sizeof(buffer));
+
+    /* create buffer */
+    buffer->buffer = (unsigned char*) hooks->allocate(default_buffer_size);
+    buffer->length = default_buffer_size;
+    buffer->format = format;
+    buffer->hooks = *hooks;
+    if (buffer->buffer == NULL)
+    {
+        goto fail;
+    }
+
+    /* print the value */
+    if (!print_value(item, buffer, stack, CJSON_STACK_DEPTH))
+    {
+        goto fail;
+    }
+    update_offset(buffer);
+
+    /* check if reallocate is available */
+    if (hooks->reallocate != NULL)
+    {
+        printed = (unsigned char*) hooks->reallocate(buffer->buffer, buffer->offset + 1);
+        if (printed == NULL) {
+            goto fail;
+        }
+        buffer->buffer = NULL;
+    }
+    else /* otherwise copy the JSON over to a new buffer */
+    {
+        printed = (unsigned char*) hooks->allocate(buffer->offset + 1);
+        if (printed == NULL)
+        {
+            goto fail;
+        }
+        memcpy(printed, buffer->buffer, cjson_min(buffer->length, buffer->offset + 1));
+        printed[buffer->offset] = '\0'; /* just to be sure */
+
+        /* free the buffer */
+        hooks->deallocate(buffer->buffer);
+    }
+
+    return printed;
+
+fail:
+    if (buffer->buffer != NULL)
+    {
+        hooks->deallocate(buffer->buffer);
+    }
+
+    if (printed != NULL)
+    {
+        hooks->deallocate(printed);
+    }
+
+    return NULL;
+}
+
+/* Render a cJSON item/entity/structure to text. */
+CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item)
+{
+    return (char*)print(item, true, &global_hooks);
+}
+
+CJSON_PUBLIC(char *) cJSON_PrintUnformatted(const cJSON *item)
+{
+    return (char*)print(item, false, &global_hooks);
+}
+
+CJSON_PUBLIC(char *) cJSON_PrintBuffered(const cJSON *item, int prebuffer, cJSON_bool fmt)
+{
+    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 } };
+    const cJSON *stack[CJSON_STACK_DEPTH];
+
+    if (prebuffer < 0)
+    {
+        return NULL;
+    }
+
+    p.buffer = (unsigned char*)global_hooks.allocate((size_t)prebuffer);
+    if (!p.buffer)
+    {
+        return NULL;
+    }
+
+    p.length = (size_t)prebuffer;
+    p.offset = 0;
+    p.noalloc = false;
+    p.format = fmt;
+    p.hooks = global_hooks;
+
+    if (!print_value(item, &p, stack, CJSON_STACK_DEPTH))
+    {
+        global_hooks.deallocate(p.buffer);
+        return NULL;
+    }
+
+    return (char*)p.buffer;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buf, const int len, const cJSON_bool fmt)
+{
+    const cJSON *stack[CJSON_STACK_DEPTH];
+
+    return cJSON_PrintWithStack(item, buf, len, fmt, stack, CJSON_STACK_DEPTH);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_PrintWithStack(const cJSON *item, char *buf, const int len, const cJSON_bool fmt, const cJSON **stack, const size_t stack_size)
+{
+    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 } };
+
+    if ((len < 0) || (buf == NULL) || (stack == NULL))
+    {
+        return false;
+    }
+
+    p.buffer = (unsigned char*)buf;
+    p.length = (size_t)len;
+    p.offset = 0;
+    p.noalloc = true;
+    p.format = fmt;
+    p.hooks = global_hooks;
+
+    return print_value(item, &p, stack, stack_size);
+}
+
+static cJSON_bool writer_fail(cJSON_Writer * const writer)
+{
+    writer->failed = true;
+    return false;
+}
+
+static cJSON_bool writer_put(cJSON_Writer * const writer, const char * const text, const size_t length)
+{
+    if ((writer->length - writer->offset) <= length)
+    {
+        return writer_fail(writer);
+    }
+
+    memcpy(writer->buffer + writer->offset, text, length);
+    writer->offset += length;
+    writer->buffer[writer->offset] = '\0';
+
+    return true;
+}
+
+/* check that a key or value may follow and write the comma in front of it */
+static cJSON_bool writer_prefix(cJSON_Writer * const writer, const cJSON_bool is_key)
+{
+    char last = '\0';
+
+    if (writer->failed)
+    {
+        return false;
+    }
+
+    if (writer->depth == 0)
+    {
+        /* a single root value */
+        if (is_key || (writer->offset > 0))
+        {
+            return writer_fail(writer);
+        }
+        return true;
+    }
+
+    /* everything that is written ends with a bracket, quote, letter or digit, except keys */
+    last = writer->buffer[writer->offset - 1];
+    if (sax_in_object(writer->nesting, writer->depth))
+    {
+        /* keys and values alternate */
+        if (is_key == (last == ':'))
+        {
+            return writer_fail(writer);
+        }
+    }
+    else if (is_key)
+    {
+        return writer_fail(writer);
+    }
+
+    if ((last == '{') || (last == '[') || (last == ':'))
+    {
+        return true;
+    }
+
+    return writer_put(writer, ",", 1);
+}
+
+/* run one of the print functions on the writer's buffer, they fail instead of allocating */
+static cJSON_bool writer_print(cJSON_Writer * const writer, const cJSON * const item, const unsigned char * const string)
+{
+    printbuffer output = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 } };
+    cJSON_bool printed = false;
+
+    output.buffer = (unsigned char*)writer->buffer;
+    output.length = writer->length;
+    output.offset = writer->offset;
+    output.noalloc = true;
+    output.hooks = global_hooks;
+
+    printed = (item != NULL) ? print_number(item, &output) : print_string_ptr(string, &output);
+    if (!printed)
+    {
+        /* the print functions may have written beyond the terminator already */
+        writer->buffer[writer->offset] = '\0';
+        return writer_fail(writer);
+    }
+    update_offset(&output);
+    writer->offset = output.offset;
+
+    return true;
+}
+
+static cJSON_bool writer_open(cJSON_Writer * const writer, const char * const bracket, const cJSON_bool is_object)
+{
+    if (!writer_prefix(writer, false))
+    {
+        return false;
+    }
+    if (writer->depth >= CJSON_WRITER_NESTING_LIMIT)
+    {
+        return writer_fail(writer);
+    }
+    if (!writer_put(writer, bracket, 1))
+    {
+        return false;
+    }
+
+    sax_push(writer->nesting, writer->depth, is_object);
+    writer->depth++;
+
+    return true;
+}
+
+static cJSON_bool writer_close(cJSON_Writer * const writer, const char * const bracket, const cJSON_bool is_object)
+{
+    if (writer->failed)
+    {
+        return false;
+    }
+    if ((writer->depth == 0) || (sax_in_object(writer->nesting, writer->depth) != is_object) || (writer->buffer[writer->offset - 1] == ':'))
+    {
+        return writer_fail(writer);
+    }
+    if (!writer_put(writer, bracket, 1))
+    {
+        return false;
+    }
+
+    writer->depth--;
+
+    return true;
+}
+
+CJSON_PUBLIC(void) cJSON_WriterInit(cJSON_Writer * const writer, char *buffer, const size_t length)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+
+    memset(writer, '\0', sizeof(cJSON_Writer));
+    writer->buffer = buffer;
+    writer->length = length;
+    if ((buffer == NULL) || (length == 0) || (length > INT_MAX))
+    {
+        writer->failed = true;
+        return;
+    }
+    buffer[0] = '\0';
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteObjectStart(cJSON_Writer * const writer)
+{
+    return (writer != NULL) && writer_open(writer, "{", true);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteObjectEnd(cJSON_Writer * const writer)
+{
+    return (writer != NULL) && writer_close(writer, "}", true);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteArrayStart(cJSON_Writer * const writer)
+{
+    return (writer != NULL) && writer_open(writer, "[", false);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteArrayEnd(cJSON_Writer * const writer)
+{
+    return (writer != NULL) && writer_close(writer, "]", false);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteKey(cJSON_Writer * const writer, const char *key)
+{
+    if ((writer == NULL) || !writer_prefix(writer, true))
+    {
+        return false;
+    }
+    if (key == NULL)
+    {
+        return writer_fail(writer);
+    }
+
+    return writer_print(writer, NULL, (const unsigned char*)key) && writer_put(writer, ":", 1);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteString(cJSON_Writer * const writer, const char *string)
+{
+    if ((writer == NULL) || !writer_prefix(writer, false))
+    {
+        return false;
+    }
+
+    /* NULL is written as an empty string, like print_string_ptr does */
+    return writer_print(writer, NULL, (const unsigned char*)string);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteNumber(cJSON_Writer * const writer, const double number)
+{
+    cJSON item;
+
+    if ((writer == NULL) || !writer_prefix(writer, false))
+    {
+        return false;
+    }
+
+    memset(&item, '\0', sizeof(item));
+    item.type = cJSON_Number;
+    item.valuedouble = number;
+
+    return writer_print(writer, &item, NULL);
+}
+
+/* write an optional minus sign and magnitude with the given number of decimals */
+static cJSON_bool writer_digits(cJSON_Writer * const writer, const cJSON_bool negative, unsigned long magnitude, const int decimals)
+{
+    char digits[32];
+    size_t position = sizeof(digits);
+    int count = 0;
+
+    /* digits are generated from the back */
+    do
+    {
+        if ((count == decimals) && (count > 0))
+        {
+            digits[--position] = '.';
+        }
+        digits[--position] = (char)('0' + (magnitude % 10));
+        magnitude /= 10;
+        count++;
+    }
+    while ((magnitude > 0) || (count <= decimals));
+
+    if (negative)
+    {
+        digits[--position] = '-';
+    }
+
+    return writer_put(writer, digits + position, sizeof(digits) - position);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteInteger(cJSON_Writer * const writer, const long number)
+{
+    unsigned long magnitude = 0;
+
+    if ((writer == NULL) || !writer_prefix(writer, false))
+    {
+        return false;
+    }
+
+    /* negate as unsigned, so LONG_MIN works too */
+    magnitude = (number < 0) ? (0UL - (unsigned long)number) : (unsigned long)number;
+
+    return writer_digits(writer, number < 0, magnitude, 0);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteFixed(cJSON_Writer * const writer, const double number, const int decimals)
+{
+    double scaled = (number < 0) ? -number : number;
+    unsigned long magnitude = 0;
+    int count = 0;
+
+    if ((writer == NULL) || (decimals < 0) || (decimals > 9))
+    {
+        return (writer != NULL) && writer_fail(writer);
+    }
+
+    for (count = 0; count < decimals; count++)
+    {
+        scaled *= 10;
+    }
+    scaled += 0.5;
+
+    /* NaN, infinity and numbers out of range for fixed point are left to cJSON_WriteNumber */
+    if (!(scaled < (double)ULONG_MAX))
+    {
+        return cJSON_WriteNumber(writer, number);
+    }
+    if (!writer_prefix(writer, false))
+    {
+        return false;
+    }
+
+    magnitude = (unsigned long)scaled;
+
+    /* no "-0.0" */
+    return writer_digits(writer, (number < 0) && (magnitude > 0), magnitude, decimals);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteBool(cJSON_Writer * const writer, const cJSON_bool boolean)
+{
+    if ((writer == NULL) || !writer_prefix(writer, false))
+    {
+        return false;
+    }
+
+    return boolean ? writer_put(writer, "true", 4) : writer_put(writer, "false", 5);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteNull(cJSON_Writer * const writer)
+{
+    if ((writer == NULL) || !writer_prefix(writer, false))
+    {
+        return false;
+    }
+
+    return writer_put(writer, "null", 4);
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteRaw(cJSON_Writer * const writer, const char *json)
+{
+    if ((writer == NULL) || !writer_prefix(writer, false))
+    {
+        return false;
+    }
+    if ((json == NULL) || (json[0] == '\0'))
+    {
+        return writer_fail(writer);
+    }
+
+    return writer_put(writer, json, strlen(json));
+}
+
+CJSON_PUBLIC(size_t) cJSON_WriterFinish(const cJSON_Writer * const writer)
+{
+    if ((writer == NULL) || writer->failed || (writer->depth > 0))
+    {
+        return 0;
+    }
+
+    return writer->offset;
+}
+
+CJSON_PUBLIC(size_t) cJSON_WriterLength(const cJSON_Writer * const writer)
+{
+    if ((writer == NULL) || writer->failed)
+    {
+        return 0;
+    }
+
+    return writer->offset;
+}
+
+/* Parse a scalar value (null, false, true, string or number) into item. */
+static cJSON_bool parse_scalar(cJSON * const item, parse_buffer * const input_buffer)
+{
+    /* parse the different types of values */
+    /* null */
+    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "null", 4) == 0))
+    {
+        item->type = parsed_type(item, cJSON_NULL);
+        input_buffer->offset += 4;
+        return true;
+    }
+    /* false */
+    if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), "false", 5) == 0))
+    {
+        item->type = parsed_type(item, cJSON_False);
+        input_buffer->offset += 5;
+        return true;
+    }
+    /* true */
+    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "true", 4) == 0))
+    {
+        item->type = parsed_type(item, cJSON_True);
+        item->valueint = 1;
+        input_buffer->offset += 4;
+        return true;
+    }
+    /* string */
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '\"'))
+    {
+        return parse_string(item, input_buffer);
+    }
+    /* number */
+    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || ((buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9'))))
+    {
+        return parse_number(item, input_buffer);
+    }
+
+    return false;
+}
+
+/* Skip whitespace, buffers that aren't zero terminated must not step back at the end. */
+static void skip_whitespace(parse_buffer * const input_buffer, const cJSON_bool terminated)
+{
+    if (terminated)
+    {
+        buffer_skip_whitespace(input_buffer);
+    }
+    else
+    {
+        skip_whitespace_to_end(input_buffer);
+    }
+}
+
+/* Well-known object keys, parsed keys that match one of them point at it instead of a copy. */
+typedef struct
+{
+    const char *key;
+    size_t length;
+} interned_key;
+
+static interned_key interned_keys[CJSON_INTERN_MAX_KEYS];
+static int interned_count = 0;
+
+CJSON_PUBLIC(cJSON_bool) cJSON_InternKeys(const char * const *keys, const int count)
+{
+    int i = 0;
+
+    if ((count < 0) || (count > CJSON_INTERN_MAX_KEYS) || ((keys == NULL) && (count > 0)))
+    {
+        return false;
+    }
+
+    interned_count = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (keys[i] == NULL)
+        {
+            interned_count = 0;
+            return false;
+        }
+        interned_keys[i].key = keys[i];
+        interned_keys[i].length = strlen(keys[i]);
+    }
+    interned_count = count;
+
+    return true;
+}
+
+/* If the key at the current offset has no escape sequences and is interned, point the item's
+ * name at the interned key and move behind it. */
+static cJSON_bool intern_key(cJSON * const item, parse_buffer * const input_buffer)
+{
+    const unsigned char *key_end = NULL;
+    size_t skipped_bytes = 0;
+    size_t length = 0;
+    int i = 0;
+
+    if ((interned_count == 0) || !scan_string(input_buffer, &key_end, &skipped_bytes) || (skipped_bytes != 0))
+    {
+        return false;
+    }
+
+    length = (size_t)(key_end - buffer_at_offset(input_buffer)) - 1;
+    for (i = 0; i < interned_count; i++)
+    {
+        if ((interned_keys[i].length == length) && (memcmp(interned_keys[i].key, buffer_at_offset(input_buffer) + 1, length) == 0))
+        {
+            item->string = (char*)cast_away_const(interned_keys[i].key);
+            item->type |= cJSON_StringIsConst;
+            input_buffer->offset = (size_t)(key_end - input_buffer->content) + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Append a new item to the children of an open array or object (after last_child) and parse the
+ * member's name if it is an object. The offset is left at the start of the value. */
+static cJSON *parse_member(cJSON * const container, cJSON * const last_child, parse_buffer * const input_buffer, const cJSON_bool terminated)
+{
+    cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+    if (new_item == NULL)
+    {
+        return NULL; /* allocation failure */
+    }
+
+    /* attach the item to the list right away, so that it is freed with the rest of the tree on failure */
+    if (last_child == NULL)
+    {
+        /* start the linked list */
+        container->child = new_item;
+    }
+    else
+    {
+        /* add to the end */
+        last_child->next = new_item;
+        new_item->prev = last_child;
+    }
+
+    skip_whitespace(input_buffer, terminated);
+    if ((container->type & 0xFF) == cJSON_Array)
+    {
+        return new_item;
+    }
+
+    /* parse the name of the child */
+    if (cannot_access_at_index(input_buffer, 0) || !intern_key(new_item, input_buffer))
+    {
+        if (!parse_string(new_item, input_buffer))
+        {
+            return NULL; /* failed to parse name */
+        }
+
+        /* swap valuestring and string, because we parsed the name */
+        new_item->string = new_item->valuestring;
+        new_item->valuestring = NULL;
+    }
+    skip_whitespace(input_buffer, terminated);
+
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
+    {
+        return NULL; /* invalid object */
+    }
+
+    /* step to the value */
+    input_buffer->offset++;
+    skip_whitespace(input_buffer, terminated);
+
+    return new_item;
+}
+
+/* Called when the closing bracket of an array or object has been parsed. */
+static void parse_close(cJSON * const container)
+{
+#if (CJSON_INDEX_THRESHOLD > 0) && CJSON_INDEX_ON_PARSE
+    size_t count = 0;
+    cJSON *child = NULL;
+
+    if ((container->type & 0xFF) != cJSON_Object)
+    {
+        return;
+    }
+    for (child = container->child; child != NULL; child = child->next)
+    {
+        count++;
+    }
+    if (count >= CJSON_INDEX_THRESHOLD)
+    {
+        build_index(container, count);
+    }
+#else
+    (void)container;
+#endif
+}
+
+/* Parser core - when encountering text, process appropriately. Arrays and objects are parsed
+ * without recursion, the open ones are kept on the caller supplied stack, which limits the depth. */
+static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer, cJSON ** const stack, const size_t stack_size)
+{
+    cJSON *current_item = item;
+    cJSON *container = NULL;
+    size_t depth = 0;
+    unsigned char character = '\0';
+
+    if ((input_buffer == NULL) || (input_buffer->content == NULL))
+    {
+        return false; /* no input */
+    }
+
+    for (;;)
+    {
+        /* parse the value of current_item */
+        character = can_access_at_index(input_buffer, 0) ? buffer_at_offset(input_buffer)[0] : '\0';
+        if ((character == '[') || (character == '{'))
+        {
+            if ((depth >= stack_size) || (depth >= CJSON_NESTING_LIMIT))
+            {
+                return false; /* to deeply nested */
+            }
+            current_item->type = parsed_type(current_item, (character == '[') ? cJSON_Array : cJSON_Object);
+            stack[depth] = current_item;
+            depth++;
+
+            input_buffer->offset++;
+            buffer_skip_whitespace(input_buffer);
+            if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ((character == '[') ? ']' : '}')))
+            {
+                /* empty array or object, closed below */
+                current_item = NULL;
+            }
+            else
+            {
+                /* check if we skipped to the end of the buffer */
+                if (cannot_access_at_index(input_buffer, 0))
+                {
+                    input_buffer->offset--;
+                    return false;
+                }
+
+                current_item = parse_member(stack[depth - 1], NULL, input_buffer, true);
+                if (current_item == NULL)
+                {
+                    return false;
+                }
+                continue;
+            }
+        }
+        else if (!parse_scalar(current_item, input_buffer))
+        {
+            return false;
+        }
+
+        /* a value is complete, move on to the next member or close the containers that are complete */
+        for (;;)
+        {
+            if (depth == 0)
+            {
+                return true;
+            }
+            container = stack[depth - 1];
+
+            if (current_item != NULL)
+            {
+                buffer_skip_whitespace(input_buffer);
+                if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','))
+                {
+                    input_buffer->offset++;
+                    current_item = parse_member(container, current_item, input_buffer, true);
+                    if (current_item == NULL)
+                    {
+                        return false;
+                    }
+                    break;
+                }
+            }
+
+            if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != (((container->type & 0xFF) == cJSON_Array) ? ']' : '}')))
+            {
+                return false; /* expected end of array or object */
+            }
+            input_buffer->offset++;
+            parse_close(container);
+            depth--;
+            current_item = container;
+        }
+    }
+}
+
+/* Render a value that is neither an array nor an object to text. */
+static cJSON_bool print_scalar(const cJSON * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output = NULL;
+
+    switch ((item->type) & 0xFF)
+    {
+        case cJSON_NULL:
+            output = ensure(output_buffer, 5);
+            if (output == NULL)
+            {
+                return false;
+            }
+            strcpy((char*)output, "null");
+            return true;
+
+        case cJSON_False:
+            output = ensure(output_buffer, 6);
+            if (output == NULL)
+            {
+                return false;
+            }
+            strcpy((char*)output, "false");
+            return true;
+
+        case cJSON_True:
+            output = ensure(output_buffer, 5);
+            if (output == NULL)
+            {
+                return false;
+            }
+            strcpy((char*)output, "true");
+            return true;
+
+        case cJSON_Number:
+            return print_number(item, output_buffer);
+
+        case cJSON_Raw:
+        {
+            size_t raw_length = 0;
+            if (item->valuestring == NULL)
+            {
+                return false;
+            }
+
+            raw_length = strlen(item->valuestring) + sizeof("");
+            output = ensure(output_buffer, raw_length);
+            if (output == NULL)
+            {
+                return false;
+            }
+            memcpy(output, item->valuestring, raw_length);
+            return true;
+        }
+
+        case cJSON_String:
+            return print_string(item, output_buffer);
+
+        default:
+            return false;
     }
-    else /* otherwise copy the JSON over to a new buffer */
+}
+
+/* Write the opening bracket of an array or object. */
+static cJSON_bool print_open(const cJSON * const item, printbuffer * const output_buffer)
+{
+    const cJSON_bool is_object = ((item->type & 0xFF) == cJSON_Object);
+    size_t length = (size_t) ((is_object && output_buffer->format) ? 2 : 1); /* fmt: {\n */
+    unsigned char *output_pointer = ensure(output_buffer, length + 1);
+
+    if (output_pointer == NULL)
     {
-        printed = (unsigned char*) hooks->allocate(buffer->offset + 1);
-        if (printed == NULL)
+        return false;
+    }
+
+    *output_pointer++ = is_object ? '{' : '[';
+    if (is_object && output_buffer->format)
+    {
+        *output_pointer++ = '\n';
+    }
+    *output_pointer = '\0';
+    output_buffer->offset += length;
+    output_buffer->depth++;
+
+    return true;
+}
+
+/* Write the indentation and key of an object member. */
+static cJSON_bool print_key(const cJSON * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    size_t length = 0;
+
+    if (output_buffer->format)
+    {
+        size_t i;
+        output_pointer = ensure(output_buffer, output_buffer->depth);
+        if (output_pointer == NULL)
         {
-            goto fail;
+            return false;
         }
-        memcpy(printed, buffer->buffer, cjson_min(buffer->length, buffer->offset + 1));
-        printed[buffer->offset] = '\0'; /* just to be sure */
+        for (i = 0; i < output_buffer->depth; i++)
+        {
+            *output_pointer++ = '\t';
+        }
+        output_buffer->offset += output_buffer->depth;
+    }
 
-        /* free the buffer */
-        hooks->deallocate(buffer->buffer);
+    /* print key */
+    if (!print_string_ptr((unsigned char*)item->string, output_buffer))
+    {
+        return false;
     }
+    update_offset(output_buffer);
 
-    return printed;
+    length = (size_t) (output_buffer->format ? 2 : 1);
+    output_pointer = ensure(output_buffer, length);
+    if (output_pointer == NULL)
+    {
+        return false;
+    }
+    *output_pointer++ = ':';
+    if (output_buffer->format)
+    {
+        *output_pointer++ = '\t';
+    }
+    output_buffer->offset += length;
 
-fail:
-    if (buffer->buffer != NULL)
+    return true;
+}
+
+/* Write what follows a member of the given container: the comma if it isn't the last one and
+ * in formatted output the space or line break. */
+static cJSON_bool print_separator(const cJSON * const container, const cJSON * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    size_t length = 0;
+
+    if ((container->type & 0xFF) == cJSON_Array)
     {
-        hooks->deallocate(buffer->buffer);
+        if (item->next == NULL)
+        {
+            return true;
+        }
+        length = (size_t) (output_buffer->format ? 2 : 1);
+        output_pointer = ensure(output_buffer, length + 1);
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+        *output_pointer++ = ',';
+        if(output_buffer->format)
+        {
+            *output_pointer++ = ' ';
+        }
+        *output_pointer = '\0';
+        output_buffer->offset += length;
+
+        return true;
     }
 
-    if (printed != NULL)
+    /* print comma if not last */
+    length = ((size_t)(output_buffer->format ? 1 : 0) + (size_t)(item->next ? 1 : 0));
+    output_pointer = ensure(output_buffer, length + 1);
+    if (output_pointer == NULL)
     {
-        hooks->deallocate(printed);
+        return false;
+    }
+    if (item->next)
+    {
+        *output_pointer++ = ',';
     }
 
-    return NULL;
+    if (output_buffer->format)
+    {
+        *output_pointer++ = '\n';
+    }
+    *output_pointer = '\0';
+    output_buffer->offset += length;
+
+    return true;
 }
 
-/* Render a cJSON item/entity/structure to text. */
-CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item)
+/* Write the closing bracket of an array or object. */
+static cJSON_bool print_close(const cJSON * const item, printbuffer * const output_buffer)
 {
-    return (char*)print(item, true, &global_hooks);
+    unsigned char *output_pointer = NULL;
+
+    if ((item->type & 0xFF) == cJSON_Array)
+    {
+        output_pointer = ensure(output_buffer, 2);
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        output_pointer = ensure(output_buffer, output_buffer->format ? (output_buffer->depth + 1) : 2);
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+        if (output_buffer->format)
+        {
+            size_t i;
+            for (i = 0; i < (output_buffer->depth - 1); i++)
+            {
+                *output_pointer++ = '\t';
+            }
+        }
+    }
+    *output_pointer++ = ((item->type & 0xFF) == cJSON_Array) ? ']' : '}';
+    *output_pointer = '\0';
+    output_buffer->depth--;
+    update_offset(output_buffer);
+
+    return true;
 }
 
-CJSON_PUBLIC(char *) cJSON_PrintUnformatted(const cJSON *item)
+/* Render a value to text. Arrays and objects are printed without recursion, the open ones are kept
+ * on the caller supplied stack, which limits the depth. */
+static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer, const cJSON ** const stack, const size_t stack_size)
 {
-    return (char*)print(item, false, &global_hooks);
+    const cJSON *current_item = item;
+    const cJSON *container = NULL;
+    size_t depth = 0;
+
+    if ((item == NULL) || (output_buffer == NULL))
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        /* print current_item */
+        if (current_item->type & cJSON_IsLazy)
+        {
+            /* not parsed yet, copy the text */
+            unsigned char *output = ensure(output_buffer, (size_t)current_item->valueint + sizeof(""));
+            if (output == NULL)
+            {
+                return false;
+            }
+            memcpy(output, current_item->valuestring, (size_t)current_item->valueint);
+            output[current_item->valueint] = '\0';
+            output_buffer->offset += (size_t)current_item->valueint;
+        }
+        else if (((current_item->type & 0xFF) == cJSON_Array) || ((current_item->type & 0xFF) == cJSON_Object))
+        {
+            if ((depth >= stack_size) || !print_open(current_item, output_buffer))
+            {
+                return false;
+            }
+            if (current_item->child != NULL)
+            {
+                stack[depth] = current_item;
+                depth++;
+                current_item = current_item->child;
+                if (((stack[depth - 1]->type & 0xFF) == cJSON_Object) && !print_key(current_item, output_buffer))
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (!print_close(current_item, output_buffer))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (!print_scalar(current_item, output_buffer))
+            {
+                return false;
+            }
+            update_offset(output_buffer);
+        }
+
+        /* a value is complete, move on to the next member or close the containers that are complete */
+        for (;;)
+        {
+            if (depth == 0)
+            {
+                return true;
+            }
+            container = stack[depth - 1];
+
+            if (!print_separator(container, current_item, output_buffer))
+            {
+                return false;
+            }
+            if (current_item->next != NULL)
+            {
+                current_item = current_item->next;
+                if (((container->type & 0xFF) == cJSON_Object) && !print_key(current_item, output_buffer))
+                {
+                    return false;
+                }
+                break;
+            }
+
+            if (!print_close(container, output_buffer))
+            {
+                return false;
+            }
+            depth--;
+            current_item = container;
+        }
+    }
 }
 
-CJSON_PUBLIC(char *) cJSON_PrintBuffered(const cJSON *item, int prebuffer, cJSON_bool fmt)
+/* Parse one level of the array or object at the current offset. Arrays and objects inside it are
+ * only skipped bracket by bracket and become lazy items that point to their text. */
+static cJSON_bool parse_level(cJSON * const container, parse_buffer * const input_buffer)
 {
-    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 } };
+    cJSON *current_item = NULL;
+    const unsigned char opening = buffer_at_offset(input_buffer)[0];
+    const unsigned char closing = (opening == '[') ? ']' : '}';
+    unsigned char character = '\0';
+    size_t start = 0;
 
-    if (prebuffer < 0)
+    container->type = parsed_type(container, (opening == '[') ? cJSON_Array : cJSON_Object);
+
+    input_buffer->offset++;
+    skip_whitespace_to_end(input_buffer);
+    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == closing))
     {
-        return NULL;
+        input_buffer->offset++;
+        return true; /* empty array or object */
     }
 
-    p.buffer = (unsigned char*)global_hooks.allocate((size_t)prebuffer);
-    if (!p.buffer)
+    /* check if we skipped to the end of the buffer */
+    if (cannot_access_at_index(input_buffer, 0))
     {
-        return NULL;
+        return false;
     }
 
-    p.length = (size_t)prebuffer;
-    p.offset = 0;
-    p.noalloc = false;
-    p.format = fmt;
-    p.hooks = global_hooks;
+    do
+    {
+        current_item = parse_member(container, current_item, input_buffer, false);
+        if (current_item == NULL)
+        {
+            return false;
+        }
+
+        character = can_access_at_index(input_buffer, 0) ? buffer_at_offset(input_buffer)[0] : '\0';
+        if ((character == '[') || (character == '{'))
+        {
+            start = input_buffer->offset;
+            if (!skip_value(input_buffer) || ((input_buffer->offset - start) > INT_MAX))
+            {
+                return false;
+            }
+            current_item->type = parsed_type(current_item, ((character == '[') ? cJSON_Array : cJSON_Object) | cJSON_IsLazy);
+            current_item->valuestring = (char*)cast_away_const(input_buffer->content + start);
+            current_item->valueint = (int)(input_buffer->offset - start);
+        }
+        else if (!parse_scalar(current_item, input_buffer))
+        {
+            return false;
+        }
+        skip_whitespace_to_end(input_buffer);
+
+        if (!can_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ','))
+        {
+            break;
+        }
+        input_buffer->offset++;
+    }
+    while (true);
 
-    if (!print_value(item, &p))
+    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != closing))
     {
-        global_hooks.deallocate(p.buffer);
-        return NULL;
+        return false; /* expected end of array or object */
     }
+    input_buffer->offset++;
 
-    return (char*)p.buffer;
+    return true;
 }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buf, const int len, const cJSON_bool fmt)
+CJSON_PUBLIC(cJSON *) cJSON_ParseLazy(const char *value, size_t buffer_length, const char **return_parse_end)
 {
-    printbuffer p = { 0, 0, 0, 0, 0, 0, { 0, 0, 0 } };
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    cJSON *item = NULL;
+
+    /* reset error position */
+    global_error.json = NULL;
+    global_error.position = 0;
 
-    if ((len < 0) || (buf == NULL))
+    if ((value == NULL) || (buffer_length == 0))
     {
-        return false;
+        goto fail;
     }
 
-    p.buffer = (unsigned char*)buf;
-    p.length = (size_t)len;
-    p.offset = 0;
-    p.noalloc = true;
-    p.format = fmt;
-    p.hooks = global_hooks;
-
-    return print_value(item, &p);
-}
+    buffer.content = (const unsigned char*)value;
+    buffer.length = buffer_length;
+    buffer.offset = 0;
+    buffer.hooks = global_hooks;
 
-/* Parser core - when encountering text, process appropriately. */
-static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer)
-{
-    if ((input_buffer == NULL) || (input_buffer->content == NULL))
+    if (skip_utf8_bom(&buffer) == NULL)
     {
-        return false; /* no input */
+        goto fail;
     }
+    skip_whitespace_to_end(&buffer);
 
-    /* parse the different types of values */
-    /* null */
-    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "null", 4) == 0))
+    item = cJSON_New_Item(&global_hooks);
+    if (item == NULL) /* memory fail */
     {
-        item->type = cJSON_NULL;
-        input_buffer->offset += 4;
-        return true;
+        goto fail;
     }
-    /* false */
-    if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), "false", 5) == 0))
+
+    if (can_access_at_index(&buffer, 0) && ((buffer_at_offset(&buffer)[0] == '[') || (buffer_at_offset(&buffer)[0] == '{')))
     {
-        item->type = cJSON_False;
-        input_buffer->offset += 5;
-        return true;
+        if (!parse_level(item, &buffer))
+        {
+            goto fail;
+        }
+        parse_close(item);
     }
-    /* true */
-    if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "true", 4) == 0))
+    else if (!parse_scalar(item, &buffer))
     {
-        item->type = cJSON_True;
-        item->valueint = 1;
-        input_buffer->offset += 4;
-        return true;
+        goto fail;
     }
-    /* string */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '\"'))
+
+    /* only whitespace or the zero terminator may follow */
+    skip_whitespace_to_end(&buffer);
+    if (can_access_at_index(&buffer, 0) && (buffer_at_offset(&buffer)[0] != '\0'))
     {
-        return parse_string(item, input_buffer);
+        goto fail;
     }
-    /* number */
-    if (can_access_at_index(input_buffer, 0) && ((buffer_at_offset(input_buffer)[0] == '-') || ((buffer_at_offset(input_buffer)[0] >= '0') && (buffer_at_offset(input_buffer)[0] <= '9'))))
+    if (return_parse_end != NULL)
     {
-        return parse_number(item, input_buffer);
+        *return_parse_end = (const char*)buffer_at_offset(&buffer);
     }
-    /* array */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '['))
+
+    return item;
+
+fail:
+    if (item != NULL)
     {
-        return parse_array(item, input_buffer);
+        cJSON_Delete(item);
     }
-    /* object */
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '{'))
+
+    if (value != NULL)
     {
-        return parse_object(item, input_buffer);
+        error local_error;
+        local_error.json = (const unsigned char*)value;
+        local_error.position = 0;
+
+        if (buffer.offset < buffer.length)
+        {
+            local_error.position = buffer.offset;
+        }
+        else if (buffer.length > 0)
+        {
+            local_error.position = buffer.length - 1;
+        }
+
+        if (return_parse_end != NULL)
+        {
+            *return_parse_end = (const char*)local_error.json + local_error.position;
+        }
+
+        global_error = local_error;
     }
 
-    return false;
+    return NULL;
 }
 
-/* Render a value to text. */
-static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer)
+CJSON_PUBLIC(cJSON_bool) cJSON_Materialize(cJSON * const item)
 {
-    unsigned char *output = NULL;
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    int flags = 0;
 
-    if ((item == NULL) || (output_buffer == NULL))
+    if (item == NULL)
     {
         return false;
     }
-
-    switch ((item->type) & 0xFF)
+    if (!(item->type & cJSON_IsLazy))
     {
-        case cJSON_NULL:
-            output = ensure(output_buffer, 5);
-            if (output == NULL)
-            {
-                return false;
-            }
-            strcpy((char*)output, "null");
-            return true;
+        return true;
+    }
 
-        case cJSON_False:
-            output = ensure(output_buffer, 6);
-            if (output == NULL)
-            {
-                return false;
-            }
-            strcpy((char*)output, "false");
-            return true;
+    buffer.content = (const unsigned char*)item->valuestring;
+    buffer.length = (size_t)item->valueint;
+    buffer.offset = 0;
+    buffer.hooks = global_hooks;
 
-        case cJSON_True:
-            output = ensure(output_buffer, 5);
-            if (output == NULL)
-            {
-                return false;
-            }
-            strcpy((char*)output, "true");
-            return true;
+    /* the text is borrowed, forget it before the members are parsed */
+    flags = item->type & ~(0xFF | cJSON_IsLazy);
+    item->valuestring = NULL;
+    item->valueint = 0;
 
-        case cJSON_Number:
-            return print_number(item, output_buffer);
+    if (!parse_level(item, &buffer))
+    {
+        /* the brackets matched, but the contents are invalid, leave an empty array or object */
+        cJSON_Delete(item->child);
+        item->child = NULL;
+        item->type |= flags;
+        return false;
+    }
+    item->type |= flags;
+    parse_close(item);
 
-        case cJSON_Raw:
-        {
-            size_t raw_length = 0;
-            if (item->valuestring == NULL)
-            {
-                return false;
-            }
+    return true;
+}
 
-            raw_length = strlen(item->valuestring) + sizeof("");
-            output = ensure(output_buffer, raw_length);
-            if (output == NULL)
-            {
-                return false;
-            }
-            memcpy(output, item->valuestring, raw_length);
-            return true;
-        }
+/* Lazy items are materialized when they are accessed, even through a const pointer: like the
+ * object index, this only changes how the value is stored, not the value. */
+static void materialize(const cJSON * const item)
+{
+    if ((item != NULL) && (item->type & cJSON_IsLazy))
+    {
+        cJSON_Materialize((cJSON*)cast_away_const(item));
+    }
+}
 
-        case cJSON_String:
-            return print_string(item, output_buffer);
+/* Get Array size/item / object item. */
+CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
+{
+    cJSON *child = NULL;
+    size_t size = 0;
 
-        case cJSON_Array:
-            return print_array(item, output_buffer);
+    if (array == NULL)
+    {
+        return 0;
+    }
 
-        case cJSON_Object:
-            return print_object(item, output_buffer);
+    materialize(array);
+    child = array->child;
 
-        default:
-            return false;
+    while(child != NULL)
+    {
+        size++;
+        child = child->next;
     }
+
+    /* FIXME: Can overflow here. Cannot be fixed without breaking the API */
+
+    return (int)size;
 }
 
-/* Build an array from input text. */
-static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buffer)
+static cJSON* get_array_item(const cJSON *array, size_t index)
 {
-    cJSON *head = NULL; /* head of the linked list */
-    cJSON *current_item = NULL;
+    cJSON *current_child = NULL;
 
-    if (input_buffer->depth >= CJSON_NESTING_LIMIT)
+    if (array == NULL)
     {
-        return false; /* to deeply nested */
+        return NULL;
     }
-    input_buffer->depth++;
 
-    if (buffer_at_offset(input_buffer)[0] != '[')
+    materialize(array);
+    current_child = array->child;
+    while ((current_child != NULL) && (index > 0))
     {
-        /* not an array */
-        goto fail;
+        index--;
+        current_child = current_child->next;
     }
 
-    input_buffer->offset++;
-    buffer_skip_whitespace(input_buffer);
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ']'))
+    return current_child;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    if (index < 0)
     {
-        /* empty array */
-        goto success;
+        return NULL;
     }
 
-    /* check if we skipped to the end of the buffer */
-    if (cannot_access_at_index(input_buffer, 0))
+    return get_array_item(array, (size_t)index);
+}
+
+static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
+{
+    cJSON *current_element = NULL;
+
+    if ((object == NULL) || (name == NULL))
     {
-        input_buffer->offset--;
-        goto fail;
+        return NULL;
     }
 
-    /* step back to character in front of the first element */
-    input_buffer->offset--;
-    /* loop through the comma separated array elements */
-    do
+    materialize(object);
+#if CJSON_INDEX_THRESHOLD > 0
+    if ((object->index == NULL) && ((object->type & 0xFF) == cJSON_Object) && !(object->type & cJSON_IsReference))
     {
-        /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
-        if (new_item == NULL)
-        {
-            goto fail; /* allocation failure */
-        }
-
-        /* attach next item to list */
-        if (head == NULL)
+        size_t count = 0;
+        for (current_element = object->child; (current_element != NULL) && (count < CJSON_INDEX_THRESHOLD); current_element = current_element->next)
         {
-            /* start the linked list */
-            current_item = head = new_item;
+            count++;
         }
-        else
+        if (current_element != NULL)
         {
-            /* add to the end and advance */
-            current_item->next = new_item;
-            new_item->prev = current_item;
-            current_item = new_item;
+            /* large object, count the rest and build the index. The index is a cache, so it is fine to build it for a const object */
+            for (; current_element != NULL; current_element = current_element->next)
+            {
+                count++;
+            }
+            build_index((cJSON*)cast_away_const(object), count);
         }
+    }
+    if (object->index != NULL)
+    {
+        return index_lookup(object->index, name, case_sensitive);
+    }
+#endif
 
-        /* parse next value */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_value(current_item, input_buffer))
+    current_element = object->child;
+    if (case_sensitive)
+    {
+        while ((current_element != NULL) && (current_element->string != NULL) && (current_element->string != name) && (strcmp(name, current_element->string) != 0))
         {
-            goto fail; /* failed to parse value */
+            current_element = current_element->next;
         }
-        buffer_skip_whitespace(input_buffer);
     }
-    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
-
-    if (cannot_access_at_index(input_buffer, 0) || buffer_at_offset(input_buffer)[0] != ']')
+    else
     {
-        goto fail; /* expected end of array */
+        while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
+        {
+            current_element = current_element->next;
+        }
     }
 
-success:
-    input_buffer->depth--;
-
-    item->type = cJSON_Array;
-    item->child = head;
-
-    input_buffer->offset++;
-
-    return true;
-
-fail:
-    if (head != NULL)
-    {
-        cJSON_Delete(head);
+    if ((current_element == NULL) || (current_element->string == NULL)) {
+        return NULL;
     }
 
-    return false;
+    return current_element;
 }
 
-/* Render an array to text */
-static cJSON_bool print_array(const cJSON * const item, printbuffer * const output_buffer)
+CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string)
 {
-    unsigned char *output_pointer = NULL;
-    size_t length = 0;
-    cJSON *current_element = item->child;
+    return get_object_item(object, string, false);
+}
 
-    if (output_buffer == NULL)
-    {
-        return false;
-    }
+CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string)
+{
+    return get_object_item(object, string, true);
+}
 
-    /* Compose the output array. */
-    /* opening square bracket */
-    output_pointer = ensure(output_buffer, 1);
-    if (output_pointer == NULL)
+CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string)
+{
+    return cJSON_GetObjectItem(object, string) ? 1 : 0;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_CompilePath(cJSON_Path * const path, const char *expression, const cJSON_bool case_sensitive)
+{
+    const char *segment_end = NULL;
+    cJSON_PathSegment *segment = NULL;
+
+    if ((path == NULL) || (expression == NULL))
     {
         return false;
     }
 
-    *output_pointer = '[';
-    output_buffer->offset++;
-    output_buffer->depth++;
+    path->count = 0;
+    path->case_sensitive = case_sensitive;
 
-    while (current_element != NULL)
+    for (;;)
     {
-        if (!print_value(current_element, output_buffer))
+        segment_end = expression;
+        while ((*segment_end != '\0') && (*segment_end != '.'))
         {
-            return false;
+            segment_end++;
         }
-        update_offset(output_buffer);
-        if (current_element->next)
+
+        /* empty keys and too many keys are rejected */
+        if ((segment_end == expression) || (path->count >= CJSON_PATH_MAX_SEGMENTS))
         {
-            length = (size_t) (output_buffer->format ? 2 : 1);
-            output_pointer = ensure(output_buffer, length + 1);
-            if (output_pointer == NULL)
-            {
-                return false;
-            }
-            *output_pointer++ = ',';
-            if(output_buffer->format)
-            {
-                *output_pointer++ = ' ';
-            }
-            *output_pointer = '\0';
-            output_buffer->offset += length;
+            path->count = 0;
+            return false;
         }
-        current_element = current_element->next;
-    }
 
-    output_pointer = ensure(output_buffer, 2);
-    if (output_pointer == NULL)
-    {
-        return false;
-    }
-    *output_pointer++ = ']';
-    *output_pointer = '\0';
-    output_buffer->depth--;
+        segment = &path->segments[path->count];
+        segment->key = expression;
+        segment->length = (size_t)(segment_end - expression);
+        segment->hash = hash_key((const unsigned char*)expression, segment->length);
+        path->count++;
 
-    return true;
+        if (*segment_end == '\0')
+        {
+            return true;
+        }
+        expression = segment_end + 1;
+    }
 }
 
-/* Build an object from the text. */
-static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_buffer)
+/* compare a key of known length and hash to a path segment, the hash rules out almost all mismatches */
+static cJSON_bool segment_equals(const cJSON_PathSegment * const segment, const unsigned char * const key, const size_t length, const unsigned long hash, const cJSON_bool case_sensitive)
 {
-    cJSON *head = NULL; /* linked list head */
-    cJSON *current_item = NULL;
+    size_t position = 0;
 
-    if (input_buffer->depth >= CJSON_NESTING_LIMIT)
+    if ((segment->hash != hash) || (segment->length != length))
     {
-        return false; /* to deeply nested */
+        return false;
     }
-    input_buffer->depth++;
 
-    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '{'))
+    if (case_sensitive)
     {
-        goto fail; /* not an object */
+        return memcmp(segment->key, key, length) == 0;
     }
 
-    input_buffer->offset++;
-    buffer_skip_whitespace(input_buffer);
-    if (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == '}'))
+    for (position = 0; position < length; position++)
     {
-        goto success; /* empty object */
+        if (tolower(((const unsigned char*)segment->key)[position]) != tolower(key[position]))
+        {
+            return false;
+        }
     }
 
-    /* check if we skipped to the end of the buffer */
-    if (cannot_access_at_index(input_buffer, 0))
-    {
-        input_buffer->offset--;
-        goto fail;
-    }
+    return true;
+}
 
-    /* step back to character in front of the first element */
-    input_buffer->offset--;
-    /* loop through the comma separated array elements */
-    do
+/* match a member key against the given segment of every path in pending. Matching paths are removed
+ * from pending (only the first matching member counts) and sorted into leaf and descend. */
+static void match_paths(const cJSON_Path * const paths, const size_t depth, unsigned long * const pending, const unsigned char * const key, const size_t length, unsigned long * const leaf, unsigned long * const descend)
+{
+    const unsigned long hash = hash_key(key, length);
+    unsigned long remaining = *pending;
+    unsigned long bit = 0;
+    int index = 0;
+
+    *leaf = 0;
+    *descend = 0;
+    for (index = 0; remaining != 0; index++)
     {
-        /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
-        if (new_item == NULL)
+        bit = 1UL << index;
+        if ((remaining & bit) == 0)
         {
-            goto fail; /* allocation failure */
+            continue;
         }
+        remaining &= ~bit;
 
-        /* attach next item to list */
-        if (head == NULL)
-        {
-            /* start the linked list */
-            current_item = head = new_item;
-        }
-        else
+        if (segment_equals(&paths[index].segments[depth], key, length, hash, paths[index].case_sensitive))
         {
-            /* add to the end and advance */
-            current_item->next = new_item;
-            new_item->prev = current_item;
-            current_item = new_item;
+            *pending &= ~bit;
+            if ((depth + 1) == paths[index].count)
+            {
+                *leaf |= bit;
+            }
+            else
+            {
+                *descend |= bit;
+            }
         }
+    }
+}
 
-        /* parse the name of the child */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_string(current_item, input_buffer))
+/* the recursion is bounded by CJSON_PATH_MAX_SEGMENTS */
+static void resolve_paths(const cJSON * const object, const size_t depth, const cJSON_Path * const paths, unsigned long pending, cJSON **results, int * const found)
+{
+    cJSON *child = NULL;
+    unsigned long leaf = 0;
+    unsigned long descend = 0;
+    int index = 0;
+
+    for (child = object->child; (child != NULL) && (pending != 0); child = child->next)
+    {
+        if (child->string == NULL)
         {
-            goto fail; /* failed to parse name */
+            continue;
         }
-        buffer_skip_whitespace(input_buffer);
 
-        /* swap valuestring and string, because we parsed the name */
-        current_item->string = current_item->valuestring;
-        current_item->valuestring = NULL;
-
-        if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
+        match_paths(paths, depth, &pending, (const unsigned char*)child->string, strlen(child->string), &leaf, &descend);
+        for (index = 0; leaf != 0; index++, leaf >>= 1)
         {
-            goto fail; /* invalid object */
+            if (leaf & 1)
+            {
+                results[index] = child;
+                (*found)++;
+            }
         }
 
-        /* parse the value */
-        input_buffer->offset++;
-        buffer_skip_whitespace(input_buffer);
-        if (!parse_value(current_item, input_buffer))
+        if ((descend != 0) && cJSON_IsObject(child))
         {
-            goto fail; /* failed to parse value */
+            materialize(child);
+            resolve_paths(child, depth + 1, paths, descend, results, found);
         }
-        buffer_skip_whitespace(input_buffer);
     }
-    while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
+}
 
-    if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != '}'))
+/* bit mask of the non empty paths */
+static unsigned long path_mask(const cJSON_Path * const paths, const int count)
+{
+    unsigned long mask = 0;
+    int index = 0;
+
+    for (index = 0; index < count; index++)
     {
-        goto fail; /* expected end of object */
+        if (paths[index].count > 0)
+        {
+            mask |= 1UL << index;
+        }
     }
 
-success:
-    input_buffer->depth--;
+    return mask;
+}
 
-    item->type = cJSON_Object;
-    item->child = head;
+CJSON_PUBLIC(int) cJSON_ResolvePaths(const cJSON * const root, const cJSON_Path * const paths, const int count, cJSON **results)
+{
+    int found = 0;
+    int index = 0;
 
-    input_buffer->offset++;
-    return true;
+    if ((paths == NULL) || (results == NULL) || (count <= 0) || (count > CJSON_PATH_MAX_QUERIES))
+    {
+        return 0;
+    }
 
-fail:
-    if (head != NULL)
+    for (index = 0; index < count; index++)
     {
-        cJSON_Delete(head);
+        results[index] = NULL;
     }
 
-    return false;
+    if (cJSON_IsObject(root))
+    {
+        resolve_paths(root, 0, paths, path_mask(paths, count), results, &found);
+    }
+
+    return found;
 }
 
-/* Render an object to text. */
-static cJSON_bool print_object(const cJSON * const item, printbuffer * const output_buffer)
+/* state of cJSON_ParsePaths */
+typedef struct
 {
-    unsigned char *output_pointer = NULL;
-    size_t length = 0;
-    cJSON *current_item = item->child;
+    const cJSON_Path *paths;
+    cJSON_PathCallback callback;
+    void *user_data;
+    unsigned long all;
+    unsigned long leaf; /* paths that end at the current member */
+    unsigned long descend; /* paths that continue into the current member */
+    size_t depth; /* number of open objects */
+    unsigned long pending[CJSON_PATH_MAX_SEGMENTS]; /* paths not matched yet in each open object */
+} path_scan;
+
+static int path_scan_object_start(void *user_data)
+{
+    path_scan * const scan = (path_scan*)user_data;
 
-    if (output_buffer == NULL)
+    if (scan->depth == 0)
     {
-        return false;
+        scan->pending[0] = scan->all;
     }
-
-    /* Compose the output: */
-    length = (size_t) (output_buffer->format ? 2 : 1); /* fmt: {\n */
-    output_pointer = ensure(output_buffer, length + 1);
-    if (output_pointer == NULL)
+    else if ((scan->descend != 0) && (scan->depth < CJSON_PATH_MAX_SEGMENTS))
     {
-        return false;
+        scan->pending[scan->depth] = scan->descend;
     }
-
-    *output_pointer++ = '{';
-    output_buffer->depth++;
-    if (output_buffer->format)
+    else
     {
-        *output_pointer++ = '\n';
+        scan->leaf = 0;
+        scan->descend = 0;
+        return cJSON_SAX_Skip;
     }
-    output_buffer->offset += length;
 
-    while (current_item)
-    {
-        if (output_buffer->format)
-        {
-            size_t i;
-            output_pointer = ensure(output_buffer, output_buffer->depth);
-            if (output_pointer == NULL)
-            {
-                return false;
-            }
-            for (i = 0; i < output_buffer->depth; i++)
-            {
-                *output_pointer++ = '\t';
-            }
-            output_buffer->offset += output_buffer->depth;
-        }
+    scan->depth++;
+    scan->leaf = 0;
+    scan->descend = 0;
+    return cJSON_SAX_Continue;
+}
 
-        /* print key */
-        if (!print_string_ptr((unsigned char*)current_item->string, output_buffer))
-        {
-            return false;
-        }
-        update_offset(output_buffer);
+static int path_scan_object_end(void *user_data)
+{
+    path_scan * const scan = (path_scan*)user_data;
 
-        length = (size_t) (output_buffer->format ? 2 : 1);
-        output_pointer = ensure(output_buffer, length);
-        if (output_pointer == NULL)
-        {
-            return false;
-        }
-        *output_pointer++ = ':';
-        if (output_buffer->format)
-        {
-            *output_pointer++ = '\t';
-        }
-        output_buffer->offset += length;
+    scan->depth--;
+    return cJSON_SAX_Continue;
+}
 
-        /* print value */
-        if (!print_value(current_item, output_buffer))
-        {
-            return false;
-        }
-        update_offset(output_buffer);
+static int path_scan_array_start(void *user_data)
+{
+    path_scan * const scan = (path_scan*)user_data;
 
-        /* print comma if not last */
-        length = ((size_t)(output_buffer->format ? 1 : 0) + (size_t)(current_item->next ? 1 : 0));
-        output_pointer = ensure(output_buffer, length + 1);
-        if (output_pointer == NULL)
-        {
-            return false;
-        }
-        if (current_item->next)
-        {
-            *output_pointer++ = ',';
-        }
+    /* paths only consist of keys, so arrays never lead anywhere */
+    scan->leaf = 0;
+    scan->descend = 0;
+    return cJSON_SAX_Skip;
+}
 
-        if (output_buffer->format)
-        {
-            *output_pointer++ = '\n';
-        }
-        *output_pointer = '\0';
-        output_buffer->offset += length;
+static int path_scan_key(void *user_data, const char *key, size_t length)
+{
+    path_scan * const scan = (path_scan*)user_data;
 
-        current_item = current_item->next;
-    }
+    match_paths(scan->paths, scan->depth - 1, &scan->pending[scan->depth - 1], (const unsigned char*)key, length, &scan->leaf, &scan->descend);
 
-    output_pointer = ensure(output_buffer, output_buffer->format ? (output_buffer->depth + 1) : 2);
-    if (output_pointer == NULL)
-    {
-        return false;
-    }
-    if (output_buffer->format)
+    return ((scan->leaf | scan->descend) != 0) ? cJSON_SAX_Continue : cJSON_SAX_Skip;
+}
+
+/* pass a scalar value to the callback for every path that ends here */
+static int path_scan_report(path_scan * const scan, const cJSON * const value)
+{
+    unsigned long leaf = scan->leaf;
+    int index = 0;
+
+    scan->leaf = 0;
+    scan->descend = 0;
+    for (index = 0; leaf != 0; index++, leaf >>= 1)
     {
-        size_t i;
-        for (i = 0; i < (output_buffer->depth - 1); i++)
+        if ((leaf & 1) && (scan->callback(scan->user_data, index, value) == cJSON_SAX_Abort))
         {
-            *output_pointer++ = '\t';
+            return cJSON_SAX_Abort;
         }
     }
-    *output_pointer++ = '}';
-    *output_pointer = '\0';
-    output_buffer->depth--;
 
-    return true;
+    return cJSON_SAX_Continue;
 }
 
-/* Get Array size/item / object item. */
-CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
+static int path_scan_string(void *user_data, const char *string, size_t length)
 {
-    cJSON *child = NULL;
-    size_t size = 0;
+    path_scan * const scan = (path_scan*)user_data;
+    char copy[CJSON_SAX_SCRATCH_SIZE];
+    cJSON value;
 
-    if (array == NULL)
+    if (scan->leaf == 0)
     {
-        return 0;
+        return cJSON_SAX_Continue;
     }
-
-    child = array->child;
-
-    while(child != NULL)
+    if (length >= sizeof(copy))
     {
-        size++;
-        child = child->next;
+        return cJSON_SAX_Abort;
     }
 
-    /* FIXME: Can overflow here. Cannot be fixed without breaking the API */
+    memcpy(copy, string, length);
+    copy[length] = '\0';
 
-    return (int)size;
+    memset(&value, '\0', sizeof(value));
+    value.type = cJSON_String;
+    value.valuestring = copy;
+
+    return path_scan_report(scan, &value);
 }
 
-static cJSON* get_array_item(const cJSON *array, size_t index)
+static int path_scan_number(void *user_data, double number)
 {
-    cJSON *current_child = NULL;
+    path_scan * const scan = (path_scan*)user_data;
+    cJSON value;
 
-    if (array == NULL)
+    if (scan->leaf == 0)
     {
-        return NULL;
+        return cJSON_SAX_Continue;
     }
 
-    current_child = array->child;
-    while ((current_child != NULL) && (index > 0))
+    memset(&value, '\0', sizeof(value));
+    value.type = cJSON_Number;
+    value.valuedouble = number;
+    /* use saturation in case of overflow, like parse_number */
+    if (number >= INT_MAX)
     {
-        index--;
-        current_child = current_child->next;
+        value.valueint = INT_MAX;
+    }
+    else if (number <= (double)INT_MIN)
+    {
+        value.valueint = INT_MIN;
+    }
+    else
+    {
+        value.valueint = (int)number;
     }
 
-    return current_child;
+    return path_scan_report(scan, &value);
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
+static int path_scan_boolean(void *user_data, cJSON_bool boolean)
 {
-    if (index < 0)
+    path_scan * const scan = (path_scan*)user_data;
+    cJSON value;
+
+    if (scan->leaf == 0)
     {
-        return NULL;
+        return cJSON_SAX_Continue;
     }
 
-    return get_array_item(array, (size_t)index);
+    memset(&value, '\0', sizeof(value));
+    value.type = boolean ? cJSON_True : cJSON_False;
+
+    return path_scan_report(scan, &value);
 }
 
-static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
+static int path_scan_null(void *user_data)
 {
-    cJSON *current_element = NULL;
-
-    if ((object == NULL) || (name == NULL))
-    {
-        return NULL;
-    }
+    path_scan * const scan = (path_scan*)user_data;
+    cJSON value;
 
-    current_element = object->child;
-    if (case_sensitive)
-    {
-        while ((current_element != NULL) && (current_element->string != NULL) && (strcmp(name, current_element->string) != 0))
-        {
-            current_element = current_element->next;
-        }
-    }
-    else
+    if (scan->leaf == 0)
     {
-        while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
-        {
-            current_element = current_element->next;
-        }
+        return cJSON_SAX_Continue;
     }
 
-    if ((current_element == NULL) || (current_element->string == NULL)) {
-        return NULL;
-    }
+    memset(&value, '\0', sizeof(value));
+    value.type = cJSON_NULL;
 
-    return current_element;
+    return path_scan_report(scan, &value);
 }
 
-CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string)
+CJSON_PUBLIC(cJSON_bool) cJSON_ParsePaths(const char *value, size_t buffer_length, const cJSON_Path * const paths, const int count, cJSON_PathCallback callback, void *user_data)
 {
-    return get_object_item(object, string, false);
-}
+    cJSON_SAXHandler handler;
+    path_scan scan;
 
-CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string)
-{
-    return get_object_item(object, string, true);
-}
+    if ((paths == NULL) || (callback == NULL) || (count <= 0) || (count > CJSON_PATH_MAX_QUERIES))
+    {
+        return false;
+    }
 
-CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string)
-{
-    return cJSON_GetObjectItem(object, string) ? 1 : 0;
+    memset(&handler, '\0', sizeof(handler));
+    handler.object_start = path_scan_object_start;
+    handler.object_end = path_scan_object_end;
+    handler.array_start = path_scan_array_start;
+    handler.key = path_scan_key;
+    handler.string = path_scan_string;
+    handler.number = path_scan_number;
+    handler.boolean = path_scan_boolean;
+    handler.null = path_scan_null;
+
+    memset(&scan, '\0', sizeof(scan));
+    scan.paths = paths;
+    scan.callback = callback;
+    scan.user_data = user_data;
+    scan.all = path_mask(paths, count);
+
+    return cJSON_ParseSAX(value, buffer_length, &handler, &scan, NULL);
 }
 
 /* Utility for array list handling. */
@@ -1864,6 +4424,8 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
         return false;
     }
 
+    materialize(array);
+    drop_index(array);
     child = array->child;
 
     if (child == NULL)
@@ -2089,6 +4651,7 @@ CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const it
         return NULL;
     }
 
+    drop_index(parent);
     if (item->prev != NULL)
     {
         /* not the first element */
@@ -2168,6 +4731,7 @@ CJSON_PUBLIC(void) cJSON_InsertItemInArray(cJSON *array, int which, cJSON *newit
         return;
     }
 
+    drop_index(array);
     newitem->next = after_inserted;
     newitem->prev = after_inserted->prev;
     after_inserted->prev = newitem;
@@ -2193,6 +4757,7 @@ CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON
         return true;
     }
 
+    drop_index(parent);
     replacement->next = item->next;
     replacement->prev = item->prev;
 
@@ -2573,6 +5138,7 @@ CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
     {
         goto fail;
     }
+    materialize(item);
     /* Create new item */
     newitem = cJSON_New_Item(&global_hooks);
     if (!newitem)
@@ -2843,6 +5409,8 @@ CJSON_PUBLIC(cJSON_bool) cJSON_Compare(const cJSON * const a, const cJSON * cons
     {
         return false;
     }
+    materialize(a);
+    materialize(b);
 
     /* check if type is valid */
     switch (a->type & 0xFF)
@@ -98,6 +98,7 @@ then using the CJSON_API_VISIBILITY flag to "export" the same symbols the way CJ
 
 #define cJSON_IsReference 256
 #define cJSON_StringIsConst 512
+#define cJSON_IsLazy 1024
 
 /* The cJSON structure: */
 typedef struct cJSON
@@ -120,6 +121,9 @@ typedef struct cJSON
 
     /* The item's name string, if this item is the child of, or is in the list of subitems of an object. */
     char *string;
+
+    /* Hash index over the members of a large object, built and freed by cJSON. */
+    struct cJSON_Index *index;
 } cJSON;
 
 typedef struct cJSON_Hooks
@@ -137,11 +141,180 @@ typedef int cJSON_bool;
 #define CJSON_NESTING_LIMIT 1000
 #endif
 
+/* Number of nested arrays and objects that cJSON_Parse* and cJSON_Print* can handle. They don't recurse
+ * but keep the open arrays and objects on a stack of this many pointers instead, so their stack use
+ * doesn't grow with the depth of the document. Use cJSON_ParseWithStack and cJSON_PrintWithStack to
+ * supply a different stack. */
+#ifndef CJSON_STACK_DEPTH
+#define CJSON_STACK_DEPTH 32
+#endif
+
+/* Size of the stack buffer cJSON_ParseSAX uses to unescape strings that contain escape sequences.
+ * Strings without escape sequences are passed straight from the input and aren't limited. */
+#ifndef CJSON_SAX_SCRATCH_SIZE
+#define CJSON_SAX_SCRATCH_SIZE 128
+#endif
+
+/* Return values of the cJSON_SAXHandler callbacks. */
+typedef enum
+{
+    cJSON_SAX_Continue = 0, /* keep going */
+    cJSON_SAX_Skip = 1,     /* from object_start/array_start: skip the contents, from key: skip the member's value */
+    cJSON_SAX_Abort = 2     /* stop parsing, cJSON_ParseSAX returns false */
+} cJSON_SAXResult;
+
+/* Event callbacks for cJSON_ParseSAX, any of them may be NULL. Keys and strings are passed with their
+ * length and are NOT zero terminated, the pointer is only valid during the callback.
+ * A skipped object or array doesn't get an end event. */
+typedef struct cJSON_SAXHandler
+{
+    int (*object_start)(void *user_data);
+    int (*object_end)(void *user_data);
+    int (*array_start)(void *user_data);
+    int (*array_end)(void *user_data);
+    int (*key)(void *user_data, const char *key, size_t length);
+    int (*string)(void *user_data, const char *string, size_t length);
+    int (*number)(void *user_data, double number);
+    int (*boolean)(void *user_data, cJSON_bool boolean);
+    int (*null)(void *user_data);
+} cJSON_SAXHandler;
+
+/* Size of the buffer cJSON_StreamParser collects partial tokens in. Strings, keys and numbers that are
+ * reported to the handler must fit into it, skipped values aren't limited. */
+#ifndef CJSON_STREAM_TOKEN_SIZE
+#define CJSON_STREAM_TOKEN_SIZE 128
+#endif
+
+/* State of a resumable parser that is fed the input in chunks of any size and reports the same
+ * events as cJSON_ParseSAX as soon as a token is complete. Allocate it anywhere, initialize it with
+ * cJSON_StreamParserInit and don't touch the members. */
+typedef struct cJSON_StreamParser
+{
+    const cJSON_SAXHandler *handler;
+    void *user_data;
+    const char *literal;
+    size_t depth;
+    size_t skip_depth;
+    size_t position; /* number of bytes consumed, points to the offending byte after an error */
+    size_t token_length;
+    int state;
+    unsigned int flags;
+    unsigned char nesting[(CJSON_NESTING_LIMIT + 7) / 8];
+    unsigned char token[CJSON_STREAM_TOKEN_SIZE];
+} cJSON_StreamParser;
+
+/* Recycling pool for items and short strings. Freed blocks go on a free list per size class and are
+ * handed out again, so parsing documents of the same shape stops calling the allocator once the pool
+ * is warm. The blocks are static storage; requests that don't fit or find a class exhausted go to the
+ * allocator. Set all counts to 0 to disable the pool. While it is enabled realloc isn't used. */
+#ifndef CJSON_POOL_NODES
+#define CJSON_POOL_NODES 16
+#endif
+#ifndef CJSON_POOL_SMALL_STRINGS
+#define CJSON_POOL_SMALL_STRINGS 16
+#endif
+#ifndef CJSON_POOL_SMALL_STRING_SIZE
+#define CJSON_POOL_SMALL_STRING_SIZE 16
+#endif
+#ifndef CJSON_POOL_LARGE_STRINGS
+#define CJSON_POOL_LARGE_STRINGS 8
+#endif
+#ifndef CJSON_POOL_LARGE_STRING_SIZE
+#define CJSON_POOL_LARGE_STRING_SIZE 32
+#endif
+/* small strings, large strings, items */
+#define CJSON_POOL_CLASSES 3
+
+/* Usage of one size class of the pool. */
+typedef struct cJSON_PoolStats
+{
+    size_t block_size;
+    size_t block_count;
+    size_t in_use;
+    size_t peak; /* highest in_use so far */
+    unsigned long hits; /* allocations served by this class */
+    unsigned long misses; /* allocations this class would have served but was exhausted */
+} cJSON_PoolStats;
+
+/* Maximum nesting depth of a cJSON_Writer document. */
+#ifndef CJSON_WRITER_NESTING_LIMIT
+#define CJSON_WRITER_NESTING_LIMIT 32
+#endif
+
+/* State of a writer that renders JSON straight into a caller supplied buffer without building a tree.
+ * Initialize it with cJSON_WriterInit and don't touch the members. */
+typedef struct cJSON_Writer
+{
+    char *buffer;
+    size_t length;
+    size_t offset;
+    size_t depth;
+    cJSON_bool failed;
+    unsigned char nesting[(CJSON_WRITER_NESTING_LIMIT + 7) / 8];
+} cJSON_Writer;
+
+/* Objects with at least this many members get a hash index on the first lookup, which makes
+ * cJSON_GetObjectItem and cJSON_GetObjectItemCaseSensitive O(1) on average. The index costs
+ * two to four pointers per member plus a small header. 0 disables the index. */
+#ifndef CJSON_INDEX_THRESHOLD
+#define CJSON_INDEX_THRESHOLD 16
+#endif
+/* Set to 1 to build the index already while parsing instead of on the first lookup. */
+#ifndef CJSON_INDEX_ON_PARSE
+#define CJSON_INDEX_ON_PARSE 0
+#endif
+
+/* Maximum number of keys that can be registered with cJSON_InternKeys. */
+#ifndef CJSON_INTERN_MAX_KEYS
+#define CJSON_INTERN_MAX_KEYS 16
+#endif
+
+/* Maximum number of keys in a compiled path and number of paths resolved together. */
+#ifndef CJSON_PATH_MAX_SEGMENTS
+#define CJSON_PATH_MAX_SEGMENTS 8
+#endif
+#ifndef CJSON_PATH_MAX_QUERIES
+#define CJSON_PATH_MAX_QUERIES 32
+#endif
+
+/* One key of a compiled path. key points into the expression that was compiled and isn't zero terminated. */
+typedef struct cJSON_PathSegment
+{
+    const char *key;
+    size_t length;
+    unsigned long hash; /* case folded, the same for both comparison modes */
+} cJSON_PathSegment;
+
+/* A dotted key path like "state.reported.temperature" that has been split and hashed once by
+ * cJSON_CompilePath so that it can be looked up repeatedly without string scanning. */
+typedef struct cJSON_Path
+{
+    cJSON_PathSegment segments[CJSON_PATH_MAX_SEGMENTS];
+    size_t count;
+    cJSON_bool case_sensitive;
+} cJSON_Path;
+
+/* Called by cJSON_ParsePaths for every scalar value that matches one of the paths. value is a
+ * temporary item that is only valid during the callback. Return a cJSON_SAXResult. */
+typedef int (*cJSON_PathCallback)(void *user_data, int path_index, const cJSON *value);
+
 /* returns the version of cJSON as a string */
 CJSON_PUBLIC(const char*) cJSON_Version(void);
 
 /* Supply malloc, realloc and free functions to cJSON */
 CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks);
+/* Get the usage of every pool class, returns false if the pool is disabled. */
+CJSON_PUBLIC(cJSON_bool) cJSON_GetPoolStats(cJSON_PoolStats stats[CJSON_POOL_CLASSES]);
+/* The pool is shared by all threads. Supply functions that make its updates atomic, e.g. by
+ * suspending the scheduler. They are only called for a few instructions at a time. */
+CJSON_PUBLIC(void) cJSON_SetPoolLock(void (*lock)(void), void (*unlock)(void));
+
+/* Register up to CJSON_INTERN_MAX_KEYS well-known object keys. keys and the strings must stay valid while
+ * trees are parsed or alive. Parsed keys without escape sequences that equal one of them point at the
+ * registered string and are flagged cJSON_StringIsConst instead of being copied, and looking them up with
+ * the same pointer matches by pointer comparison. Replaces the previous table, a count of 0 clears it.
+ * Not thread safe, call it before parsing. */
+CJSON_PUBLIC(cJSON_bool) cJSON_InternKeys(const char * const *keys, const int count);
 
 /* Memory Management: the caller is always responsible to free the results from all variants of cJSON_Parse (with cJSON_Delete) and cJSON_Print (with stdlib free, cJSON_Hooks.free_fn, or cJSON_free as appropriate). The exception is cJSON_PrintPreallocated, where the caller has full responsibility of the buffer. */
 /* Supply a block of JSON, and this returns a cJSON object you can interrogate. */
@@ -149,6 +322,34 @@ CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value);
 /* ParseWithOpts allows you to require (and check) that the JSON is null terminated, and to retrieve the pointer to the final byte parsed. */
 /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error so will match cJSON_GetErrorPtr(). */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated);
+/* cJSON_ParseWithOpts with a caller supplied stack of stack_size entries, which is the maximum nesting depth. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithStack(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated, cJSON **stack, const size_t stack_size);
+/* Event driven parsing of buffer_length bytes of JSON (no zero termination required), no tree is built.
+ * Memory use is O(depth) on the stack and nothing is allocated. Skipped values are only checked for
+ * matching brackets. Returns false on a parse error or if a callback aborted; the error position is
+ * available via return_parse_end and cJSON_GetErrorPtr() like for cJSON_ParseWithOpts. */
+CJSON_PUBLIC(cJSON_bool) cJSON_ParseSAX(const char *value, size_t buffer_length, const cJSON_SAXHandler * const handler, void *user_data, const char **return_parse_end);
+/* Check that buffer_length bytes of JSON are well-formed and nest at most max_depth levels deep (0 means
+ * CJSON_NESTING_LIMIT) without building anything: one pass, constant stack use and no allocation. Numbers
+ * have to follow the JSON grammar strictly. Returns false and sets error_offset (optional) to the offset
+ * of the first invalid byte, or to buffer_length if the document ends early. */
+CJSON_PUBLIC(cJSON_bool) cJSON_Validate(const char *value, size_t buffer_length, size_t max_depth, size_t *error_offset);
+/* Lazy parsing of buffer_length bytes of JSON: only the top level is parsed. Arrays and objects below it
+ * are skipped bracket by bracket and become items flagged cJSON_IsLazy that point into value. They are
+ * parsed one level at a time when they are accessed through cJSON_GetObjectItem*, cJSON_GetArrayItem,
+ * cJSON_GetArraySize, cJSON_Materialize or when items are added, so branches that are never read cost
+ * only the skip. value must stay valid and unchanged until the tree is deleted. Printing copies the
+ * text of lazy items as it is. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseLazy(const char *value, size_t buffer_length, const char **return_parse_end);
+/* Parse the next level of a lazy item, walk its child list only after this. Returns false if its text
+ * turns out to be invalid, the item is left as an empty array or object then. */
+CJSON_PUBLIC(cJSON_bool) cJSON_Materialize(cJSON * const item);
+/* Incremental parsing: feed the document in as many chunks as needed, partial tokens are carried over
+ * between calls. Feed returns false as soon as the input is invalid or a callback aborted, Finish
+ * returns true if exactly one complete value has been fed. Nothing is allocated. */
+CJSON_PUBLIC(void) cJSON_StreamParserInit(cJSON_StreamParser * const parser, const cJSON_SAXHandler * const handler, void *user_data);
+CJSON_PUBLIC(cJSON_bool) cJSON_StreamParserFeed(cJSON_StreamParser * const parser, const char *chunk, size_t length);
+CJSON_PUBLIC(cJSON_bool) cJSON_StreamParserFinish(cJSON_StreamParser * const parser);
 
 /* Render a cJSON entity to text for transfer/storage. */
 CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item);
@@ -159,6 +360,33 @@ CJSON_PUBLIC(char *) cJSON_PrintBuffered(const cJSON *item, int prebuffer, cJSON
 /* Render a cJSON entity to text using a buffer already allocated in memory with given length. Returns 1 on success and 0 on failure. */
 /* NOTE: cJSON is not always 100% accurate in estimating how much memory it will use, so to be safe allocate 5 bytes more than you actually need */
 CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buffer, const int length, const cJSON_bool format);
+/* cJSON_PrintPreallocated with a caller supplied stack of stack_size entries, which is the maximum nesting depth. */
+CJSON_PUBLIC(cJSON_bool) cJSON_PrintWithStack(const cJSON *item, char *buffer, const int length, const cJSON_bool format, const cJSON **stack, const size_t stack_size);
+/* Write JSON directly into buffer, one call per bracket, key or value. Nothing is allocated and strings are
+ * escaped like cJSON_Print does. Every call returns false once the buffer is full or a call doesn't fit
+ * the structure written so far (e.g. a value without a key inside an object); all later calls fail too,
+ * so the result only needs to be checked at the end. The buffer is always zero terminated. */
+CJSON_PUBLIC(void) cJSON_WriterInit(cJSON_Writer * const writer, char *buffer, const size_t length);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteObjectStart(cJSON_Writer * const writer);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteObjectEnd(cJSON_Writer * const writer);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteArrayStart(cJSON_Writer * const writer);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteArrayEnd(cJSON_Writer * const writer);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteKey(cJSON_Writer * const writer, const char *key);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteString(cJSON_Writer * const writer, const char *string);
+/* Uses the same formatting as cJSON_Print, which goes through sprintf. */
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteNumber(cJSON_Writer * const writer, const double number);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteInteger(cJSON_Writer * const writer, const long number);
+/* Write number rounded to 0 to 9 decimals without going through sprintf. */
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteFixed(cJSON_Writer * const writer, const double number, const int decimals);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteBool(cJSON_Writer * const writer, const cJSON_bool boolean);
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteNull(cJSON_Writer * const writer);
+/* Write a value that is already valid JSON as it is. */
+CJSON_PUBLIC(cJSON_bool) cJSON_WriteRaw(cJSON_Writer * const writer, const char *json);
+/* Returns the length of the document, or 0 if a call failed or an object or array is still open. */
+CJSON_PUBLIC(size_t) cJSON_WriterFinish(const cJSON_Writer * const writer);
+/* Returns the number of bytes written so far, also while objects or arrays are open, or 0 if a call failed. */
+CJSON_PUBLIC(size_t) cJSON_WriterLength(const cJSON_Writer * const writer);
+
 /* Delete a cJSON entity and all subentities. */
 CJSON_PUBLIC(void) cJSON_Delete(cJSON *item);
 
@@ -170,6 +398,22 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string);
+/* Object indexes are dropped automatically by the cJSON functions that change an object. Call this
+ * after changing the members or their names directly. Lookups aren't thread safe while an index can
+ * still be built, because a lookup may build it. */
+CJSON_PUBLIC(void) cJSON_InvalidateIndex(cJSON * const object);
+/* Returns the number of bytes used by the hash indexes of item and everything below it. */
+CJSON_PUBLIC(size_t) cJSON_GetIndexMemory(const cJSON * const item);
+/* Compile a path of '.' separated keys. The expression must stay valid as long as the path is used.
+ * Case sensitive paths compare the keys with memcmp after the hash matched, which is faster. */
+CJSON_PUBLIC(cJSON_bool) cJSON_CompilePath(cJSON_Path * const path, const char *expression, const cJSON_bool case_sensitive);
+/* Resolve up to CJSON_PATH_MAX_QUERIES compiled paths in one walk of the tree. results[i] gets the item
+ * for paths[i] or NULL, with the same first match semantics as cJSON_GetObjectItem. Returns the number of paths found. */
+CJSON_PUBLIC(int) cJSON_ResolvePaths(const cJSON * const root, const cJSON_Path * const paths, const int count, cJSON **results);
+/* Resolve compiled paths directly from text with cJSON_ParseSAX, without building a tree. Everything that
+ * isn't on one of the paths is skipped. Only scalar values are reported and strings must be shorter than
+ * CJSON_SAX_SCRATCH_SIZE. Returns false on a parse error or if the callback aborted. */
+CJSON_PUBLIC(cJSON_bool) cJSON_ParsePaths(const char *value, size_t buffer_length, const cJSON_Path * const paths, const int count, cJSON_PathCallback callback, void *user_data);
 /* For analysing failed parses. This returns a pointer to the parse error. You'll probably need to look a few chars back to make sense of it. Defined when cJSON_Parse() returns 0. 0 when cJSON_Parse() succeeds. */
 CJSON_PUBLIC(const char *) cJSON_GetErrorPtr(void);
 
@@ -29,16 +29,66 @@
  */
 #define MAX_THING                               39
 
-/* Structure to hold data from an IoT device */
+/*
+ * Set to 1 (DEFINES=STATIC_ALLOCATION=1 in the Makefile, -DSTATIC_ALLOCATION=ON
+ * with CMake) to create the threads, queues, semaphores, timers and buffers of
+ * the application from static memory. The build then fails if they don't fit
+ * in STATIC_RAM_BUDGET_BYTES.
+ */
+#ifndef STATIC_ALLOCATION
+#define STATIC_ALLOCATION                       0
+#endif
+#define STATIC_RAM_BUDGET_BYTES                 (224 * 1024)
+
+/* Number of things, and of words in a bitset with one bit per thing */
+#define THING_COUNT                             (MAX_THING + 1)
+#define THING_BITSET_WORDS                      ((THING_COUNT + 31) / 32)
+
+/* Word and bit of a thing in a bitset */
+#define THING_WORD(thingNumber)                 ((thingNumber) / 32)
+#define THING_BIT(thingNumber)                  (1UL << ((thingNumber) % 32))
+
+/* Weather data channels, in the order of arrays indexed by channel */
+#define IOT_TEMPERATURE                         (0)
+#define IOT_HUMIDITY                            (1)
+#define IOT_LIGHT                               (2)
+#define IOT_CHANNELS                            (3)
+
+/* Fixed-point scale of the weather data: temperature and humidity are kept
+ * in tenths, light in whole lux */
+#define IOT_TEMPERATURE_SCALE                   (10)
+#define IOT_HUMIDITY_SCALE                      (10)
+#define IOT_LIGHT_SCALE                         (1)
+
+/* Size of a buffer for an IPv4 address in dotted decimal */
+#define IP_STR_LEN                              (16)
+
+/* Data from all IoT devices, one array per field so that scans over the
+ * fleet only touch the field they look at */
+typedef struct {
+    int16_t temp[THING_COUNT];                  /* In 1/IOT_TEMPERATURE_SCALE °C */
+    int16_t humidity[THING_COUNT];              /* In 1/IOT_HUMIDITY_SCALE % */
+    int16_t light[THING_COUNT];                 /* In 1/IOT_LIGHT_SCALE lx */
+    uint32_t ip[THING_COUNT];                   /* IPv4 address, first octet in the top byte */
+    uint32_t alert[THING_BITSET_WORDS];         /* Bit set while the weather alert is on */
+} iot_fleet_t;
+
+/* Copy of the data from one IoT device */
 typedef struct {
     uint8_t thingNumber;
-    char ip_str[16];
     bool alert;
-    float temp;
-    float humidity;
-    float light;
+    int16_t temp;
+    int16_t humidity;
+    int16_t light;
+    uint32_t ip;
 } iot_data_t;
 
+/* One line of the RAM budget of the application */
+typedef struct {
+    const char *name;
+    uint32_t bytes;
+} ram_budget_t;
+
 /* Publish commands */
 typedef enum command {
     WEATHER_CMD,
@@ -48,22 +98,47 @@ typedef enum command {
     ALERT_CMD,
     IP_CMD,
     GET_CMD,
+    FLEET_CMD,
+    SNAPSHOT_CMD,
 } CMD;
 
 /***************************************
 *          External variables
 ****************************************/
-extern SemaphoreHandle_t display_semaphore;
-extern SemaphoreHandle_t i2c_mutex;
 extern QueueHandle_t pub_queue;
-extern iot_data_t iot_data[];
+extern iot_fleet_t iot_fleet;
 extern IotMqttConnection_t mqtt_connection;
 extern volatile bool print_all;
 extern volatile uint8_t disp_thing;
+extern volatile bool disp_fleet;
+extern const ram_budget_t ram_budget[];
+extern const uint8_t ram_budget_lines;
+extern size_t heap_used_after_init;
 
 /***************************************
 *          Function definition
 ****************************************/
 void print_thing_info(uint8_t thingNumber);
 
+/* Sequence lock of the thing records, writers bracket their updates with the
+ * begin/end calls and readers take a snapshot */
+void iot_data_write_begin(uint8_t thingNumber);
+void iot_data_write_end(uint8_t thingNumber);
+UBaseType_t iot_data_write_begin_from_isr(uint8_t thingNumber);
+void iot_data_write_end_from_isr(uint8_t thingNumber, UBaseType_t savedInterruptStatus);
+void iot_data_snapshot(uint8_t thingNumber, iot_data_t *snapshot);
+void iot_data_store(uint8_t thingNumber, const iot_data_t *thing);
+
+/* Conversion of the weather data and IP address */
+int16_t iot_data_to_fixed(float value, int32_t scale);
+void iot_data_format_ip(uint32_t ip, char *ip_str);
+bool iot_data_parse_ip(const char *ip_str, uint32_t *ip);
+
+/* Bytes allocated from the heap */
+size_t heap_used(void);
+
+/* Scans over all things */
+uint8_t iot_fleet_alert_count(void);
+uint8_t iot_fleet_hottest(void);
+
 #endif /* SOURCE_COMMON_RESOURCE_H_ */
@@ -11,7 +11,16 @@
 #include "cybsp.h"
 #include "FreeRTOS.h"
 #include "cy_retarget_io.h"
+#include "cJSON.h"
 #include "console_operation.h"
+#include "history_operation.h"
+#include "fleet_operation.h"
+#include "notify_operation.h"
+#include "kv_operation.h"
+#include "heap_operation.h"
+#include "snapshot_operation.h"
+#include "i2c_operation.h"
+#include "filter_operation.h"
 
 /***************************************
 *            Defines
@@ -25,10 +34,19 @@
 /* Delay between printing info of all things */
 #define DELAY_BETWEEN_PRINT_MS                  (20)
 
+/* Number of buckets of each history tier to print */
+#define HISTORY_PRINT_BUCKETS                   (5)
+
+/* Number of highest and lowest things of each channel to print */
+#define TOP_PRINT_THINGS                        (5)
+
 /***************************************
 *          Global Variables
 ****************************************/
 static SemaphoreHandle_t command_semaphore;
+#if STATIC_ALLOCATION
+static StaticSemaphore_t command_semaphore_buffer;
+#endif
 
 /* Buffer to store command received from UART terminal */
 static volatile uint8_t receive_command;
@@ -41,6 +59,17 @@ volatile bool print_all = false;
 ****************************************/
 void command_thread_callback(void *callback_arg, cyhal_uart_event_t event);
 void print_banner(void);
+void print_cjson_pool(void);
+void print_history(uint8_t thingNumber);
+void print_fleet_summary(void);
+void print_alerting_things(void);
+void print_top_things(void);
+void print_kv_stats(void);
+void print_ram_budget(void);
+void print_heap_stats(void);
+void print_snapshot(void);
+void print_i2c_stats(void);
+void print_filters(void);
 /*************** UART Command Interface Thread ***************/
 /*
  * Summary: Thread to handle UART command input/output
@@ -56,9 +85,14 @@ void commandThread(void* arg)
 
     /* Command pushed onto the queue to determine what to publish */
     char pubCmd[PUBLISH_CMD_SIZE_BYTES];
+    iot_data_t thing;
 
     /* Setup Thread Control entities */
+#if STATIC_ALLOCATION
+    command_semaphore = xSemaphoreCreateBinaryStatic(&command_semaphore_buffer);
+#else
     command_semaphore = xSemaphoreCreateBinary();
+#endif
 
     /* Register callback to trigger when RX FIFO is not empty */
     cyhal_uart_register_callback(&cy_retarget_io_uart_obj, command_thread_callback, NULL);
@@ -87,38 +121,58 @@ void commandThread(void* arg)
             configPRINTF(("\tP - Turn printing of messages from all things ON\r\n"));
             configPRINTF(("\tp - Turn printing of messages from all things OFF\r\n"));
             configPRINTF(("\tx - Print the current known state of the data from all things\r\n"));
+            configPRINTF(("\tX - Print the snapshot document of all things\r\n"));
+            configPRINTF(("\tf - Print the summary of all things and publish\r\n"));
+            configPRINTF(("\tF - Toggle the summary of all things on the display\r\n"));
+            configPRINTF(("\tw - Print the things with the weather alert on\r\n"));
+            configPRINTF(("\tT - Print the things with the highest and lowest values\r\n"));
+            configPRINTF(("\tH - Print the history of the thing on the display\r\n"));
+            configPRINTF(("\tS - Save the state to flash\r\n"));
+            configPRINTF(("\tk - Print the usage of the key-value store in flash\r\n"));
+            configPRINTF(("\tj - Print the usage of the cJSON memory pool\r\n"));
+            configPRINTF(("\tm - Print the RAM budget and the heap used since start-up\r\n"));
+            configPRINTF(("\tM - Print the usage of each size class of the heap\r\n"));
+            configPRINTF(("\ti - Print the wait and hold times of the clients of the I2C bus\r\n"));
+            configPRINTF(("\tg - Print the filters of the weather data and how many changes they held back\r\n"));
             configPRINTF(("\tc - Clear the terminal and set the cursor to the upper left corner\r\n"));
             configPRINTF(("\t? - Print the list of commands\r\n"));
             break;
         case 't': /* Print temperature to terminal and publish */
-            configPRINTF(("Temperature: %.1f\r\n", iot_data[MY_THING].temp));
+            iot_data_snapshot(MY_THING, &thing);
+            configPRINTF(("Temperature: %.1f\r\n", (float)thing.temp / IOT_TEMPERATURE_SCALE));
             /* Publish temperature to the cloud */
             pubCmd[0] = TEMPERATURE_CMD;
             xQueueSend(pub_queue, pubCmd, portMAX_DELAY); /* Push value onto queue*/
             break;
         case 'h': /* Print humidity to terminal and publish */
-            configPRINTF(("Humidity: %.1f\t\r\n", iot_data[MY_THING].humidity));
+            iot_data_snapshot(MY_THING, &thing);
+            configPRINTF(("Humidity: %.1f\t\r\n", (float)thing.humidity / IOT_HUMIDITY_SCALE));
             /* Publish humidity to the cloud */
             pubCmd[0] = HUMIDITY_CMD;
             xQueueSend(pub_queue, pubCmd, portMAX_DELAY); /* Push value onto queue*/
             break;
         case 'l': /* Print light value to terminal and publish */
-            configPRINTF(("Light: %.1f\t\r\n", iot_data[MY_THING].light));
+            iot_data_snapshot(MY_THING, &thing);
+            configPRINTF(("Light: %.1f\t\r\n", (float)thing.light / IOT_LIGHT_SCALE));
             /* Publish light value to the cloud */
             pubCmd[0] = LIGHT_CMD;
             xQueueSend(pub_queue, pubCmd, portMAX_DELAY); /* Push value onto queue*/
             break;
         case 'A': /* Publish Weather Alert ON */
             configPRINTF(("Weather Alert ON\r\n"));
-            iot_data[MY_THING].alert = true;
-            xSemaphoreGive(display_semaphore); /* Update display */
+            iot_data_write_begin(MY_THING);
+            iot_fleet.alert[THING_WORD(MY_THING)] |= THING_BIT(MY_THING);
+            iot_data_write_end(MY_THING);
+            notify_publish(MY_THING, NOTIFY_ALERT); /* Update display */
             pubCmd[0] = ALERT_CMD;
             xQueueSend(pub_queue, pubCmd, portMAX_DELAY); /* Push value onto queue*/
             break;
         case 'a': /* Publish Weather Alert OFF */
             configPRINTF(("Weather Alert OFF\r\n"));
-            iot_data[MY_THING].alert = false;
-            xSemaphoreGive(display_semaphore); /* Update display */
+            iot_data_write_begin(MY_THING);
+            iot_fleet.alert[THING_WORD(MY_THING)] &= ~THING_BIT(MY_THING);
+            iot_data_write_end(MY_THING);
+            notify_publish(MY_THING, NOTIFY_ALERT); /* Update display */
             pubCmd[0] = ALERT_CMD;
             xQueueSend(pub_queue, pubCmd, portMAX_DELAY); /* Push value onto queue*/
             break;
@@ -135,10 +189,55 @@ void commandThread(void* arg)
             {
                 print_thing_info(loop);
             }
+            configPRINTF(("\tAlerts: %u\tHottest: Thing_%02u\r\n",
+                           (unsigned int)iot_fleet_alert_count(),
+                           (unsigned int)iot_fleet_hottest()));
+            break;
+        case 'X': /* Print snapshot document of all things */
+            print_snapshot();
+            break;
+        case 'f': /* Print fleet summary to terminal and publish */
+            print_fleet_summary();
+            pubCmd[0] = FLEET_CMD;
+            xQueueSend(pub_queue, pubCmd, portMAX_DELAY); /* Push value onto queue*/
+            break;
+        case 'F': /* Toggle fleet summary on the display */
+            disp_fleet = !disp_fleet;
+            notify_publish(NOTIFY_NO_THING, NOTIFY_VIEW); /* Update display */
+            break;
+        case 'w': /* Print alerting things */
+            print_alerting_things();
+            break;
+        case 'T': /* Print highest and lowest things */
+            print_top_things();
             break;
         case 'c':
             print_banner();
             break;
+        case 'H': /* Print history of the displayed thing */
+            print_history(disp_thing);
+            break;
+        case 'S': /* Save state to flash */
+            configPRINTF(("%s\r\n", kv_save_state() ? "State saved" : "Failed to save the state"));
+            break;
+        case 'k': /* Print key-value store usage */
+            print_kv_stats();
+            break;
+        case 'j': /* Print cJSON pool usage */
+            print_cjson_pool();
+            break;
+        case 'm': /* Print RAM budget */
+            print_ram_budget();
+            break;
+        case 'M': /* Print heap usage */
+            print_heap_stats();
+            break;
+        case 'i': /* Print I2C bus usage */
+            print_i2c_stats();
+            break;
+        case 'g': /* Print filters of the weather data */
+            print_filters();
+            break;
         }
     }
 }
@@ -172,18 +271,309 @@ void command_thread_callback(void *callback_arg, cyhal_uart_event_t event)
  */
 void print_thing_info(uint8_t thingNumber)
 {
-    configPRINTF(("\tThing: Thing_%02d\tIP: %15s\tAlert: %d\tTemperature: %4.1f\tHumidity: %4.1f\tLight: %5.0f\r\n",
+    char ip_str[IP_STR_LEN];
+    iot_data_t thing;
+
+    iot_data_snapshot(thingNumber, &thing);
+    iot_data_format_ip(thing.ip, ip_str);
+    configPRINTF(("\tThing: Thing_%02d\tIP: %15s\tAlert: %d\tTemperature: %4.1f\tHumidity: %4.1f\tLight: %5d\r\n",
                    thingNumber,
-                   iot_data[thingNumber].ip_str,
-                   iot_data[thingNumber].alert,
-                   iot_data[thingNumber].temp,
-                   iot_data[thingNumber].humidity,
-                   iot_data[thingNumber].light));
+                   ip_str,
+                   thing.alert,
+                   (float)thing.temp / IOT_TEMPERATURE_SCALE,
+                   (float)thing.humidity / IOT_HUMIDITY_SCALE,
+                   thing.light / IOT_LIGHT_SCALE));
 
     /* Delay to avoid the overflow of the print queue */
     vTaskDelay(pdMS_TO_TICKS(DELAY_BETWEEN_PRINT_MS));
 }
 
+/*************** Print cJSON Pool ***************/
+/*
+ * Summary: Print the usage of each size class of the cJSON pool. Allocations
+ * that miss the pool go to the heap.
+ */
+void print_cjson_pool(void)
+{
+    cJSON_PoolStats stats[CJSON_POOL_CLASSES];
+    uint8_t loop;
+    unsigned long requests;
+
+    if(!cJSON_GetPoolStats(stats))
+    {
+        configPRINTF(("cJSON pool disabled\r\n"));
+        return;
+    }
+
+    for(loop = 0; loop < CJSON_POOL_CLASSES; loop++)
+    {
+        requests = stats[loop].hits + stats[loop].misses;
+        configPRINTF(("\tBlock size: %3u\tIn use: %3u/%-3u\tPeak: %3u\tHits: %lu\tMisses: %lu\tHit rate: %lu%%\r\n",
+                       (unsigned int)stats[loop].block_size,
+                       (unsigned int)stats[loop].in_use,
+                       (unsigned int)stats[loop].block_count,
+                       (unsigned int)stats[loop].peak,
+                       stats[loop].hits,
+                       stats[loop].misses,
+                       (requests > 0) ? ((stats[loop].hits * 100) / requests) : 100));
+    }
+}
+
+/*************** Print Key-Value Store ***************/
+/*
+ * Summary: Print the usage and the wear of the key-value store in flash.
+ */
+void print_kv_stats(void)
+{
+    kv_stats_t stats;
+
+    kv_get_stats(&stats);
+    configPRINTF(("\tRows: %u/%u\tKeys: %u\tPending: %u bytes\tErases per row: %lu to %lu\r\n",
+                   (unsigned int)stats.rows_used,
+                   (unsigned int)stats.rows,
+                   (unsigned int)stats.keys,
+                   (unsigned int)stats.pending,
+                   (unsigned long)stats.min_erases,
+                   (unsigned long)stats.max_erases));
+}
+
+/*************** Print RAM Budget ***************/
+/*
+ * Summary: Print the RAM budget of the application and how much the heap has
+ * grown since all threads were started.
+ */
+void print_ram_budget(void)
+{
+    size_t used = heap_used();
+    uint8_t loop;
+
+    for(loop = 0; loop < ram_budget_lines; loop++)
+    {
+        configPRINTF(("\t%-20s %6lu bytes\r\n", ram_budget[loop].name, (unsigned long)ram_budget[loop].bytes));
+    }
+    configPRINTF(("\tAllocation: %s\r\n", STATIC_ALLOCATION ? "static" : "heap"));
+    configPRINTF(("\tHeap used: %lu bytes\tSince start-up: %ld bytes\r\n",
+                   (unsigned long)used,
+                   (long)used - (long)heap_used_after_init));
+}
+
+/*************** Print Heap ***************/
+/*
+ * Summary: Print the usage of the heap of the application, overall and for
+ * each size class that has been used.
+ */
+void print_heap_stats(void)
+{
+    heap_stats_t stats;
+    uint8_t loop;
+
+    if(!heap_get_stats(&stats))
+    {
+        configPRINTF(("Heap of the application disabled\r\n"));
+        return;
+    }
+
+    configPRINTF(("\tPool: %lu\tUsed: %lu\tPeak: %lu\tFree: %lu in %u blocks\tLargest free: %lu\r\n",
+                   (unsigned long)stats.pool_bytes,
+                   (unsigned long)stats.used_bytes,
+                   (unsigned long)stats.peak_used_bytes,
+                   (unsigned long)stats.free_bytes,
+                   (unsigned int)stats.free_blocks,
+                   (unsigned long)stats.largest_free));
+    configPRINTF(("\tAllocations: %lu\tFrees: %lu\tFailures: %lu\tFragmentation: %lu%%\r\n",
+                   (unsigned long)stats.allocations,
+                   (unsigned long)stats.frees,
+                   (unsigned long)stats.failures,
+                   (stats.free_bytes > 0) ?
+                   (unsigned long)(100 - (((uint64_t)stats.largest_free * 100) / stats.free_bytes)) : 0UL));
+    for(loop = 0; loop < HEAP_CLASSES; loop++)
+    {
+        if(stats.classes[loop].allocations == 0)
+        {
+            continue;
+        }
+        configPRINTF(("\tBlocks below %6lu\tIn use: %3u\tPeak: %3u\tAllocations: %lu\r\n",
+                       (unsigned long)stats.classes[loop].block_limit,
+                       (unsigned int)stats.classes[loop].in_use,
+                       (unsigned int)stats.classes[loop].peak,
+                       (unsigned long)stats.classes[loop].allocations));
+    }
+}
+
+/*************** Print Snapshot Chunk ***************/
+/*
+ * Summary: Snapshot sink that prints a chunk as one log message.
+ *
+ *  @param[in] chunk The chunk.
+ *  @param[in] length Length of the chunk.
+ *  @param[in] context Not used.
+ */
+static void print_snapshot_chunk(const char *chunk, uint16_t length, void *context)
+{
+    ( void )context; /* Suppress compiler warning */
+
+    configPRINTF(("%.*s\r\n", (int)length, chunk));
+}
+
+/*************** Print Snapshot ***************/
+/*
+ * Summary: Print the snapshot document of all things, in chunks that fit in
+ * a log message.
+ */
+void print_snapshot(void)
+{
+    static char chunk[SNAPSHOT_CONSOLE_BUFFER_BYTES];
+
+    if(snapshot_write(chunk, sizeof(chunk), print_snapshot_chunk, NULL) == 0)
+    {
+        configPRINTF(("Failed to write the snapshot\r\n"));
+    }
+}
+
+/*************** Print Fleet Summary ***************/
+/*
+ * Summary: Print the aggregates over all things that have reported.
+ */
+void print_fleet_summary(void)
+{
+    fleet_summary_t fleet;
+
+    fleet_get_summary(&fleet);
+    configPRINTF(("\tThings: %u\tAlerts: %u\r\n", (unsigned int)fleet.reporting, (unsigned int)fleet.alerts));
+    if(fleet.reporting == 0)
+    {
+        return;
+    }
+    configPRINTF(("\tTemperature: min %4.1f (Thing_%02u)\tmean %4.1f\tmax %4.1f (Thing_%02u)\r\n",
+                   (float)fleet.min[IOT_TEMPERATURE] / IOT_TEMPERATURE_SCALE,
+                   (unsigned int)fleet.min_thing[IOT_TEMPERATURE],
+                   (float)fleet.mean[IOT_TEMPERATURE] / IOT_TEMPERATURE_SCALE,
+                   (float)fleet.max[IOT_TEMPERATURE] / IOT_TEMPERATURE_SCALE,
+                   (unsigned int)fleet.max_thing[IOT_TEMPERATURE]));
+    configPRINTF(("\tHumidity:    min %4.1f (Thing_%02u)\tmean %4.1f\tmax %4.1f (Thing_%02u)\r\n",
+                   (float)fleet.min[IOT_HUMIDITY] / IOT_HUMIDITY_SCALE,
+                   (unsigned int)fleet.min_thing[IOT_HUMIDITY],
+                   (float)fleet.mean[IOT_HUMIDITY] / IOT_HUMIDITY_SCALE,
+                   (float)fleet.max[IOT_HUMIDITY] / IOT_HUMIDITY_SCALE,
+                   (unsigned int)fleet.max_thing[IOT_HUMIDITY]));
+    configPRINTF(("\tLight:       min %5d (Thing_%02u)\tmean %5d\tmax %5d (Thing_%02u)\r\n",
+                   fleet.min[IOT_LIGHT] / IOT_LIGHT_SCALE,
+                   (unsigned int)fleet.min_thing[IOT_LIGHT],
+                   fleet.mean[IOT_LIGHT] / IOT_LIGHT_SCALE,
+                   fleet.max[IOT_LIGHT] / IOT_LIGHT_SCALE,
+                   (unsigned int)fleet.max_thing[IOT_LIGHT]));
+}
+
+/*************** Print Alerting Things ***************/
+/*
+ * Summary: Print the things with the weather alert on, from the alert bitset.
+ */
+void print_alerting_things(void)
+{
+    uint8_t thing;
+    uint8_t count = 0;
+
+    for(thing = fleet_next_alert(0); thing != FLEET_NO_THING; thing = fleet_next_alert(thing + 1))
+    {
+        configPRINTF(("\tThing_%02u\r\n", (unsigned int)thing));
+        count++;
+    }
+    configPRINTF(("\tAlerts: %u\r\n", (unsigned int)count));
+}
+
+/*************** Print Top Things ***************/
+/*
+ * Summary: Print the things with the highest and the lowest values of each
+ * channel, from the heaps of the fleet.
+ */
+void print_top_things(void)
+{
+    static const char * const channel_names[IOT_CHANNELS] = { "Temperature", "Humidity", "Light" };
+    static const float channel_scales[IOT_CHANNELS] =
+    {
+        IOT_TEMPERATURE_SCALE,
+        IOT_HUMIDITY_SCALE,
+        IOT_LIGHT_SCALE
+    };
+    uint8_t things[TOP_PRINT_THINGS];
+    int16_t values[TOP_PRINT_THINGS];
+    uint8_t channel;
+    uint8_t highest;
+    uint8_t count;
+    uint8_t loop;
+
+    for(channel = 0; channel < IOT_CHANNELS; channel++)
+    {
+        for(highest = 0; highest < 2; highest++)
+        {
+            count = fleet_get_top(channel, highest != 0, things, values, TOP_PRINT_THINGS);
+            configPRINTF(("\t%s %s:\r\n", channel_names[channel], (highest != 0) ? "highest" : "lowest"));
+            for(loop = 0; loop < count; loop++)
+            {
+                configPRINTF(("\t\tThing_%02u\t%6.1f\r\n",
+                               (unsigned int)things[loop],
+                               (float)values[loop] / channel_scales[channel]));
+            }
+        }
+    }
+}
+
+/*************** Print History ***************/
+/*
+ * Summary: Print the newest raw sample and the newest buckets of each history
+ * tier of the given thing.
+ *
+ *  @param[in] thingNumber The number of the Thing
+ *  whose history is to be printed.
+ */
+void print_history(uint8_t thingNumber)
+{
+    history_sample_t sample;
+    history_bucket_t bucket;
+    uint8_t tier;
+    uint16_t age;
+
+    configPRINTF(("History of Thing_%02d\r\n", thingNumber));
+    if(history_get_raw(thingNumber, 0, &sample))
+    {
+        configPRINTF(("\tRaw samples: %u\tNewest: %4.1f %4.1f %5d\r\n",
+                       (unsigned int)history_raw_count(thingNumber),
+                       (float)sample.value[HISTORY_TEMPERATURE] / HISTORY_TEMPERATURE_SCALE,
+                       (float)sample.value[HISTORY_HUMIDITY] / HISTORY_HUMIDITY_SCALE,
+                       sample.value[HISTORY_LIGHT] / HISTORY_LIGHT_SCALE));
+    }
+
+    for(tier = 0; tier < history_tier_count(thingNumber); tier++)
+    {
+        configPRINTF(("\t%lu min buckets: %u\r\n",
+                       (unsigned long)(history_tier_period_ms(thingNumber, tier) / HISTORY_MINUTE_MS),
+                       (unsigned int)history_bucket_count(thingNumber, tier)));
+        for(age = 0; (age < HISTORY_PRINT_BUCKETS) && history_get_bucket(thingNumber, tier, age, &bucket); age++)
+        {
+            if(bucket.min[HISTORY_TEMPERATURE] > bucket.max[HISTORY_TEMPERATURE])
+            {
+                configPRINTF(("\t\t-%u\tNo data\r\n", (unsigned int)age));
+            }
+            else
+            {
+                configPRINTF(("\t\t-%u\tTemperature: %4.1f/%4.1f/%4.1f\tHumidity: %4.1f/%4.1f/%4.1f\tLight: %5d/%5d/%5d\r\n",
+                               (unsigned int)age,
+                               (float)bucket.min[HISTORY_TEMPERATURE] / HISTORY_TEMPERATURE_SCALE,
+                               (float)bucket.mean[HISTORY_TEMPERATURE] / HISTORY_TEMPERATURE_SCALE,
+                               (float)bucket.max[HISTORY_TEMPERATURE] / HISTORY_TEMPERATURE_SCALE,
+                               (float)bucket.min[HISTORY_HUMIDITY] / HISTORY_HUMIDITY_SCALE,
+                               (float)bucket.mean[HISTORY_HUMIDITY] / HISTORY_HUMIDITY_SCALE,
+                               (float)bucket.max[HISTORY_HUMIDITY] / HISTORY_HUMIDITY_SCALE,
+                               bucket.min[HISTORY_LIGHT] / HISTORY_LIGHT_SCALE,
+                               bucket.mean[HISTORY_LIGHT] / HISTORY_LIGHT_SCALE,
+                               bucket.max[HISTORY_LIGHT] / HISTORY_LIGHT_SCALE));
+            }
+            /* Delay to avoid the overflow of the print queue */
+            vTaskDelay(pdMS_TO_TICKS(DELAY_BETWEEN_PRINT_MS));
+        }
+    }
+}
+
 /*************** Print Banner ***************/
 /*
  * Summary: Prints a banner for the command thread.
@@ -196,3 +586,73 @@ void print_banner(void)
     configPRINTF(("Enter '?' for a list of available commands\r\n"));
     configPRINTF(("******************************************\r\n"));
 }
+
+/*************** Print I2C Statistics ***************/
+/*
+ * Summary: Print how long each client of the I2C bus of the shield waits for
+ * and holds the bus, and how long the transfers take.
+ */
+void print_i2c_stats(void)
+{
+    static const char * const client_names[I2C_CLIENTS] = { "AFE", "Display" };
+    i2c_stats_t stats;
+    i2c_client_stats_t *client;
+    uint8_t loop;
+
+    i2c_get_stats(&stats);
+    configPRINTF(("\tTransfers: %lu %s\tMean: %lu us\tFailures: %lu\tTimeouts: %lu\r\n",
+                   (unsigned long)stats.transfers,
+                   I2C_ASYNC ? "interrupt driven" : "blocking",
+                   (stats.transfers > 0) ? (unsigned long)(stats.transfer_total_us / stats.transfers) : 0UL,
+                   (unsigned long)stats.failures,
+                   (unsigned long)stats.timeouts));
+    for(loop = 0; loop < I2C_CLIENTS; loop++)
+    {
+        client = &stats.clients[loop];
+        configPRINTF(("\t%-8s Grants: %lu\tHold mean: %lu us max: %lu us\tPreempted: %lu\r\n",
+                       client_names[loop],
+                       (unsigned long)client->grants,
+                       (client->grants > 0) ? (unsigned long)(client->hold_total_us / client->grants) : 0UL,
+                       (unsigned long)client->hold_max_us,
+                       (unsigned long)client->preemptions));
+        configPRINTF(("\t%-8s Waits <100us: %lu <1ms: %lu <10ms: %lu <100ms: %lu longer: %lu\tMax: %lu us\r\n",
+                       "",
+                       (unsigned long)client->wait_histogram[0],
+                       (unsigned long)client->wait_histogram[1],
+                       (unsigned long)client->wait_histogram[2],
+                       (unsigned long)client->wait_histogram[3],
+                       (unsigned long)client->wait_histogram[4],
+                       (unsigned long)client->wait_max_us));
+    }
+}
+
+/*************** Print Filters ***************/
+/*
+ * Summary: Print the filters of each channel of the weather data and how many
+ * changes of the samples made it through them.
+ */
+void print_filters(void)
+{
+    static const char * const channel_names[IOT_CHANNELS] = { "Temperature", "Humidity", "Light" };
+    filter_config_t config;
+    filter_stats_t stats;
+    uint8_t channel;
+
+    for(channel = 0; channel < IOT_CHANNELS; channel++)
+    {
+        filter_get_config(channel, &config);
+        filter_get_stats(channel, &stats);
+        configPRINTF(("\t%-12s Median: %u\tEMA: 1/%u\tKalman: %s q=%u r=%u\r\n",
+                       channel_names[channel],
+                       (unsigned int)config.median,
+                       (unsigned int)(1u << config.ema_shift),
+                       config.kalman ? "on" : "off",
+                       (unsigned int)config.kalman_q,
+                       (unsigned int)config.kalman_r));
+        configPRINTF(("\t%-12s Samples: %lu\tChanges: %lu raw, %lu filtered\r\n",
+                       "",
+                       (unsigned long)stats.samples,
+                       (unsigned long)stats.raw_changes,
+                       (unsigned long)stats.filtered_changes));
+    }
+}
@@ -10,6 +10,13 @@
 
 #include "cyhal.h"
 
+/* Bytes of the emWin memory pool */
+#define GUI_NUMBYTES                (1024*10)
+
+/* Data bytes written to the display controller in one I2C transfer, a slice
+ * of about 1 ms at 400 kHz after which the AFE can take the bus */
+#define DISPLAY_STREAM_BYTES        (32)
+
 extern cyhal_i2c_t afe_shield_i2c_obj;  /* Object to access I2C interface for shield */
 
 #endif /* SOURCE_CY8CKIT_032_OLED_DISPLAY_INTERFACE_H_ */
@@ -13,9 +13,13 @@
 #include "../../cy8ckit_032_oled/driver/i2c_portapi.h"
 
 #include "GUI.h"
+#include "FreeRTOS.h"
 #include "cyhal.h"
 #include "cybsp.h"
 #include "stdlib.h"
+#include "string.h"
+#include "display_interface.h"
+#include "i2c_operation.h"
 
 /*********************************************************************
 *
@@ -68,6 +72,7 @@ void I2C_Init(void)
 {
     cyhal_i2c_init(&afe_shield_i2c_obj, DISPLAY_SDA, DISPLAY_SCL, NULL);
     cyhal_i2c_configure(&afe_shield_i2c_obj, &i2c_config);
+    i2c_init();
 }
 
 /*******************************************************************************
@@ -93,7 +98,7 @@ void I2C_WriteCommandByte(unsigned char c)
     buff[1] = (char)c;
     
     /* Write the buffer to display controller */
-    cyhal_i2c_master_write(&afe_shield_i2c_obj, SHIELD_OLED_I2C_ADDRESS, buff, sizeof(buff), 0, true);
+    i2c_transfer(SHIELD_OLED_I2C_ADDRESS, buff, sizeof(buff), NULL, 0);
 }
 
 /*******************************************************************************
@@ -119,7 +124,7 @@ void I2C_WriteDataByte(unsigned char c)
     buff[1] = c;
 
     /* Write the buffer to display controller */
-    cyhal_i2c_master_write(&afe_shield_i2c_obj, SHIELD_OLED_I2C_ADDRESS, buff, sizeof(buff), 0, true);
+    i2c_transfer(SHIELD_OLED_I2C_ADDRESS, buff, sizeof(buff), NULL, 0);
 }
 
 /*******************************************************************************
@@ -138,17 +143,22 @@ void I2C_WriteDataByte(unsigned char c)
 *******************************************************************************/
 void I2C_WriteDataStream(unsigned char * pData, int numBytes) 
 {   
-    uint8_t* buff = (uint8_t*)malloc(numBytes + 1);
-    
+    /* Only called by emWin, which holds its lock, so one buffer is enough */
+    static uint8_t buff[DISPLAY_STREAM_BYTES + 1];
+    int length;
+
     /* Tell the display controller that the following bytes are data bytes */
     buff[0] = OLED_CONTROL_BYTE_DATA;
 
-    /* Copy data bytes to buffer array */
-    memcpy(&buff[1], pData, numBytes);
-
-    /* Write all the data bytes to the display controller */
-    cyhal_i2c_master_write(&afe_shield_i2c_obj, SHIELD_OLED_I2C_ADDRESS, buff, numBytes + 1, 0, true);
-    free(buff);
+    /* The stream is written in slices, so a client with a higher priority can
+     * use the bus in between. The column address of the controller moves on
+     * after each byte, so the slices follow on from each other. */
+    for(; numBytes > 0; numBytes -= length, pData += length)
+    {
+        length = (numBytes < DISPLAY_STREAM_BYTES) ? numBytes : DISPLAY_STREAM_BYTES;
+        memcpy(&buff[1], pData, length);
+        i2c_transfer(SHIELD_OLED_I2C_ADDRESS, buff, length + 1, NULL, 0);
+    }
 }
 
 /*******************************************************************************
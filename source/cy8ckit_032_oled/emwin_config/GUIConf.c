@@ -43,6 +43,7 @@ Purpose     : Display controller initialization
 */
 
 #include "GUI.h"
+#include "display_interface.h"
 
 /*********************************************************************
 *
@@ -51,9 +52,9 @@ Purpose     : Display controller initialization
 **********************************************************************
 */
 //
-// Define the available number of bytes available for the GUI
+// The available number of bytes available for the GUI is GUI_NUMBYTES
+// in display_interface.h
 //
-#define GUI_NUMBYTES  (1024*10)
 
 /*********************************************************************
 *
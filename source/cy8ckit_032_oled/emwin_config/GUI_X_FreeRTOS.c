@@ -107,7 +107,12 @@ void GUI_X_ExecIdle(void) {
 *                       #define GUI_OS 1
 *  needs to be in GUIConf.h
 */
+#if defined(STATIC_ALLOCATION) && (STATIC_ALLOCATION != 0)
+static StaticSemaphore_t _SemaphoreBuffer;
+void GUI_X_InitOS(void)    { _Semaphore = xSemaphoreCreateMutexStatic(&_SemaphoreBuffer); }
+#else
 void GUI_X_InitOS(void)    { _Semaphore = xSemaphoreCreateMutex(); }
+#endif
 void GUI_X_Unlock(void)    { xSemaphoreGive(_Semaphore); }
 void GUI_X_Lock(void)      { xSemaphoreTake(_Semaphore, portMAX_DELAY);  }
 U32  GUI_X_GetTaskId(void) { return (U32)xTaskGetCurrentTaskHandle(); }
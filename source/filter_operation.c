@@ -0,0 +1,414 @@
+/******************************************************************************
+* File Name: filter_operation.c
+*
+* Description: This file contains the filters of the temperature, humidity,
+* and light of my thing. Each channel goes through a median of the last
+* samples, which drops single spikes, an exponential moving average and
+* optionally a one-dimensional Kalman filter, all in fixed point. The result
+* is rounded back to the steps of the channel with a little hysteresis, so a
+* value sitting between two steps doesn't flip back and forth.
+*
+* The filters of each channel can be changed at runtime with a message on
+* weatherstation/Thing_NN/filter/set, for example
+*   {"temperature":{"median":5,"ema":3,"kalman":true,"q":1,"r":16}}
+* Fields left out keep their setting.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <string.h>
+#include "cyhal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cJSON.h"
+#include "filter_operation.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* One step of the channel in the filter state */
+#define FILTER_ONE                              (1 << FILTER_FRACTION_BITS)
+
+/* Gain of the Kalman filter, 1.0 is 1 << FILTER_GAIN_BITS */
+#define FILTER_GAIN_BITS                        (15)
+
+/* Largest configuration message and its depth */
+#define FILTER_CONFIG_MAX_LENGTH                (512)
+#define FILTER_CONFIG_MAX_DEPTH                 (3)
+
+/***************************************
+*            Types
+****************************************/
+/* State of the filters of a channel */
+typedef struct {
+    int16_t window[FILTER_MEDIAN_MAX];          /* Last samples, for the median */
+    uint8_t next;                               /* Where the next sample goes in the window */
+    uint8_t count;                              /* Samples in the window */
+    bool started;                               /* The EMA and Kalman filter have a value */
+    int32_t ema;                                /* In 1/FILTER_ONE steps */
+    int32_t estimate;                           /* Kalman estimate, in 1/FILTER_ONE steps */
+    uint32_t variance;                          /* Kalman variance, in 1/FILTER_ONE squared steps */
+    int16_t raw;                                /* Last sample */
+    int16_t output;                             /* Last output */
+} filter_state_t;
+
+/***************************************
+*          Global Variables
+****************************************/
+/* Names of the channels in the configuration messages */
+static const char * const filter_channel_names[IOT_CHANNELS] = { "temperature", "humidity", "light" };
+
+/* Filters of the channels, the sensors jitter by a step or two */
+static filter_config_t filter_config[IOT_CHANNELS] =
+{
+    { 3, 2, 0, 0, 1, 16 },
+    { 3, 2, 0, 0, 1, 16 },
+    { 3, 2, 0, 0, 1, 16 },
+};
+
+/* Channels whose settings changed and need their state cleared */
+static volatile bool filter_reset[IOT_CHANNELS];
+
+static filter_state_t filter_state[IOT_CHANNELS];
+static filter_stats_t filter_stats[IOT_CHANNELS];
+
+/*************** Median ***************/
+/*
+ * Summary: Put a sample in the window of the median and take the median of
+ * the window.
+ *
+ *  @param[in] state State of the channel.
+ *  @param[in] size Samples of the median.
+ *  @param[in] value The sample.
+ *
+ *  @return The median of the samples in the window.
+ */
+static int16_t median(filter_state_t *state, uint8_t size, int16_t value)
+{
+    int16_t sorted[FILTER_MEDIAN_MAX];
+    int16_t insert;
+    uint8_t loop;
+    uint8_t position;
+
+    state->window[state->next] = value;
+    state->next = (state->next + 1) % size;
+    if(state->count < size)
+    {
+        state->count++;
+    }
+
+    /* Insertion sort, the window is short */
+    for(loop = 0; loop < state->count; loop++)
+    {
+        insert = state->window[loop];
+        for(position = loop; (position > 0) && (sorted[position - 1] > insert); position--)
+        {
+            sorted[position] = sorted[position - 1];
+        }
+        sorted[position] = insert;
+    }
+    return sorted[state->count / 2];
+}
+
+/*************** Kalman Filter ***************/
+/*
+ * Summary: Update the estimate of a value that drifts slowly with a new
+ * measurement.
+ *
+ *  @param[in] state State of the channel.
+ *  @param[in] config Filters of the channel.
+ *  @param[in] measurement The measurement, in 1/FILTER_ONE steps.
+ */
+static void kalman(filter_state_t *state, const filter_config_t *config, int32_t measurement)
+{
+    uint32_t noise = (uint32_t)config->kalman_r * FILTER_ONE;
+    uint32_t gain;
+
+    /* The value may have drifted since the last estimate */
+    state->variance += (uint32_t)config->kalman_q * FILTER_ONE;
+
+    /* Weigh the measurement against the estimate by their variances */
+    gain = (uint32_t)(((uint64_t)state->variance << FILTER_GAIN_BITS) / ((uint64_t)state->variance + noise));
+    state->estimate += (int32_t)(((int64_t)gain * (measurement - state->estimate)) / (1 << FILTER_GAIN_BITS));
+    state->variance -= (uint32_t)(((uint64_t)gain * state->variance) >> FILTER_GAIN_BITS);
+}
+
+/*************** Quantize ***************/
+/*
+ * Summary: Round the filtered value to a step of the channel, with
+ * hysteresis around the last output.
+ *
+ *  @param[in] state State of the channel.
+ *  @param[in] value The filtered value, in 1/FILTER_ONE steps.
+ *
+ *  @return The output.
+ */
+static int16_t quantize(const filter_state_t *state, int32_t value)
+{
+    int32_t distance = value - ((int32_t)state->output * FILTER_ONE);
+
+    if((distance < ((FILTER_ONE / 2) + FILTER_HYSTERESIS)) &&
+       (distance > -((FILTER_ONE / 2) + FILTER_HYSTERESIS)))
+    {
+        return state->output;
+    }
+    if(value >= 0)
+    {
+        return (int16_t)((value + (FILTER_ONE / 2)) / FILTER_ONE);
+    }
+    return (int16_t)-((-value + (FILTER_ONE / 2)) / FILTER_ONE);
+}
+
+/*************** Initialize Filters ***************/
+/*
+ * Summary: Clear the state of the filters of all channels.
+ */
+void filter_init(void)
+{
+    memset(filter_state, 0, sizeof(filter_state));
+    memset(filter_stats, 0, sizeof(filter_stats));
+}
+
+/*************** Apply Filters ***************/
+/*
+ * Summary: Run a sample of a channel through its filters. Called by the AFE
+ * thread only.
+ *
+ *  @param[in] channel IOT_TEMPERATURE, IOT_HUMIDITY or IOT_LIGHT.
+ *  @param[in] value The sample, in the fixed-point steps of the channel.
+ *
+ *  @return The filtered value.
+ */
+int16_t filter_apply(uint8_t channel, int16_t value)
+{
+    filter_state_t *state = &filter_state[channel];
+    filter_stats_t *stats = &filter_stats[channel];
+    filter_config_t config;
+    int32_t filtered;
+    int16_t output;
+
+    /* Take the settings and start over if they changed */
+    taskENTER_CRITICAL();
+    config = filter_config[channel];
+    if(filter_reset[channel])
+    {
+        filter_reset[channel] = false;
+        state->count = 0;
+        state->next = 0;
+        state->started = false;
+    }
+    taskEXIT_CRITICAL();
+
+    stats->samples++;
+    if(value != state->raw)
+    {
+        stats->raw_changes++;
+    }
+    state->raw = value;
+
+    if(config.median > 1)
+    {
+        value = median(state, config.median, value);
+    }
+    filtered = (int32_t)value * FILTER_ONE;
+
+    if(!state->started)
+    {
+        /* Start from the first sample */
+        state->started = true;
+        state->ema = filtered;
+        state->estimate = filtered;
+        state->variance = (uint32_t)config.kalman_r * FILTER_ONE;
+        output = value;
+    }
+    else
+    {
+        if(config.ema_shift > 0)
+        {
+            state->ema += (filtered - state->ema) / (1 << config.ema_shift);
+            filtered = state->ema;
+        }
+        if(config.kalman)
+        {
+            kalman(state, &config, filtered);
+            filtered = state->estimate;
+        }
+        output = quantize(state, filtered);
+    }
+
+    if(output != state->output)
+    {
+        stats->filtered_changes++;
+    }
+    state->output = output;
+    return output;
+}
+
+/*************** Set Filter Configuration ***************/
+/*
+ * Summary: Change the filters of a channel. The state of the channel starts
+ * over with the next sample.
+ *
+ *  @param[in] channel IOT_TEMPERATURE, IOT_HUMIDITY or IOT_LIGHT.
+ *  @param[in] config The filters.
+ *
+ *  @return false if the channel or the filters are not valid.
+ */
+bool filter_set_config(uint8_t channel, const filter_config_t *config)
+{
+    if((channel >= IOT_CHANNELS) ||
+       (config->median == 0) || (config->median > FILTER_MEDIAN_MAX) || ((config->median % 2) == 0) ||
+       (config->ema_shift > FILTER_EMA_SHIFT_MAX) ||
+       (config->kalman > 1) || (config->kalman_r == 0))
+    {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    filter_config[channel] = *config;
+    filter_config[channel].reserved = 0;
+    filter_reset[channel] = true;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+/*************** Get Filter Configuration ***************/
+/*
+ * Summary: Copy the filters of a channel.
+ *
+ *  @param[in] channel IOT_TEMPERATURE, IOT_HUMIDITY or IOT_LIGHT.
+ *  @param[out] config The filters.
+ */
+void filter_get_config(uint8_t channel, filter_config_t *config)
+{
+    taskENTER_CRITICAL();
+    *config = filter_config[channel];
+    taskEXIT_CRITICAL();
+}
+
+/*************** Get Filter Statistics ***************/
+/*
+ * Summary: Copy the effect of the filters of a channel.
+ *
+ *  @param[in] channel IOT_TEMPERATURE, IOT_HUMIDITY or IOT_LIGHT.
+ *  @param[out] stats The effect of the filters.
+ */
+void filter_get_stats(uint8_t channel, filter_stats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = filter_stats[channel];
+    taskEXIT_CRITICAL();
+}
+
+/*************** Read Setting ***************/
+/*
+ * Summary: Read a number from the settings of a channel.
+ *
+ *  @param[in] settings The settings of the channel.
+ *  @param[in] name Name of the setting.
+ *  @param[in] min Lowest valid value.
+ *  @param[in] max Highest valid value.
+ *  @param[in,out] value Set to the number if the setting is there.
+ *
+ *  @return false if the setting is there but not a number in range.
+ */
+static bool read_setting(const cJSON *settings, const char *name, int32_t min, int32_t max, int32_t *value)
+{
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(settings, name);
+    int32_t number;
+
+    if(item == NULL)
+    {
+        return true;
+    }
+    if(cJSON_IsBool(item))
+    {
+        number = cJSON_IsTrue(item) ? 1 : 0;
+    }
+    else if(cJSON_IsNumber(item))
+    {
+        number = item->valueint;
+    }
+    else
+    {
+        return false;
+    }
+    if((number < min) || (number > max))
+    {
+        return false;
+    }
+    *value = number;
+    return true;
+}
+
+/*************** Parse Filter Configuration ***************/
+/*
+ * Summary: Change the filters of the channels named in a configuration
+ * message. A channel is only changed if all of its settings are valid.
+ *
+ *  @param[in] pPayload The message.
+ *  @param[in] payloadLength Length of the message.
+ *
+ *  @return false if the message is not valid or a channel was rejected.
+ */
+bool filter_parse_config(const char *pPayload, size_t payloadLength)
+{
+    cJSON *document;
+    cJSON *settings;
+    filter_config_t config;
+    int32_t median_size, ema_shift, kalman_on, kalman_q, kalman_r;
+    bool valid = true;
+    uint8_t channel;
+
+    if((payloadLength > FILTER_CONFIG_MAX_LENGTH) ||
+       !cJSON_Validate(pPayload, payloadLength, FILTER_CONFIG_MAX_DEPTH, NULL))
+    {
+        return false;
+    }
+    document = cJSON_ParseLazy(pPayload, payloadLength, NULL);
+    if(!cJSON_IsObject(document))
+    {
+        cJSON_Delete(document);
+        return false;
+    }
+
+    for(channel = 0; channel < IOT_CHANNELS; channel++)
+    {
+        settings = cJSON_GetObjectItemCaseSensitive(document, filter_channel_names[channel]);
+        if(settings == NULL)
+        {
+            continue;
+        }
+
+        /* Start from the current settings */
+        filter_get_config(channel, &config);
+        median_size = config.median;
+        ema_shift = config.ema_shift;
+        kalman_on = config.kalman;
+        kalman_q = config.kalman_q;
+        kalman_r = config.kalman_r;
+        if(!cJSON_IsObject(settings) ||
+           !read_setting(settings, "median", 1, FILTER_MEDIAN_MAX, &median_size) ||
+           !read_setting(settings, "ema", 0, FILTER_EMA_SHIFT_MAX, &ema_shift) ||
+           !read_setting(settings, "kalman", 0, 1, &kalman_on) ||
+           !read_setting(settings, "q", 0, UINT16_MAX, &kalman_q) ||
+           !read_setting(settings, "r", 1, UINT16_MAX, &kalman_r))
+        {
+            valid = false;
+            continue;
+        }
+
+        config.median = (uint8_t)median_size;
+        config.ema_shift = (uint8_t)ema_shift;
+        config.kalman = (uint8_t)kalman_on;
+        config.kalman_q = (uint16_t)kalman_q;
+        config.kalman_r = (uint16_t)kalman_r;
+        if(!filter_set_config(channel, &config))
+        {
+            valid = false;
+        }
+    }
+
+    cJSON_Delete(document);
+    return valid;
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+* File Name: filter_operation.h
+*
+* Description: This file contains declarations related to the filters of the
+* weather data of my thing.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_FILTER_OPERATION_H_
+#define SOURCE_FILTER_OPERATION_H_
+
+#include "common_resource.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Longest median window and highest EMA shift */
+#define FILTER_MEDIAN_MAX                       (7)
+#define FILTER_EMA_SHIFT_MAX                    (6)
+
+/* Fraction bits of the EMA and Kalman filter state */
+#define FILTER_FRACTION_BITS                    (8)
+
+/* The output moves to the next step once the filtered value is this far past
+ * the middle between two steps, in 1/256 of a step */
+#define FILTER_HYSTERESIS                       (64)
+
+/***************************************
+*            Types
+****************************************/
+/* Filters of a channel, in the order they are applied. Values are in the
+ * fixed-point steps of the channel, 0.1 °C for the temperature. */
+typedef struct {
+    uint8_t median;                             /* Samples of the median, odd, 1 turns it off */
+    uint8_t ema_shift;                          /* A new sample weighs 1/2^ema_shift, 0 turns it off */
+    uint8_t kalman;                             /* 1 turns the Kalman filter on */
+    uint8_t reserved;
+    uint16_t kalman_q;                          /* Process noise variance, in squared steps */
+    uint16_t kalman_r;                          /* Measurement noise variance, in squared steps */
+} filter_config_t;
+
+/* Effect of the filters of a channel */
+typedef struct {
+    uint32_t samples;
+    uint32_t raw_changes;                       /* Samples different from the one before */
+    uint32_t filtered_changes;                  /* Outputs different from the one before */
+} filter_stats_t;
+
+/***************************************
+*      Function Declarations
+****************************************/
+void filter_init(void);
+int16_t filter_apply(uint8_t channel, int16_t value);
+bool filter_set_config(uint8_t channel, const filter_config_t *config);
+void filter_get_config(uint8_t channel, filter_config_t *config);
+void filter_get_stats(uint8_t channel, filter_stats_t *stats);
+bool filter_parse_config(const char *pPayload, size_t payloadLength);
+
+#endif /* SOURCE_FILTER_OPERATION_H_ */
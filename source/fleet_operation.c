@@ -0,0 +1,373 @@
+/******************************************************************************
+* File Name: fleet_operation.c
+*
+* Description: This file contains the aggregates and indices of the weather
+* data over all things. They are updated on every write of the thing data, so
+* reading them never walks the things: the summary is O(1), the query for the
+* alerting things is O(k) and the query for the top things of a channel is
+* O(k^2) in the number k of things it returns, a handful.
+*
+* The things of each channel are kept in a binary heap with the lowest value
+* at the root and in one with the highest value at the root. A write moves the
+* thing up or down its path in each heap, at most log2(THING_COUNT) swaps, so
+* the critical section of a write is short whatever the values.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <string.h>
+#include "cyhal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "fleet_operation.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Heaps of each channel, the lowest value first and the highest value first */
+#define FLEET_ORDERS                            (2)
+#define FLEET_LOWEST                            (0)
+#define FLEET_HIGHEST                           (1)
+
+/***************************************
+*          Global Variables
+****************************************/
+/* Values of each channel in the thing data */
+static const int16_t * const channel_values[IOT_CHANNELS] =
+{
+    iot_fleet.temp,
+    iot_fleet.humidity,
+    iot_fleet.light
+};
+
+/* Bit set once a thing has written its data */
+static uint32_t reporting[THING_BITSET_WORDS];
+static uint8_t reporting_count;
+static uint8_t alert_count;
+
+/* Sum of each channel over the reporting things */
+static int32_t channel_sum[IOT_CHANNELS];
+
+/* Heaps of the reporting things of each channel, the node of each thing in
+ * them. On a tie the lower thing number goes first in the lowest first heap
+ * and the higher thing number in the highest first heap. */
+static uint8_t heap[IOT_CHANNELS][FLEET_ORDERS][THING_COUNT];
+static uint8_t heap_node[IOT_CHANNELS][FLEET_ORDERS][THING_COUNT];
+
+/*************** Is Alert On ***************/
+/*
+ * Summary: Check the weather alert of a thing in the thing data.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *
+ *  @return 1 if the alert is on, 0 otherwise.
+ */
+static uint8_t is_alert_on(uint8_t thingNumber)
+{
+    return ((iot_fleet.alert[THING_WORD(thingNumber)] & THING_BIT(thingNumber)) != 0) ? 1 : 0;
+}
+
+/*************** Goes Before ***************/
+/*
+ * Summary: Compare two things in a heap of a channel.
+ *
+ *  @param[in] channel The channel.
+ *  @param[in] order FLEET_LOWEST or FLEET_HIGHEST.
+ *  @param[in] a A thing number.
+ *  @param[in] b A thing number.
+ *
+ *  @return true if a goes before b.
+ */
+static bool goes_before(uint8_t channel, uint8_t order, uint8_t a, uint8_t b)
+{
+    const int16_t *values = channel_values[channel];
+
+    if(order == FLEET_HIGHEST)
+    {
+        return (values[a] > values[b]) || ((values[a] == values[b]) && (a > b));
+    }
+    return (values[a] < values[b]) || ((values[a] == values[b]) && (a < b));
+}
+
+/*************** Swap Nodes ***************/
+/*
+ * Summary: Swap the things of two nodes of a heap.
+ *
+ *  @param[in] channel The channel.
+ *  @param[in] order FLEET_LOWEST or FLEET_HIGHEST.
+ *  @param[in] a A node.
+ *  @param[in] b A node.
+ */
+static void swap_nodes(uint8_t channel, uint8_t order, uint8_t a, uint8_t b)
+{
+    uint8_t *things = heap[channel][order];
+    uint8_t thing = things[a];
+
+    things[a] = things[b];
+    things[b] = thing;
+    heap_node[channel][order][things[a]] = a;
+    heap_node[channel][order][things[b]] = b;
+}
+
+/*************** Sift Thing ***************/
+/*
+ * Summary: Move a thing whose value changed up or down its path in a heap
+ * until its parent goes before it and it goes before its children.
+ *
+ *  @param[in] channel The channel.
+ *  @param[in] order FLEET_LOWEST or FLEET_HIGHEST.
+ *  @param[in] thingNumber The number of the thing, it has to be in the heap.
+ */
+static void sift_thing(uint8_t channel, uint8_t order, uint8_t thingNumber)
+{
+    const uint8_t *things = heap[channel][order];
+    uint8_t node = heap_node[channel][order][thingNumber];
+    uint8_t parent;
+    uint8_t child;
+
+    while(node > 0)
+    {
+        parent = (uint8_t)((node - 1) / 2);
+        if(!goes_before(channel, order, thingNumber, things[parent]))
+        {
+            break;
+        }
+        swap_nodes(channel, order, node, parent);
+        node = parent;
+    }
+
+    while(1)
+    {
+        child = (uint8_t)((2 * node) + 1);
+        if(child >= reporting_count)
+        {
+            break;
+        }
+        if(((child + 1) < reporting_count) && goes_before(channel, order, things[child + 1], things[child]))
+        {
+            child++;
+        }
+        if(!goes_before(channel, order, things[child], thingNumber))
+        {
+            break;
+        }
+        swap_nodes(channel, order, node, child);
+        node = child;
+    }
+}
+
+/*************** Initialize Fleet Aggregates ***************/
+/*
+ * Summary: Start with no thing reporting. Call it after the thing data is
+ * initialized and before any thread writes it.
+ */
+void fleet_init(void)
+{
+    memset(reporting, 0, sizeof(reporting));
+    reporting_count = 0;
+    alert_count = 0;
+    memset(channel_sum, 0, sizeof(channel_sum));
+    memset(heap, FLEET_NO_THING, sizeof(heap));
+}
+
+/*************** Remove Thing from Aggregates ***************/
+/*
+ * Summary: Take the current data of a thing out of the sums and counts. It is
+ * called by iot_data_write_begin, inside the critical section of the write.
+ *
+ *  @param[in] thingNumber The number of the thing about to be written.
+ */
+void fleet_remove(uint8_t thingNumber)
+{
+    uint8_t channel;
+
+    if(!fleet_is_reporting(thingNumber))
+    {
+        return;
+    }
+    for(channel = 0; channel < IOT_CHANNELS; channel++)
+    {
+        channel_sum[channel] -= channel_values[channel][thingNumber];
+    }
+    alert_count -= is_alert_on(thingNumber);
+}
+
+/*************** Add Thing to Aggregates ***************/
+/*
+ * Summary: Add the new data of a thing to the sums, counts and heaps. It is
+ * called by iot_data_write_end, inside the critical section of the write.
+ *
+ *  @param[in] thingNumber The number of the thing that was written.
+ */
+void fleet_add(uint8_t thingNumber)
+{
+    uint8_t channel;
+    uint8_t order;
+
+    if(!fleet_is_reporting(thingNumber))
+    {
+        /* A new thing starts at the last node of the heaps */
+        for(channel = 0; channel < IOT_CHANNELS; channel++)
+        {
+            for(order = 0; order < FLEET_ORDERS; order++)
+            {
+                heap[channel][order][reporting_count] = thingNumber;
+                heap_node[channel][order][thingNumber] = reporting_count;
+            }
+        }
+        reporting[THING_WORD(thingNumber)] |= THING_BIT(thingNumber);
+        reporting_count++;
+    }
+    for(channel = 0; channel < IOT_CHANNELS; channel++)
+    {
+        channel_sum[channel] += channel_values[channel][thingNumber];
+        for(order = 0; order < FLEET_ORDERS; order++)
+        {
+            sift_thing(channel, order, thingNumber);
+        }
+    }
+    alert_count += is_alert_on(thingNumber);
+}
+
+/*************** Get Fleet Summary ***************/
+/*
+ * Summary: Read the aggregates. Only the roots of the heaps are looked at,
+ * so this is O(1) and the critical section is short.
+ *
+ *  @param[out] summary The aggregates.
+ */
+void fleet_get_summary(fleet_summary_t *summary)
+{
+    uint8_t channel;
+    uint8_t thing;
+
+    taskENTER_CRITICAL();
+    summary->reporting = reporting_count;
+    summary->alerts = alert_count;
+    for(channel = 0; channel < IOT_CHANNELS; channel++)
+    {
+        thing = heap[channel][FLEET_LOWEST][0];
+        summary->min_thing[channel] = thing;
+        summary->min[channel] = (thing != FLEET_NO_THING) ? channel_values[channel][thing] : 0;
+
+        thing = heap[channel][FLEET_HIGHEST][0];
+        summary->max_thing[channel] = thing;
+        summary->max[channel] = (thing != FLEET_NO_THING) ? channel_values[channel][thing] : 0;
+
+        summary->mean[channel] = (reporting_count > 0) ?
+                                 (int16_t)(channel_sum[channel] / reporting_count) : 0;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*************** Is Reporting ***************/
+/*
+ * Summary: Check if a thing has written its data.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *
+ *  @return true if the thing takes part in the aggregates.
+ */
+bool fleet_is_reporting(uint8_t thingNumber)
+{
+    return ((reporting[THING_WORD(thingNumber)] & THING_BIT(thingNumber)) != 0);
+}
+
+/*************** Get Next Alerting Thing ***************/
+/*
+ * Summary: Find the next thing with the weather alert on, a word of the alert
+ * bitset at a time. Start with 0 and pass the last thing found plus one to
+ * walk all of them.
+ *
+ *  @param[in] thingNumber The first thing to look at.
+ *
+ *  @return The lowest thing from thingNumber on with the alert on or
+ *  FLEET_NO_THING.
+ */
+uint8_t fleet_next_alert(uint8_t thingNumber)
+{
+    uint32_t word;
+    uint8_t loop;
+
+    if(thingNumber >= THING_COUNT)
+    {
+        return FLEET_NO_THING;
+    }
+
+    /* Drop the bits of the things before thingNumber in its word */
+    loop = THING_WORD(thingNumber);
+    word = iot_fleet.alert[loop] & ~(THING_BIT(thingNumber) - 1);
+    while(word == 0)
+    {
+        if(++loop >= THING_BITSET_WORDS)
+        {
+            return FLEET_NO_THING;
+        }
+        word = iot_fleet.alert[loop];
+    }
+    /* Lowest set bit, CMSIS has no count of trailing zeros */
+    return (uint8_t)((loop * 32) + __CLZ(__RBIT(word)));
+}
+
+/*************** Get Top Things ***************/
+/*
+ * Summary: Read the things with the highest or lowest values of a channel
+ * from its heap. The next thing is the best of the candidates, which start
+ * with the root, and its children become candidates in its place. Each thing
+ * adds at most one candidate, so this takes O(count^2) steps whatever the
+ * number of things.
+ *
+ *  @param[in] channel The channel, IOT_TEMPERATURE, IOT_HUMIDITY or IOT_LIGHT.
+ *  @param[in] highest true for the highest values, false for the lowest.
+ *  @param[out] things The thing numbers, the best first.
+ *  @param[out] values Their values in the fixed point of the thing data.
+ *  @param[in] count Room in things and values.
+ *
+ *  @return The number of things returned, fewer than count if fewer things
+ *  have reported.
+ */
+uint8_t fleet_get_top(uint8_t channel, bool highest, uint8_t *things, int16_t *values, uint8_t count)
+{
+    uint8_t order = highest ? FLEET_HIGHEST : FLEET_LOWEST;
+    const uint8_t *nodes = heap[channel][order];
+    uint8_t candidates[THING_COUNT];
+    uint8_t candidate_count = 1;
+    uint8_t best;
+    uint8_t child;
+    uint8_t loop;
+    uint8_t scan;
+
+    candidates[0] = 0;
+    taskENTER_CRITICAL();
+    if(count > reporting_count)
+    {
+        count = reporting_count;
+    }
+    for(loop = 0; loop < count; loop++)
+    {
+        best = 0;
+        for(scan = 1; scan < candidate_count; scan++)
+        {
+            if(goes_before(channel, order, nodes[candidates[scan]], nodes[candidates[best]]))
+            {
+                best = scan;
+            }
+        }
+        things[loop] = nodes[candidates[best]];
+        values[loop] = channel_values[channel][things[loop]];
+
+        /* Replace the node taken with its children */
+        child = (uint8_t)((2 * candidates[best]) + 1);
+        candidates[best] = candidates[--candidate_count];
+        if(child < reporting_count)
+        {
+            candidates[candidate_count++] = child;
+        }
+        if((child + 1) < reporting_count)
+        {
+            candidates[candidate_count++] = (uint8_t)(child + 1);
+        }
+    }
+    taskEXIT_CRITICAL();
+    return count;
+}
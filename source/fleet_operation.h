@@ -0,0 +1,47 @@
+/******************************************************************************
+* File Name: fleet_operation.h
+*
+* Description: This file contains declarations related to the aggregates and
+* indices of the weather data over all things.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_FLEET_OPERATION_H_
+#define SOURCE_FLEET_OPERATION_H_
+
+#include "common_resource.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Thing number of an aggregate that no thing contributes to */
+#define FLEET_NO_THING                          (0xFF)
+
+/***************************************
+*            Types
+****************************************/
+/* Aggregates over the things that have reported, values in the fixed point
+ * of the thing data. min, max and mean are 0 while no thing has reported. */
+typedef struct {
+    uint8_t reporting;                          /* Things that have reported */
+    uint8_t alerts;                             /* Things with the weather alert on */
+    int16_t min[IOT_CHANNELS];
+    int16_t max[IOT_CHANNELS];
+    int16_t mean[IOT_CHANNELS];
+    uint8_t min_thing[IOT_CHANNELS];            /* Thing with the minimum, the lowest number on a tie */
+    uint8_t max_thing[IOT_CHANNELS];            /* Thing with the maximum, the highest number on a tie */
+} fleet_summary_t;
+
+/***************************************
+*      Function Declarations
+****************************************/
+void fleet_init(void);
+void fleet_remove(uint8_t thingNumber);
+void fleet_add(uint8_t thingNumber);
+void fleet_get_summary(fleet_summary_t *summary);
+bool fleet_is_reporting(uint8_t thingNumber);
+uint8_t fleet_next_alert(uint8_t thingNumber);
+uint8_t fleet_get_top(uint8_t channel, bool highest, uint8_t *things, int16_t *values, uint8_t count);
+
+#endif /* SOURCE_FLEET_OPERATION_H_ */
@@ -0,0 +1,527 @@
+/******************************************************************************
+* File Name: heap_operation.c
+*
+* Description: This file contains the heap of the application, a two-level
+* segregated fit (TLSF) allocator over a static pool. Free blocks are kept in
+* lists by size class: a first level per power of two and 16 second-level
+* lists within each. Bitmaps of the non-empty lists let an allocation find a
+* list with a large enough block with a few bit scans, and a freed block is
+* merged with its free neighbours right away, so both take constant time
+* whatever the state of the heap. Only when no list is sure to fit is the list
+* of the size itself walked for a block that is large enough, so an
+* allocation fails only if no free block can hold it.
+*
+* With APP_HEAP it provides pvPortMalloc and vPortFree in place of heap_3.c.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "cyhal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "heap_operation.h"
+
+#if APP_HEAP
+
+/***************************************
+*            Defines
+****************************************/
+/* Alignment of the blocks, and so of the sizes */
+#define HEAP_ALIGN                              (8)
+#define HEAP_ALIGN_UP(size)                     (((size) + (HEAP_ALIGN - 1)) & ~(size_t)(HEAP_ALIGN - 1))
+
+/* Second-level lists per first-level class */
+#define HEAP_SL_LOG2                            (4)
+#define HEAP_SL_COUNT                           (1 << HEAP_SL_LOG2)
+
+/* Blocks below HEAP_SMALL_BLOCK are all in the first class, in lists of one
+ * size each. The others are in the class of their highest bit. */
+#define HEAP_FL_SHIFT                           (HEAP_SL_LOG2 + 3)
+#define HEAP_SMALL_BLOCK                        (1UL << HEAP_FL_SHIFT)
+
+/* Header of a block and the smallest payload, which has to hold the links
+ * of a free block */
+#define HEAP_HEADER_BYTES                       (offsetof(heap_block_t, next_free))
+#define HEAP_MIN_PAYLOAD                        (HEAP_ALIGN_UP(sizeof(heap_block_t) - HEAP_HEADER_BYTES))
+
+/* Flag in the size of a free block */
+#define HEAP_BLOCK_FREE                         ((size_t)1)
+#define HEAP_BLOCK_SIZE(block)                  ((block)->size & ~HEAP_BLOCK_FREE)
+
+/***************************************
+*            Types
+****************************************/
+/* Block of the pool, the payload starts at next_free */
+typedef struct heap_block {
+    struct heap_block *prev_phys;               /* Block before this one in the pool, NULL for the first */
+    size_t size;                                /* Bytes of the payload and HEAP_BLOCK_FREE */
+    struct heap_block *next_free;               /* Links of the list of a free block */
+    struct heap_block *prev_free;
+} heap_block_t;
+
+_Static_assert(HEAP_POOL_BYTES < (1UL << (HEAP_FL_SHIFT + HEAP_CLASSES - 1)),
+               "HEAP_POOL_BYTES is too large for HEAP_CLASSES");
+
+/***************************************
+*          Global Variables
+****************************************/
+static uint64_t heap_pool[HEAP_POOL_BYTES / sizeof(uint64_t)];
+static bool heap_ready = false;
+
+/* Lists of free blocks and the bitmaps of the non-empty ones */
+static heap_block_t *free_lists[HEAP_CLASSES][HEAP_SL_COUNT];
+static uint32_t fl_bitmap;
+static uint32_t sl_bitmap[HEAP_CLASSES];
+
+/* Counters of the statistics, the largest free block is found when asked */
+static heap_stats_t heap_stats;
+
+/*************** Find Last Set Bit ***************/
+/*
+ * Summary: Find the highest bit set in a word.
+ *
+ *  @param[in] word The word, not 0.
+ *
+ *  @return The index of the bit.
+ */
+static uint8_t find_last_set(uint32_t word)
+{
+    return (uint8_t)(31 - __CLZ(word));
+}
+
+/*************** Find First Set Bit ***************/
+/*
+ * Summary: Find the lowest bit set in a word. CMSIS has no count of trailing
+ * zeros, so the bits are reversed first.
+ *
+ *  @param[in] word The word, not 0.
+ *
+ *  @return The index of the bit.
+ */
+static uint8_t find_first_set(uint32_t word)
+{
+    return (uint8_t)__CLZ(__RBIT(word));
+}
+
+/*************** Map Size ***************/
+/*
+ * Summary: Get the list of the blocks of a size.
+ *
+ *  @param[in] size The payload size.
+ *  @param[out] fl The first-level class.
+ *  @param[out] sl The second-level list in the class.
+ */
+static void map_size(uint32_t size, uint8_t *fl, uint8_t *sl)
+{
+    uint8_t bit;
+
+    if(size < HEAP_SMALL_BLOCK)
+    {
+        *fl = 0;
+        *sl = (uint8_t)(size / (HEAP_SMALL_BLOCK / HEAP_SL_COUNT));
+    }
+    else
+    {
+        bit = find_last_set(size);
+        *fl = (uint8_t)(bit - HEAP_FL_SHIFT + 1);
+        *sl = (uint8_t)((size >> (bit - HEAP_SL_LOG2)) ^ HEAP_SL_COUNT);
+    }
+}
+
+/*************** Next Block ***************/
+/*
+ * Summary: Get the block after a block in the pool.
+ *
+ *  @param[in] block The block.
+ *
+ *  @return The next block, the end of the pool is a block of size 0 that is
+ *  never free.
+ */
+static heap_block_t *next_block(heap_block_t *block)
+{
+    return (heap_block_t *)((uint8_t *)block + HEAP_HEADER_BYTES + HEAP_BLOCK_SIZE(block));
+}
+
+/*************** Insert Free Block ***************/
+/*
+ * Summary: Mark a block free and put it at the head of its list.
+ *
+ *  @param[in] block The block.
+ */
+static void insert_block(heap_block_t *block)
+{
+    uint8_t fl;
+    uint8_t sl;
+
+    map_size((uint32_t)HEAP_BLOCK_SIZE(block), &fl, &sl);
+    block->size |= HEAP_BLOCK_FREE;
+    block->prev_free = NULL;
+    block->next_free = free_lists[fl][sl];
+    if(block->next_free != NULL)
+    {
+        block->next_free->prev_free = block;
+    }
+    free_lists[fl][sl] = block;
+    fl_bitmap |= (1UL << fl);
+    sl_bitmap[fl] |= (1UL << sl);
+
+    heap_stats.free_bytes += HEAP_HEADER_BYTES + HEAP_BLOCK_SIZE(block);
+    heap_stats.free_blocks++;
+}
+
+/*************** Remove Free Block ***************/
+/*
+ * Summary: Take a free block out of its list and mark it used.
+ *
+ *  @param[in] block The block.
+ */
+static void remove_block(heap_block_t *block)
+{
+    uint8_t fl;
+    uint8_t sl;
+
+    map_size((uint32_t)HEAP_BLOCK_SIZE(block), &fl, &sl);
+    if(block->prev_free != NULL)
+    {
+        block->prev_free->next_free = block->next_free;
+    }
+    else
+    {
+        free_lists[fl][sl] = block->next_free;
+        if(block->next_free == NULL)
+        {
+            sl_bitmap[fl] &= ~(1UL << sl);
+            if(sl_bitmap[fl] == 0)
+            {
+                fl_bitmap &= ~(1UL << fl);
+            }
+        }
+    }
+    if(block->next_free != NULL)
+    {
+        block->next_free->prev_free = block->prev_free;
+    }
+    block->size &= ~HEAP_BLOCK_FREE;
+
+    heap_stats.free_bytes -= HEAP_HEADER_BYTES + HEAP_BLOCK_SIZE(block);
+    heap_stats.free_blocks--;
+}
+
+/*************** Initialize Heap ***************/
+/*
+ * Summary: Make the whole pool one free block, followed by the end block.
+ */
+static void heap_init(void)
+{
+    heap_block_t *block = (heap_block_t *)heap_pool;
+    heap_block_t *end;
+    uint8_t loop;
+
+    memset(free_lists, 0, sizeof(free_lists));
+    memset(sl_bitmap, 0, sizeof(sl_bitmap));
+    fl_bitmap = 0;
+    memset(&heap_stats, 0, sizeof(heap_stats));
+    heap_stats.pool_bytes = HEAP_POOL_BYTES;
+    for(loop = 0; loop < HEAP_CLASSES; loop++)
+    {
+        heap_stats.classes[loop].block_limit = 1UL << (HEAP_FL_SHIFT + loop);
+    }
+
+    block->prev_phys = NULL;
+    block->size = HEAP_POOL_BYTES - (2 * HEAP_HEADER_BYTES);
+    end = next_block(block);
+    end->prev_phys = block;
+    end->size = 0;
+    insert_block(block);
+
+    heap_stats.used_bytes = HEAP_HEADER_BYTES;
+    heap_stats.peak_used_bytes = HEAP_HEADER_BYTES;
+    heap_ready = true;
+}
+
+/*************** Find Free Block ***************/
+/*
+ * Summary: Find a free block of at least a size. The size is rounded up to
+ * the next list, so that any block of the list is large enough. If no such
+ * list has a block, the blocks of the list of the size are checked one by one.
+ *
+ *  @param[in] size The payload size.
+ *
+ *  @return A large enough block or NULL.
+ */
+static heap_block_t *find_block(uint32_t size)
+{
+    heap_block_t *block;
+    uint32_t rounded = size;
+    uint32_t map = 0;
+    uint8_t fl;
+    uint8_t sl;
+
+    if(size >= HEAP_SMALL_BLOCK)
+    {
+        rounded += (1UL << (find_last_set(size) - HEAP_SL_LOG2)) - 1;
+    }
+    map_size(rounded, &fl, &sl);
+    if(fl < HEAP_CLASSES)
+    {
+        /* A list of the class, or else the smallest list of a larger class */
+        map = sl_bitmap[fl] & (~0UL << sl);
+        if(map == 0)
+        {
+            map = fl_bitmap & (~0UL << (fl + 1));
+            if(map != 0)
+            {
+                fl = find_first_set(map);
+                map = sl_bitmap[fl];
+            }
+        }
+    }
+    if(map != 0)
+    {
+        sl = find_first_set(map);
+        return free_lists[fl][sl];
+    }
+
+    /* The list of the size holds blocks a little smaller and larger */
+    map_size(size, &fl, &sl);
+    for(block = free_lists[fl][sl]; block != NULL; block = block->next_free)
+    {
+        if(HEAP_BLOCK_SIZE(block) >= size)
+        {
+            return block;
+        }
+    }
+    return NULL;
+}
+
+/*************** Count Block ***************/
+/*
+ * Summary: Count an allocated or freed block in its size class.
+ *
+ *  @param[in] block The block.
+ *  @param[in] allocated true if the block was allocated, false if freed.
+ */
+static void count_block(heap_block_t *block, bool allocated)
+{
+    heap_class_stats_t *size_class;
+    uint8_t fl;
+    uint8_t sl;
+
+    map_size((uint32_t)HEAP_BLOCK_SIZE(block), &fl, &sl);
+    size_class = &heap_stats.classes[fl];
+    if(allocated)
+    {
+        size_class->allocations++;
+        size_class->in_use++;
+        if(size_class->in_use > size_class->peak)
+        {
+            size_class->peak = size_class->in_use;
+        }
+    }
+    else
+    {
+        size_class->in_use--;
+    }
+}
+
+/*************** Allocate Block ***************/
+/*
+ * Summary: Take the block of an allocation from a free block, the rest of the
+ * free block goes back to the lists. Call it with the scheduler suspended.
+ *
+ *  @param[in] wanted Bytes asked for.
+ *
+ *  @return The payload or NULL.
+ */
+static void *allocate(size_t wanted)
+{
+    heap_block_t *block;
+    heap_block_t *rest;
+    size_t size;
+
+    if(!heap_ready)
+    {
+        heap_init();
+    }
+    if((wanted == 0) || (wanted > HEAP_POOL_BYTES))
+    {
+        heap_stats.failures++;
+        return NULL;
+    }
+
+    size = HEAP_ALIGN_UP(wanted);
+    if(size < HEAP_MIN_PAYLOAD)
+    {
+        size = HEAP_MIN_PAYLOAD;
+    }
+    block = find_block((uint32_t)size);
+    if(block == NULL)
+    {
+        heap_stats.failures++;
+        return NULL;
+    }
+    remove_block(block);
+
+    /* Split off what isn't needed if it can make a block */
+    if(HEAP_BLOCK_SIZE(block) >= (size + HEAP_HEADER_BYTES + HEAP_MIN_PAYLOAD))
+    {
+        rest = (heap_block_t *)((uint8_t *)block + HEAP_HEADER_BYTES + size);
+        rest->prev_phys = block;
+        rest->size = HEAP_BLOCK_SIZE(block) - size - HEAP_HEADER_BYTES;
+        next_block(rest)->prev_phys = rest;
+        block->size = size;
+        insert_block(rest);
+    }
+
+    count_block(block, true);
+    heap_stats.allocations++;
+    heap_stats.used_bytes = HEAP_POOL_BYTES - heap_stats.free_bytes;
+    if(heap_stats.used_bytes > heap_stats.peak_used_bytes)
+    {
+        heap_stats.peak_used_bytes = heap_stats.used_bytes;
+    }
+    return &block->next_free;
+}
+
+/*************** Release Block ***************/
+/*
+ * Summary: Return the block of an allocation to the lists, merged with the
+ * free blocks next to it. Call it with the scheduler suspended.
+ *
+ *  @param[in] pointer The payload.
+ */
+static void release(void *pointer)
+{
+    heap_block_t *block = (heap_block_t *)((uint8_t *)pointer - HEAP_HEADER_BYTES);
+    heap_block_t *neighbour;
+
+    configASSERT(((uint8_t *)block >= (uint8_t *)heap_pool) &&
+                 ((uint8_t *)block < ((uint8_t *)heap_pool + HEAP_POOL_BYTES)));
+    configASSERT((block->size & HEAP_BLOCK_FREE) == 0);
+
+    count_block(block, false);
+    heap_stats.frees++;
+
+    neighbour = block->prev_phys;
+    if((neighbour != NULL) && ((neighbour->size & HEAP_BLOCK_FREE) != 0))
+    {
+        remove_block(neighbour);
+        neighbour->size = HEAP_BLOCK_SIZE(neighbour) + HEAP_HEADER_BYTES + HEAP_BLOCK_SIZE(block);
+        block = neighbour;
+    }
+    neighbour = next_block(block);
+    if((neighbour->size & HEAP_BLOCK_FREE) != 0)
+    {
+        remove_block(neighbour);
+        block->size = HEAP_BLOCK_SIZE(block) + HEAP_HEADER_BYTES + HEAP_BLOCK_SIZE(neighbour);
+    }
+    next_block(block)->prev_phys = block;
+    insert_block(block);
+
+    heap_stats.used_bytes = HEAP_POOL_BYTES - heap_stats.free_bytes;
+}
+
+/*************** Largest Free Block ***************/
+/*
+ * Summary: Find the payload size of the largest free block. Only the highest
+ * non-empty list is walked.
+ *
+ *  @return The size, 0 if no block is free.
+ */
+static uint32_t largest_free_block(void)
+{
+    heap_block_t *block;
+    uint32_t largest = 0;
+    uint8_t fl;
+    uint8_t sl;
+
+    if(fl_bitmap == 0)
+    {
+        return 0;
+    }
+    fl = find_last_set(fl_bitmap);
+    sl = find_last_set(sl_bitmap[fl]);
+    for(block = free_lists[fl][sl]; block != NULL; block = block->next_free)
+    {
+        if(HEAP_BLOCK_SIZE(block) > largest)
+        {
+            largest = (uint32_t)HEAP_BLOCK_SIZE(block);
+        }
+    }
+    return largest;
+}
+
+/*************** FreeRTOS Heap Interface ***************/
+void *pvPortMalloc(size_t xWantedSize)
+{
+    void *pointer;
+
+    vTaskSuspendAll();
+    pointer = allocate(xWantedSize);
+    ( void )xTaskResumeAll();
+
+#if (configUSE_MALLOC_FAILED_HOOK == 1)
+    if(pointer == NULL)
+    {
+        extern void vApplicationMallocFailedHook(void);
+        vApplicationMallocFailedHook();
+    }
+#endif
+    return pointer;
+}
+
+void vPortFree(void *pv)
+{
+    if(pv == NULL)
+    {
+        return;
+    }
+    vTaskSuspendAll();
+    release(pv);
+    ( void )xTaskResumeAll();
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+    return heap_ready ? heap_stats.free_bytes : HEAP_POOL_BYTES;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize(void)
+{
+    return heap_ready ? (HEAP_POOL_BYTES - heap_stats.peak_used_bytes) : HEAP_POOL_BYTES;
+}
+
+void vPortInitialiseBlocks(void)
+{
+    /* The pool is set up by the first allocation */
+}
+
+#endif /* APP_HEAP */
+
+/*************** Get Heap Statistics ***************/
+/*
+ * Summary: Read the usage of the heap of the application.
+ *
+ *  @param[out] stats The usage.
+ *
+ *  @return false if the heap of the application isn't used (APP_HEAP is 0).
+ */
+bool heap_get_stats(heap_stats_t *stats)
+{
+#if APP_HEAP
+    vTaskSuspendAll();
+    if(!heap_ready)
+    {
+        heap_init();
+    }
+    *stats = heap_stats;
+    stats->largest_free = largest_free_block();
+    ( void )xTaskResumeAll();
+    return true;
+#else
+    ( void )stats; /* Suppress compiler warning */
+    return false;
+#endif
+}
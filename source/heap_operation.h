@@ -0,0 +1,76 @@
+/******************************************************************************
+* File Name: heap_operation.h
+*
+* Description: This file contains declarations related to the heap of the
+* application, a two-level segregated fit (TLSF) allocator behind pvPortMalloc
+* and vPortFree.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_HEAP_OPERATION_H_
+#define SOURCE_HEAP_OPERATION_H_
+
+#include "common_resource.h"
+
+/***************************************
+*            Defines
+****************************************/
+/*
+ * Set to 1 (DEFINES=APP_HEAP=1 in the Makefile) to serve pvPortMalloc and
+ * vPortFree from the heap of the application instead of heap_3.c, which wraps
+ * the C library malloc. The Makefile then leaves heap_3.c out of the build.
+ * Only the make build supports it: with CMake the heap of the kernel comes
+ * from the Amazon FreeRTOS build, so CMakeLists.txt rejects APP_HEAP.
+ */
+#ifndef APP_HEAP
+#define APP_HEAP                                0
+#endif
+
+/* Bytes of the static pool of the heap */
+#ifndef HEAP_POOL_BYTES
+#define HEAP_POOL_BYTES                         (96 * 1024)
+#endif
+
+/* RAM taken by the heap of the application */
+#if APP_HEAP
+#define HEAP_RAM_BYTES                          (HEAP_POOL_BYTES)
+#else
+#define HEAP_RAM_BYTES                          (0)
+#endif
+
+/* Size classes of the statistics, the first-level lists of the allocator:
+ * blocks below 128 bytes, then one class per power of two up to 256 KB */
+#define HEAP_CLASSES                            (12)
+
+/***************************************
+*            Types
+****************************************/
+/* Usage of one size class */
+typedef struct {
+    uint32_t block_limit;                       /* Blocks of the class are smaller than this */
+    uint16_t in_use;                            /* Blocks allocated now */
+    uint16_t peak;                              /* Highest in_use so far */
+    uint32_t allocations;                       /* Blocks allocated so far */
+} heap_class_stats_t;
+
+/* Usage of the heap. Used and free bytes include the block headers. */
+typedef struct {
+    uint32_t pool_bytes;
+    uint32_t used_bytes;
+    uint32_t peak_used_bytes;
+    uint32_t free_bytes;
+    uint32_t largest_free;                      /* Payload of the largest free block */
+    uint16_t free_blocks;
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t failures;                          /* Allocations that found no block */
+    heap_class_stats_t classes[HEAP_CLASSES];
+} heap_stats_t;
+
+/***************************************
+*      Function Declarations
+****************************************/
+bool heap_get_stats(heap_stats_t *stats);
+
+#endif /* SOURCE_HEAP_OPERATION_H_ */
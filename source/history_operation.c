@@ -0,0 +1,388 @@
+/******************************************************************************
+* File Name: history_operation.c
+*
+* Description: This file contains the weather data history of the things. The
+* history is kept in fixed size ring buffers in fixed point: raw samples and
+* tiers of downsampled buckets with the minimum, maximum and mean of the
+* samples they cover.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <string.h>
+#include "cyhal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "history_operation.h"
+
+/***************************************
+*            Types
+****************************************/
+/* Bucket that is still collecting samples */
+typedef struct {
+    int32_t sum[HISTORY_CHANNELS];  /* Sum of the samples */
+    int16_t min[HISTORY_CHANNELS];
+    int16_t max[HISTORY_CHANNELS];
+    uint32_t samples;               /* Number of samples, 0 if empty */
+    uint32_t start_ms;              /* Start of the time the bucket covers */
+} history_accumulator_t;
+
+/* Ring buffer of buckets of one duration */
+typedef struct {
+    history_bucket_t *buckets;
+    uint16_t size;
+    uint16_t head;                  /* Next bucket to write */
+    uint16_t count;                 /* Buckets written, up to size */
+    uint32_t period_ms;             /* Time covered by one bucket */
+    history_accumulator_t current;
+} history_tier_t;
+
+/* History of one thing */
+typedef struct {
+    history_sample_t *raw;          /* Ring buffer of raw samples, NULL if none are kept */
+    uint16_t raw_size;
+    uint16_t raw_head;
+    uint16_t raw_count;
+    uint8_t tier_count;
+    history_tier_t tiers[HISTORY_MAX_TIERS];
+} thing_history_t;
+
+/***************************************
+*          Global Variables
+****************************************/
+/* Storage of the local thing */
+static history_sample_t local_raw[HISTORY_RAW_SAMPLES];
+static history_bucket_t local_minutes[HISTORY_MINUTE_BUCKETS];
+static history_bucket_t local_hours[HISTORY_HOUR_BUCKETS];
+
+/* Storage of the other things, the slot of the local thing isn't used */
+static history_bucket_t remote_hours[MAX_THING + 1][HISTORY_REMOTE_HOUR_BUCKETS];
+
+static thing_history_t history[MAX_THING + 1];
+
+/* Appends can cascade through the tiers, so they are serialized with a mutex
+ * instead of a critical section */
+static SemaphoreHandle_t history_mutex;
+#if STATIC_ALLOCATION
+static StaticSemaphore_t history_mutex_buffer;
+#endif
+
+/*************** Reset Accumulator ***************/
+/*
+ * Summary: Start an empty bucket.
+ *
+ *  @param[out] current The bucket to reset.
+ *  @param[in] start_ms Start of the time the bucket covers.
+ */
+static void reset_accumulator(history_accumulator_t *current, uint32_t start_ms)
+{
+    uint8_t channel;
+
+    for(channel = 0; channel < HISTORY_CHANNELS; channel++)
+    {
+        current->sum[channel] = 0;
+        current->min[channel] = INT16_MAX;
+        current->max[channel] = INT16_MIN;
+    }
+    current->samples = 0;
+    current->start_ms = start_ms;
+}
+
+/*************** Push Bucket ***************/
+/*
+ * Summary: Write a finished bucket into the ring of a tier, overwriting the
+ * oldest one when the ring is full.
+ *
+ *  @param[in] tier The tier to write to.
+ *  @param[in] current The finished bucket.
+ */
+static void push_bucket(history_tier_t *tier, const history_accumulator_t *current)
+{
+    history_bucket_t *bucket = &tier->buckets[tier->head];
+    uint8_t channel;
+
+    for(channel = 0; channel < HISTORY_CHANNELS; channel++)
+    {
+        bucket->min[channel] = current->min[channel];
+        bucket->max[channel] = current->max[channel];
+        bucket->mean[channel] = (current->samples > 0) ?
+                                (int16_t)(current->sum[channel] / (int32_t)current->samples) : 0;
+    }
+
+    tier->head = (uint16_t)((tier->head + 1) % tier->size);
+    if(tier->count < tier->size)
+    {
+        tier->count++;
+    }
+}
+
+/*************** Feed Tier ***************/
+/*
+ * Summary: Add samples to the current bucket of a tier. When the time has
+ * moved past the bucket it is written to the ring, buckets for periods
+ * without samples are written empty, and the finished bucket is fed to the
+ * next tier. Each tier only moves on once per period, so an append is O(1)
+ * on average.
+ *
+ *  @param[in] thing The history of the thing.
+ *  @param[in] index The tier to feed.
+ *  @param[in] samples The samples to add, summarized as a bucket.
+ *  @param[in] now_ms Time of the samples.
+ */
+static void feed_tier(thing_history_t *thing, uint8_t index, const history_accumulator_t *samples, uint32_t now_ms)
+{
+    history_tier_t *tier = &thing->tiers[index];
+    history_accumulator_t finished;
+    uint32_t periods;
+    uint8_t channel;
+
+    periods = (now_ms - tier->current.start_ms) / tier->period_ms;
+    if(periods > 0)
+    {
+        finished = tier->current;
+        push_bucket(tier, &finished);
+
+        /* Periods in between without samples, at most a full ring of them */
+        reset_accumulator(&tier->current, 0);
+        periods--;
+        if(periods > tier->size)
+        {
+            periods = tier->size;
+        }
+        for(; periods > 0; periods--)
+        {
+            push_bucket(tier, &tier->current);
+        }
+        reset_accumulator(&tier->current, now_ms - (now_ms % tier->period_ms));
+
+        if(((index + 1) < thing->tier_count) && (finished.samples > 0))
+        {
+            feed_tier(thing, (uint8_t)(index + 1), &finished, finished.start_ms);
+        }
+    }
+
+    for(channel = 0; channel < HISTORY_CHANNELS; channel++)
+    {
+        tier->current.sum[channel] += samples->sum[channel];
+        if(samples->min[channel] < tier->current.min[channel])
+        {
+            tier->current.min[channel] = samples->min[channel];
+        }
+        if(samples->max[channel] > tier->current.max[channel])
+        {
+            tier->current.max[channel] = samples->max[channel];
+        }
+    }
+    tier->current.samples += samples->samples;
+}
+
+/*************** Initialize Tier ***************/
+/*
+ * Summary: Set up a tier of a thing's history.
+ *
+ *  @param[in] tier The tier to set up.
+ *  @param[in] buckets Storage of the ring.
+ *  @param[in] size Number of buckets in the storage.
+ *  @param[in] period_ms Time covered by one bucket.
+ *  @param[in] now_ms Current time.
+ */
+static void init_tier(history_tier_t *tier, history_bucket_t *buckets, uint16_t size, uint32_t period_ms, uint32_t now_ms)
+{
+    tier->buckets = buckets;
+    tier->size = size;
+    tier->head = 0;
+    tier->count = 0;
+    tier->period_ms = period_ms;
+    reset_accumulator(&tier->current, now_ms - (now_ms % period_ms));
+}
+
+/*************** Initialize History ***************/
+/*
+ * Summary: Set up the history of all things. Call it before any thread that
+ * appends to or reads the history is started.
+ */
+void history_init(void)
+{
+    uint32_t now_ms = (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+    uint8_t loop;
+
+#if STATIC_ALLOCATION
+    history_mutex = xSemaphoreCreateMutexStatic(&history_mutex_buffer);
+#else
+    history_mutex = xSemaphoreCreateMutex();
+#endif
+
+    memset(history, 0, sizeof(history));
+    for(loop = 0; loop <= MAX_THING; loop++)
+    {
+        if(loop == MY_THING)
+        {
+            history[loop].raw = local_raw;
+            history[loop].raw_size = HISTORY_RAW_SAMPLES;
+            history[loop].tier_count = 2;
+            init_tier(&history[loop].tiers[0], local_minutes, HISTORY_MINUTE_BUCKETS, HISTORY_MINUTE_MS, now_ms);
+            init_tier(&history[loop].tiers[1], local_hours, HISTORY_HOUR_BUCKETS, HISTORY_HOUR_MS, now_ms);
+        }
+        else
+        {
+            history[loop].tier_count = 1;
+            init_tier(&history[loop].tiers[0], remote_hours[loop], HISTORY_REMOTE_HOUR_BUCKETS, HISTORY_HOUR_MS, now_ms);
+        }
+    }
+}
+
+/*************** Append to History ***************/
+/*
+ * Summary: Add a sample to the history of a thing.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *  @param[in] temp Temperature in fixed point.
+ *  @param[in] humidity Relative humidity in fixed point.
+ *  @param[in] light Light in fixed point.
+ */
+void history_append(uint8_t thingNumber, int16_t temp, int16_t humidity, int16_t light)
+{
+    thing_history_t *thing = &history[thingNumber];
+    history_accumulator_t sample;
+    uint32_t now_ms = (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+    uint8_t channel;
+
+    reset_accumulator(&sample, now_ms);
+    sample.min[HISTORY_TEMPERATURE] = temp;
+    sample.min[HISTORY_HUMIDITY] = humidity;
+    sample.min[HISTORY_LIGHT] = light;
+    for(channel = 0; channel < HISTORY_CHANNELS; channel++)
+    {
+        sample.max[channel] = sample.min[channel];
+        sample.sum[channel] = sample.min[channel];
+    }
+    sample.samples = 1;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    if(thing->raw != NULL)
+    {
+        memcpy(thing->raw[thing->raw_head].value, sample.min, sizeof(thing->raw[0].value));
+        thing->raw_head = (uint16_t)((thing->raw_head + 1) % thing->raw_size);
+        if(thing->raw_count < thing->raw_size)
+        {
+            thing->raw_count++;
+        }
+    }
+    if(thing->tier_count > 0)
+    {
+        feed_tier(thing, 0, &sample, now_ms);
+    }
+    xSemaphoreGive(history_mutex);
+}
+
+/*************** Raw Sample Count ***************/
+/*
+ * Summary: Number of raw samples kept for a thing.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *
+ *  @return The number of samples, 0 if the thing has no raw history.
+ */
+uint16_t history_raw_count(uint8_t thingNumber)
+{
+    return history[thingNumber].raw_count;
+}
+
+/*************** Get Raw Sample ***************/
+/*
+ * Summary: Read a raw sample.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *  @param[in] age 0 for the newest sample, 1 for the one before, ...
+ *  @param[out] sample The sample.
+ *
+ *  @return false if there is no such sample.
+ */
+bool history_get_raw(uint8_t thingNumber, uint16_t age, history_sample_t *sample)
+{
+    thing_history_t *thing = &history[thingNumber];
+    bool found = false;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    if(age < thing->raw_count)
+    {
+        *sample = thing->raw[(thing->raw_head + thing->raw_size - 1 - age) % thing->raw_size];
+        found = true;
+    }
+    xSemaphoreGive(history_mutex);
+    return found;
+}
+
+/*************** Tier Count ***************/
+/*
+ * Summary: Number of bucket tiers of a thing, tier 0 has the shortest period.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *
+ *  @return The number of tiers.
+ */
+uint8_t history_tier_count(uint8_t thingNumber)
+{
+    return history[thingNumber].tier_count;
+}
+
+/*************** Tier Period ***************/
+/*
+ * Summary: Time covered by one bucket of a tier.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *  @param[in] tier The tier.
+ *
+ *  @return The period in ms, 0 if there is no such tier.
+ */
+uint32_t history_tier_period_ms(uint8_t thingNumber, uint8_t tier)
+{
+    return (tier < history[thingNumber].tier_count) ? history[thingNumber].tiers[tier].period_ms : 0;
+}
+
+/*************** Bucket Count ***************/
+/*
+ * Summary: Number of finished buckets of a tier.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *  @param[in] tier The tier.
+ *
+ *  @return The number of buckets, 0 if there is no such tier.
+ */
+uint16_t history_bucket_count(uint8_t thingNumber, uint8_t tier)
+{
+    return (tier < history[thingNumber].tier_count) ? history[thingNumber].tiers[tier].count : 0;
+}
+
+/*************** Get Bucket ***************/
+/*
+ * Summary: Read a finished bucket of a tier.
+ *
+ *  @param[in] thingNumber The number of the thing.
+ *  @param[in] tier The tier.
+ *  @param[in] age 0 for the newest bucket, 1 for the one before, ...
+ *  @param[out] bucket The bucket.
+ *
+ *  @return false if there is no such bucket.
+ */
+bool history_get_bucket(uint8_t thingNumber, uint8_t tier, uint16_t age, history_bucket_t *bucket)
+{
+    history_tier_t *ring;
+    bool found = false;
+
+    if(tier >= history[thingNumber].tier_count)
+    {
+        return false;
+    }
+    ring = &history[thingNumber].tiers[tier];
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    if(age < ring->count)
+    {
+        *bucket = ring->buckets[(ring->head + ring->size - 1 - age) % ring->size];
+        found = true;
+    }
+    xSemaphoreGive(history_mutex);
+    return found;
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+* File Name: history_operation.h
+*
+* Description: This file contains declarations related to the weather data
+* history of the things.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_HISTORY_OPERATION_H_
+#define SOURCE_HISTORY_OPERATION_H_
+
+#include "common_resource.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Channels kept in the history, in the order of the values of a sample */
+#define HISTORY_TEMPERATURE                     IOT_TEMPERATURE
+#define HISTORY_HUMIDITY                        IOT_HUMIDITY
+#define HISTORY_LIGHT                           IOT_LIGHT
+#define HISTORY_CHANNELS                        IOT_CHANNELS
+
+/* Fixed-point scale of the channels, the same as the thing data */
+#define HISTORY_TEMPERATURE_SCALE               IOT_TEMPERATURE_SCALE
+#define HISTORY_HUMIDITY_SCALE                  IOT_HUMIDITY_SCALE
+#define HISTORY_LIGHT_SCALE                     IOT_LIGHT_SCALE
+
+/* Tiers of the local thing: raw samples for 5 minutes at the 500 ms polling
+ * rate, 1 minute buckets for 24 hours and hourly buckets for a week */
+#define HISTORY_RAW_SAMPLES                     (600)
+#define HISTORY_MINUTE_BUCKETS                  (24 * 60)
+#define HISTORY_HOUR_BUCKETS                    (7 * 24)
+
+/* Tier of the other things, they only report every few seconds so they get
+ * hourly buckets for a day */
+#define HISTORY_REMOTE_HOUR_BUCKETS             (24)
+
+/* Maximum number of bucket tiers of a thing */
+#define HISTORY_MAX_TIERS                       (2)
+
+/* Bucket duration of the tiers */
+#define HISTORY_MINUTE_MS                       (60UL * 1000UL)
+#define HISTORY_HOUR_MS                         (60UL * 60UL * 1000UL)
+
+/***************************************
+*            Types
+****************************************/
+/* One sample in fixed point */
+typedef struct {
+    int16_t value[HISTORY_CHANNELS];
+} history_sample_t;
+
+/* Minimum, maximum and mean of the samples of one bucket. Buckets without
+ * samples (the thing didn't report) have min > max. */
+typedef struct {
+    int16_t min[HISTORY_CHANNELS];
+    int16_t max[HISTORY_CHANNELS];
+    int16_t mean[HISTORY_CHANNELS];
+} history_bucket_t;
+
+/* RAM taken by the history of all things */
+#define HISTORY_RAM_BYTES                       (((HISTORY_RAW_SAMPLES) * sizeof(history_sample_t)) + \
+                                                 ((HISTORY_MINUTE_BUCKETS + HISTORY_HOUR_BUCKETS + \
+                                                   (THING_COUNT * HISTORY_REMOTE_HOUR_BUCKETS)) * \
+                                                  sizeof(history_bucket_t)))
+
+/***************************************
+*      Function Declarations
+****************************************/
+void history_init(void);
+void history_append(uint8_t thingNumber, int16_t temp, int16_t humidity, int16_t light);
+uint16_t history_raw_count(uint8_t thingNumber);
+bool history_get_raw(uint8_t thingNumber, uint16_t age, history_sample_t *sample);
+uint8_t history_tier_count(uint8_t thingNumber);
+uint32_t history_tier_period_ms(uint8_t thingNumber, uint8_t tier);
+uint16_t history_bucket_count(uint8_t thingNumber, uint8_t tier);
+bool history_get_bucket(uint8_t thingNumber, uint8_t tier, uint16_t age, history_bucket_t *bucket);
+
+#endif /* SOURCE_HISTORY_OPERATION_H_ */
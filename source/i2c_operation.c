@@ -0,0 +1,336 @@
+/******************************************************************************
+* File Name: i2c_operation.c
+*
+* Description: This file contains the transfers on the I2C bus of the shield,
+* used by the AFE thread for the PSoC and by emWin for the OLED.
+*
+* With I2C_ASYNC a transfer is started with the HAL and the calling task
+* waits on a semaphore that the transfer complete interrupt gives, so other
+* tasks run while the bytes go out. The HAL drives the SCB FIFO from its
+* interrupt; it has no DMA for I2C.
+*
+* The bus is scheduled between its clients by priority. i2c_lock gives the
+* bus to a client right away if it is free, else the client waits until the
+* bus is handed to it. A free bus goes to the waiting client with the highest
+* priority. Before each transfer the client holding the bus hands it over if a
+* client with a higher priority waits, and waits to get it back, so a long
+* OLED update written in slices lets the CapSense poll in between slices.
+* Other devices are addressed between the slices, which is fine for the OLED
+* controller as it keeps its column address.
+*
+* How long each client waits for and holds the bus is measured with the cycle
+* counter.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include "cyhal.h"
+#include "cybsp.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "display_interface.h"
+#include "i2c_operation.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Interrupt priority of the transfer events, low enough to call the RTOS */
+#define I2C_EVENT_CALLBACK_PRIORITY             (3)
+
+/* Events that end a transfer */
+#define I2C_END_EVENTS                          (CYHAL_I2C_MASTER_WR_CMPLT_EVENT | \
+                                                 CYHAL_I2C_MASTER_RD_CMPLT_EVENT | \
+                                                 CYHAL_I2C_MASTER_ERR_EVENT)
+
+/***************************************
+*          Global Variables
+****************************************/
+static i2c_stats_t i2c_stats;
+
+/* Cycles of the CPU in a microsecond */
+static uint32_t cycles_per_us = 1;
+
+/* Client holding the bus and the clients waiting for it, one bit a client */
+static volatile uint8_t bus_owner = I2C_NO_CLIENT;
+static volatile uint32_t bus_waiting;
+
+/* Given to a waiting client when the bus is handed to it */
+static SemaphoreHandle_t client_grant[I2C_CLIENTS];
+#if STATIC_ALLOCATION
+static StaticSemaphore_t client_grant_buffer[I2C_CLIENTS];
+#endif
+
+/* Cycle count when a client asked for the bus and when it got it */
+static uint32_t request_cycles[I2C_CLIENTS];
+static uint32_t grant_cycles[I2C_CLIENTS];
+
+#if I2C_ASYNC
+/* Given by the interrupt at the end of a transfer */
+static SemaphoreHandle_t transfer_done;
+#if STATIC_ALLOCATION
+static StaticSemaphore_t transfer_done_buffer;
+#endif
+
+/* Event that ends the running transfer and whether it failed */
+static volatile cyhal_i2c_event_t transfer_end_event;
+static volatile bool transfer_failed;
+#endif
+
+/*************** Read Cycle Counter ***************/
+/*
+ * Summary: Read the cycle counter of the CPU.
+ *
+ *  @return The cycle count, it wraps every 2^32 cycles.
+ */
+static inline uint32_t read_cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+#if I2C_ASYNC
+/*************** I2C Event Callback ***************/
+/*
+ * Summary: Callback of the HAL at the end of a transfer, wakes the task
+ * waiting for it.
+ *
+ *  @param[in] callback_arg Not used.
+ *  @param[in] event Events that triggered the interrupt.
+ */
+static void i2c_event_callback(void *callback_arg, cyhal_i2c_event_t event)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    ( void )callback_arg; /* Suppress compiler warning */
+
+    /* A write before a read also reports the end of the write */
+    if((event & (transfer_end_event | CYHAL_I2C_MASTER_ERR_EVENT)) == 0)
+    {
+        return;
+    }
+
+    transfer_failed = ((event & CYHAL_I2C_MASTER_ERR_EVENT) != 0);
+    xSemaphoreGiveFromISR(transfer_done, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+#endif
+
+/*************** Initialize I2C Transfers ***************/
+/*
+ * Summary: Start the cycle counter and set up the scheduling of the bus and
+ * the transfer complete interrupt. Called once the I2C block is initialized.
+ */
+void i2c_init(void)
+{
+    uint8_t loop;
+
+    /* Cycle counter for the hold times */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    if(SystemCoreClock >= 1000000)
+    {
+        cycles_per_us = SystemCoreClock / 1000000;
+    }
+
+    for(loop = 0; loop < I2C_CLIENTS; loop++)
+    {
+#if STATIC_ALLOCATION
+        client_grant[loop] = xSemaphoreCreateBinaryStatic(&client_grant_buffer[loop]);
+#else
+        client_grant[loop] = xSemaphoreCreateBinary();
+#endif
+    }
+
+#if I2C_ASYNC
+#if STATIC_ALLOCATION
+    transfer_done = xSemaphoreCreateBinaryStatic(&transfer_done_buffer);
+#else
+    transfer_done = xSemaphoreCreateBinary();
+#endif
+
+    cyhal_i2c_register_callback(&afe_shield_i2c_obj, i2c_event_callback, NULL);
+    cyhal_i2c_enable_event(&afe_shield_i2c_obj,
+                           (cyhal_i2c_event_t)I2C_END_EVENTS,
+                           I2C_EVENT_CALLBACK_PRIORITY,
+                           true);
+#endif
+}
+
+/*************** Lock I2C Bus ***************/
+/*
+ * Summary: Take the bus for a sequence of transfers if it is free, else wait
+ * until it is handed over.
+ *
+ *  @param[in] client The client asking for the bus.
+ */
+void i2c_lock(i2c_client_t client)
+{
+    i2c_client_stats_t *stats = &i2c_stats.clients[client];
+    uint32_t wait_us;
+    uint32_t limit_us = I2C_WAIT_FIRST_LIMIT_US;
+    uint8_t bucket = 0;
+    bool granted;
+
+    request_cycles[client] = read_cycles();
+    taskENTER_CRITICAL();
+    granted = (bus_owner == I2C_NO_CLIENT);
+    if(granted)
+    {
+        bus_owner = client;
+    }
+    else
+    {
+        bus_waiting |= (1u << client);
+    }
+    taskEXIT_CRITICAL();
+
+    if(!granted)
+    {
+        xSemaphoreTake(client_grant[client], portMAX_DELAY);
+    }
+    grant_cycles[client] = read_cycles();
+
+    /* Only the client updates its own counts */
+    wait_us = (grant_cycles[client] - request_cycles[client]) / cycles_per_us;
+    while((bucket < (I2C_WAIT_BUCKETS - 1)) && (wait_us >= limit_us))
+    {
+        limit_us *= 10;
+        bucket++;
+    }
+    stats->grants++;
+    stats->wait_histogram[bucket]++;
+    if(wait_us > stats->wait_max_us)
+    {
+        stats->wait_max_us = wait_us;
+    }
+}
+
+/*************** Unlock I2C Bus ***************/
+/*
+ * Summary: Hand the bus to the waiting client with the highest priority, or
+ * free it.
+ *
+ *  @param[in] client The client holding the bus.
+ */
+void i2c_unlock(i2c_client_t client)
+{
+    i2c_client_stats_t *stats = &i2c_stats.clients[client];
+    uint32_t hold_us = (read_cycles() - grant_cycles[client]) / cycles_per_us;
+    uint8_t next = I2C_NO_CLIENT;
+
+    stats->hold_total_us += hold_us;
+    if(hold_us > stats->hold_max_us)
+    {
+        stats->hold_max_us = hold_us;
+    }
+
+    taskENTER_CRITICAL();
+    /* The AFE goes first, there are only two clients */
+    if((bus_waiting & (1u << I2C_CLIENT_AFE)) != 0)
+    {
+        next = I2C_CLIENT_AFE;
+    }
+    else if((bus_waiting & (1u << I2C_CLIENT_DISPLAY)) != 0)
+    {
+        next = I2C_CLIENT_DISPLAY;
+    }
+    if(next != I2C_NO_CLIENT)
+    {
+        bus_waiting &= ~(1u << next);
+    }
+    bus_owner = next;
+    taskEXIT_CRITICAL();
+
+    if(next != I2C_NO_CLIENT)
+    {
+        xSemaphoreGive(client_grant[next]);
+    }
+}
+
+/*************** I2C Transfer ***************/
+/*
+ * Summary: Write and then read a device on the bus, with a repeated start in
+ * between. Call it with the bus locked, or before other tasks use the bus.
+ * Before the transfer the bus may be handed to a client with a higher
+ * priority for a while.
+ *
+ *  @param[in] address Address of the device.
+ *  @param[in] tx Bytes to write, NULL if tx_size is 0.
+ *  @param[in] tx_size Number of bytes to write.
+ *  @param[out] rx Buffer of the bytes to read, NULL if rx_size is 0.
+ *  @param[in] rx_size Number of bytes to read.
+ *
+ *  @return true if the transfer completed.
+ */
+bool i2c_transfer(uint16_t address, const uint8_t *tx, uint16_t tx_size, uint8_t *rx, uint16_t rx_size)
+{
+    uint32_t start;
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    uint8_t client = bus_owner;
+    bool done;
+#if I2C_ASYNC
+    uint32_t timeout_ms;
+#endif
+
+    /* Between transactions, let a client with a higher priority go first */
+    if((client != I2C_NO_CLIENT) && ((bus_waiting & ((1u << client) - 1)) != 0))
+    {
+        i2c_stats.clients[client].preemptions++;
+        i2c_unlock((i2c_client_t)client);
+        i2c_lock((i2c_client_t)client);
+    }
+
+    start = read_cycles();
+#if I2C_ASYNC
+    transfer_end_event = (rx_size > 0) ? CYHAL_I2C_MASTER_RD_CMPLT_EVENT : CYHAL_I2C_MASTER_WR_CMPLT_EVENT;
+    transfer_failed = false;
+
+    /* Drop the end of a transfer that timed out */
+    xSemaphoreTake(transfer_done, 0);
+
+    result = cyhal_i2c_master_transfer_async(&afe_shield_i2c_obj, address, tx, tx_size, rx, rx_size);
+    done = (result == CY_RSLT_SUCCESS);
+    timeout_ms = I2C_TRANSFER_MARGIN_MS + ((tx_size + rx_size) / I2C_BYTES_PER_MS);
+    if(done && (xSemaphoreTake(transfer_done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE))
+    {
+        cyhal_i2c_abort_async(&afe_shield_i2c_obj);
+        i2c_stats.timeouts++;
+        done = false;
+    }
+    done = done && !transfer_failed;
+#else
+    if(tx_size > 0)
+    {
+        result = cyhal_i2c_master_write(&afe_shield_i2c_obj, address, tx, tx_size, 0, (rx_size == 0));
+    }
+    if((result == CY_RSLT_SUCCESS) && (rx_size > 0))
+    {
+        result = cyhal_i2c_master_read(&afe_shield_i2c_obj, address, rx, rx_size, 0, true);
+    }
+    done = (result == CY_RSLT_SUCCESS);
+#endif
+
+    /* Transfers are made with the bus locked, so the counts need no lock */
+    i2c_stats.transfers++;
+    i2c_stats.transfer_total_us += (read_cycles() - start) / cycles_per_us;
+    if(!done)
+    {
+        i2c_stats.failures++;
+    }
+
+    return done;
+}
+
+/*************** Get I2C Statistics ***************/
+/*
+ * Summary: Copy the usage of the I2C bus.
+ *
+ *  @param[out] stats The usage of the bus.
+ */
+void i2c_get_stats(i2c_stats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = i2c_stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+* File Name: i2c_operation.h
+*
+* Description: This file contains declarations related to the transfers on the
+* I2C bus of the shield and the scheduling of the bus between its clients.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_I2C_OPERATION_H_
+#define SOURCE_I2C_OPERATION_H_
+
+#include "common_resource.h"
+
+/***************************************
+*            Defines
+****************************************/
+/*
+ * Set to 0 (DEFINES=I2C_ASYNC=0 in the Makefile) to make the transfers with
+ * the blocking HAL functions, which keep the calling task busy until the last
+ * byte is on the bus. With 1 the task waits on the transfer complete
+ * interrupt and the CPU goes to other tasks meanwhile.
+ */
+#ifndef I2C_ASYNC
+#define I2C_ASYNC                               1
+#endif
+
+/* A transfer times out after its time on the bus, with 9 clocks a byte at
+ * 400 kHz, and a margin */
+#define I2C_BYTES_PER_MS                        (40)
+#define I2C_TRANSFER_MARGIN_MS                  (10)
+
+/* Wait times of the histograms: below 100 us, 1 ms, 10 ms, 100 ms and longer */
+#define I2C_WAIT_BUCKETS                        (5)
+#define I2C_WAIT_FIRST_LIMIT_US                 (100)
+
+/* No client has the bus */
+#define I2C_NO_CLIENT                           (0xFF)
+
+/***************************************
+*            Types
+****************************************/
+/* Clients of the bus, in order of priority, the first is the highest.
+ * i2c_unlock() checks them one by one. */
+typedef enum {
+    I2C_CLIENT_AFE,                             /* CapSense and weather data, polled every 100 ms */
+    I2C_CLIENT_DISPLAY,                         /* OLED updates through emWin */
+    I2C_CLIENTS
+} i2c_client_t;
+
+/* Usage of the bus by a client, times in microseconds */
+typedef struct {
+    uint32_t grants;                            /* Times the client got the bus */
+    uint32_t hold_total_us;
+    uint32_t hold_max_us;
+    uint32_t preemptions;                       /* Times it gave the bus to a client with a higher priority */
+    uint32_t wait_max_us;
+    uint32_t wait_histogram[I2C_WAIT_BUCKETS];  /* Grants by the time waited for the bus */
+} i2c_client_stats_t;
+
+/* Usage of the I2C bus, times in microseconds */
+typedef struct {
+    uint32_t transfers;
+    uint32_t transfer_total_us;                 /* Time from start to end of the transfers */
+    uint32_t failures;                          /* Transfers that didn't complete, timeouts included */
+    uint32_t timeouts;
+    i2c_client_stats_t clients[I2C_CLIENTS];
+} i2c_stats_t;
+
+/***************************************
+*      Function Declarations
+****************************************/
+void i2c_init(void);
+void i2c_lock(i2c_client_t client);
+void i2c_unlock(i2c_client_t client);
+bool i2c_transfer(uint16_t address, const uint8_t *tx, uint16_t tx_size, uint8_t *rx, uint16_t rx_size);
+void i2c_get_stats(i2c_stats_t *stats);
+
+#endif /* SOURCE_I2C_OPERATION_H_ */
@@ -0,0 +1,378 @@
+/******************************************************************************
+* File Name: kv_operation.c
+*
+* Description: This file contains the key-value store in flash and the state
+* that is kept in it, so the station starts with the last known data of all
+* things after a reset. The log of records is in kv_store_operation.c, this
+* file gives it the flash rows through the HAL and serializes the threads
+* that use it.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <string.h>
+#include "cyhal.h"
+#include "cybsp.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "kv_operation.h"
+#include "fleet_operation.h"
+#include "notify_operation.h"
+#include "filter_operation.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Save the state at most this often while things change */
+#define KV_SAVE_PERIOD_MS                       (10 * 60 * 1000)
+
+_Static_assert(KV_ROW_SIZE == CY_FLASH_SIZEOF_ROW, "A row of the store has to be a flash row");
+
+/***************************************
+*            Types
+****************************************/
+/* Settings saved under KV_KEY_CONFIG */
+typedef struct {
+    uint8_t disp_thing;
+    uint8_t disp_fleet;
+    uint8_t print_all;
+    uint8_t reserved;
+} kv_config_t;
+
+/* Thing data saved under KV_KEY_FLEET, it has to fit in KV_MAX_VALUE */
+typedef struct {
+    uint32_t reporting[THING_BITSET_WORDS];     /* Things with data */
+    iot_fleet_t fleet;
+} kv_fleet_snapshot_t;
+
+_Static_assert(sizeof(kv_fleet_snapshot_t) <= KV_MAX_VALUE,
+               "The thing data of MAX_THING things doesn't fit in a record of the store");
+
+/***************************************
+*          Global Variables
+****************************************/
+/* Flash of the store */
+CY_SECTION(".cy_em_eeprom") CY_ALIGN(KV_ROW_SIZE)
+static const uint8_t kv_flash[KV_ROWS * KV_ROW_SIZE] = { 0 };
+
+static cyhal_flash_t flash_obj;
+
+static SemaphoreHandle_t kv_mutex;
+#if STATIC_ALLOCATION
+static StaticSemaphore_t kv_mutex_buffer;
+#endif
+
+/* Snapshot of the thing data, static as it is too large for a stack. Saving
+ * fills it with kv_mutex taken, restoring before the threads start. */
+static kv_fleet_snapshot_t snapshot;
+
+/*************** Row Address ***************/
+/*
+ * Summary: Flash address of a row.
+ *
+ *  @param[in] row The row.
+ *
+ *  @return The address.
+ */
+static uint32_t row_address(uint8_t row)
+{
+    return (uint32_t)(uintptr_t)&kv_flash[row * KV_ROW_SIZE];
+}
+
+/*************** Flash Read ***************/
+/*
+ * Summary: Read from a row of the store.
+ *
+ *  @param[in] row The row.
+ *  @param[in] offset Offset in the row.
+ *  @param[out] data Buffer for the bytes.
+ *  @param[in] length Number of bytes.
+ *
+ *  @return false if the read failed.
+ */
+static bool flash_read(uint8_t row, uint16_t offset, void *data, uint16_t length)
+{
+    return (cyhal_flash_read(&flash_obj, row_address(row) + offset, (uint8_t *)data, length) == CY_RSLT_SUCCESS);
+}
+
+/*************** Flash Write ***************/
+/*
+ * Summary: Write a whole row of the store, the HAL erases it first.
+ *
+ *  @param[in] row The row.
+ *  @param[in] data KV_ROW_SIZE bytes for the row.
+ *
+ *  @return false if the write failed.
+ */
+static bool flash_write(uint8_t row, const uint32_t *data)
+{
+    return (cyhal_flash_write(&flash_obj, row_address(row), data) == CY_RSLT_SUCCESS);
+}
+
+/*************** Flash Erase ***************/
+/*
+ * Summary: Erase a row of the store.
+ *
+ *  @param[in] row The row.
+ *
+ *  @return false if the erase failed.
+ */
+static bool flash_erase(uint8_t row)
+{
+    return (cyhal_flash_erase(&flash_obj, row_address(row)) == CY_RSLT_SUCCESS);
+}
+
+/* Rows of the store for the log of records */
+static const kv_flash_ops_t kv_flash_ops = { flash_read, flash_write, flash_erase };
+
+/*************** Initialize Store ***************/
+/*
+ * Summary: Open the flash and find the current record of each key. Call it
+ * before any other function of the store.
+ *
+ *  @return false if the flash couldn't be opened.
+ */
+bool kv_init(void)
+{
+#if STATIC_ALLOCATION
+    kv_mutex = xSemaphoreCreateMutexStatic(&kv_mutex_buffer);
+#else
+    kv_mutex = xSemaphoreCreateMutex();
+#endif
+
+    if(cyhal_flash_init(&flash_obj) != CY_RSLT_SUCCESS)
+    {
+        return false;
+    }
+    kv_store_init(&kv_flash_ops);
+    return true;
+}
+
+/*************** Set Value ***************/
+/*
+ * Summary: Store the value of a key. The value is kept in RAM until the next
+ * commit, it is then written to flash with the other new values.
+ *
+ *  @param[in] key The key, 1 to KV_MAX_KEYS.
+ *  @param[in] value The value.
+ *  @param[in] length Length of the value, at most KV_MAX_VALUE.
+ *
+ *  @return false if the key or length is invalid or the store is full.
+ */
+bool kv_set(uint16_t key, const void *value, uint16_t length)
+{
+    bool result;
+
+    xSemaphoreTake(kv_mutex, portMAX_DELAY);
+    result = kv_store_set(key, value, length);
+    xSemaphoreGive(kv_mutex);
+    return result;
+}
+
+/*************** Get Value ***************/
+/*
+ * Summary: Read the value of a key.
+ *
+ *  @param[in] key The key.
+ *  @param[out] value Buffer for the value.
+ *  @param[in] size Size of the buffer, a longer value is cut short.
+ *
+ *  @return The length of the value, -1 if the key has no value.
+ */
+int32_t kv_get(uint16_t key, void *value, uint16_t size)
+{
+    int32_t result;
+
+    xSemaphoreTake(kv_mutex, portMAX_DELAY);
+    result = kv_store_get(key, value, size);
+    xSemaphoreGive(kv_mutex);
+    return result;
+}
+
+/*************** Delete Value ***************/
+/*
+ * Summary: Remove the value of a key.
+ *
+ *  @param[in] key The key.
+ *
+ *  @return false if the key is invalid or the store is full.
+ */
+bool kv_delete(uint16_t key)
+{
+    bool result;
+
+    xSemaphoreTake(kv_mutex, portMAX_DELAY);
+    result = kv_store_delete(key);
+    xSemaphoreGive(kv_mutex);
+    return result;
+}
+
+/*************** Commit Values ***************/
+/*
+ * Summary: Write the values set since the last commit to flash. Every commit
+ * uses a row, so commit once after a batch of changes.
+ *
+ *  @return false if the store is full or the flash write failed.
+ */
+bool kv_commit(void)
+{
+    bool result;
+
+    xSemaphoreTake(kv_mutex, portMAX_DELAY);
+    result = kv_store_commit();
+    xSemaphoreGive(kv_mutex);
+    return result;
+}
+
+/*************** Store Statistics ***************/
+/*
+ * Summary: Read the usage of the store.
+ *
+ *  @param[out] stats The usage.
+ */
+void kv_get_stats(kv_stats_t *stats)
+{
+    xSemaphoreTake(kv_mutex, portMAX_DELAY);
+    kv_store_get_stats(stats);
+    xSemaphoreGive(kv_mutex);
+}
+
+/*************** Restore State ***************/
+/*
+ * Summary: Load the settings and the data of all things saved before the
+ * reset. Call it after the thing data and fleet aggregates are initialized
+ * and before the threads are started. Values saved by a build with another
+ * layout are ignored.
+ */
+void kv_restore_state(void)
+{
+    kv_config_t config;
+    filter_config_t filters[IOT_CHANNELS];
+    iot_data_t thing;
+    uint8_t loop;
+
+    if((kv_get(KV_KEY_CONFIG, &config, sizeof(config)) == sizeof(config)) &&
+       (config.disp_thing <= MAX_THING))
+    {
+        disp_thing = config.disp_thing;
+        disp_fleet = (config.disp_fleet != 0);
+        print_all = (config.print_all != 0);
+    }
+
+    /* Settings that are not valid any more keep the defaults */
+    if(kv_get(KV_KEY_FILTER, filters, sizeof(filters)) == sizeof(filters))
+    {
+        for(loop = 0; loop < IOT_CHANNELS; loop++)
+        {
+            ( void )filter_set_config(loop, &filters[loop]);
+        }
+    }
+
+    if(kv_get(KV_KEY_FLEET, &snapshot, sizeof(snapshot)) != sizeof(snapshot))
+    {
+        return;
+    }
+    for(loop = 0; loop <= MAX_THING; loop++)
+    {
+        if((snapshot.reporting[THING_WORD(loop)] & THING_BIT(loop)) == 0)
+        {
+            continue;
+        }
+        thing.thingNumber = loop;
+        thing.alert = ((snapshot.fleet.alert[THING_WORD(loop)] & THING_BIT(loop)) != 0);
+        thing.temp = snapshot.fleet.temp[loop];
+        thing.humidity = snapshot.fleet.humidity[loop];
+        thing.light = snapshot.fleet.light[loop];
+        thing.ip = snapshot.fleet.ip[loop];
+        iot_data_write_begin(loop);
+        iot_data_store(loop, &thing);
+        iot_data_write_end(loop);
+    }
+}
+
+/*************** Save State ***************/
+/*
+ * Summary: Save the settings and the data of all things to flash. The
+ * snapshot is filled and committed under one lock, so saves from the Persist
+ * thread and the console don't mix their records.
+ *
+ *  @return false if the store is full or the flash write failed.
+ */
+bool kv_save_state(void)
+{
+    kv_config_t config;
+    filter_config_t filters[IOT_CHANNELS];
+    iot_data_t thing;
+    uint8_t loop;
+    bool result;
+
+    config.disp_thing = disp_thing;
+    config.disp_fleet = disp_fleet ? 1 : 0;
+    config.print_all = print_all ? 1 : 0;
+    config.reserved = 0;
+    for(loop = 0; loop < IOT_CHANNELS; loop++)
+    {
+        filter_get_config(loop, &filters[loop]);
+    }
+
+    xSemaphoreTake(kv_mutex, portMAX_DELAY);
+    memset(&snapshot, 0, sizeof(snapshot));
+    for(loop = 0; loop <= MAX_THING; loop++)
+    {
+        if(!fleet_is_reporting(loop))
+        {
+            continue;
+        }
+        iot_data_snapshot(loop, &thing);
+        snapshot.reporting[THING_WORD(loop)] |= THING_BIT(loop);
+        if(thing.alert)
+        {
+            snapshot.fleet.alert[THING_WORD(loop)] |= THING_BIT(loop);
+        }
+        snapshot.fleet.temp[loop] = thing.temp;
+        snapshot.fleet.humidity[loop] = thing.humidity;
+        snapshot.fleet.light[loop] = thing.light;
+        snapshot.fleet.ip[loop] = thing.ip;
+    }
+
+    result = kv_store_set(KV_KEY_CONFIG, &config, sizeof(config)) &&
+             kv_store_set(KV_KEY_FILTER, filters, sizeof(filters)) &&
+             kv_store_set(KV_KEY_FLEET, &snapshot, sizeof(snapshot)) &&
+             kv_store_commit();
+    xSemaphoreGive(kv_mutex);
+    return result;
+}
+
+/*************** Persist Thread ***************/
+/*
+ * Summary: Thread to save the state to flash a while after it changed. The
+ * changes of one period are saved together to spare the flash.
+ *
+ *  @param[in] arg argument for the thread
+ *
+ */
+void persistThread(void* arg)
+{
+    ( void )arg; /* Suppress compiler warning */
+
+    notify_changes_t changes;
+    int8_t subscriber = notify_subscribe(NOTIFY_ALL_FIELDS);
+    configASSERT(subscriber >= 0);
+
+    while(1)
+    {
+        /* Wait for a change, then give the others of the period time to come in */
+        notify_wait(subscriber, &changes, portMAX_DELAY);
+        if(changes.fields == 0)
+        {
+            continue;
+        }
+        vTaskDelay(pdMS_TO_TICKS(KV_SAVE_PERIOD_MS));
+
+        if(!kv_save_state())
+        {
+            configPRINTF(("Failed to save the state to flash\r\n"));
+        }
+    }
+}
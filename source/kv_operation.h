@@ -0,0 +1,40 @@
+/******************************************************************************
+* File Name: kv_operation.h
+*
+* Description: This file contains declarations related to the key-value store
+* in flash and the state kept in it across resets.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_KV_OPERATION_H_
+#define SOURCE_KV_OPERATION_H_
+
+#include "common_resource.h"
+#include "kv_store_operation.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Keys of the application */
+#define KV_KEY_CONFIG                           (1)     /* Settings of the console and display */
+#define KV_KEY_FLEET                            (2)     /* Last known data of all things */
+#define KV_KEY_FILTER                           (3)     /* Filters of the weather data */
+
+/***************************************
+*      Function Declarations
+****************************************/
+/* Key-value store */
+bool kv_init(void);
+bool kv_set(uint16_t key, const void *value, uint16_t length);
+int32_t kv_get(uint16_t key, void *value, uint16_t size);
+bool kv_delete(uint16_t key);
+bool kv_commit(void);
+void kv_get_stats(kv_stats_t *stats);
+
+/* State kept across resets */
+void kv_restore_state(void);
+bool kv_save_state(void);
+void persistThread(void* arg);
+
+#endif /* SOURCE_KV_OPERATION_H_ */
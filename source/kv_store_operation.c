@@ -0,0 +1,623 @@
+/******************************************************************************
+* File Name: kv_store_operation.c
+*
+* Description: This file contains the log of records of the key-value store.
+*
+* The store is a log of records over a ring of flash rows. New records are
+* collected in a row buffer in RAM and a commit programs the buffer into the
+* next free row, so every row is programmed once per pass around the ring and
+* the rows wear evenly. When only one free row is left the oldest row is
+* compacted: its records that are still current are copied into the free row
+* and it is rewritten as an empty row. Empty rows keep their erase count in
+* their header, so the wear of the rows is known across resets. Rows and
+* records carry a CRC, so a row or a record that was cut short by a reset is
+* ignored.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <string.h>
+#include "kv_store_operation.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Marks a row of the log and an empty row */
+#define KV_ROW_MAGIC                            (0x4B565331UL)  /* "KVS1" */
+#define KV_FREE_MAGIC                           (0x4B564645UL)  /* "KVFE" */
+
+/* Record length of a deleted key */
+#define KV_DELETED                              (0xFFFF)
+
+/* Location of a record that isn't in flash yet, and of a missing key */
+#define KV_PENDING_ROW                          (0xFF)
+#define KV_NO_ROW                               (0xFE)
+
+/* Space taken by a record with a value of the given length */
+#define KV_RECORD_SIZE(length)                  (sizeof(kv_record_header_t) + (((length) + 3u) & ~3u))
+
+/***************************************
+*            Types
+****************************************/
+/* Start of a row */
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;                          /* Order of the rows, higher is newer, 0 if empty */
+    uint32_t erases;                            /* Times the row was erased */
+    uint32_t crc;                               /* CRC of the fields above */
+} kv_row_header_t;
+
+/* Start of a record, followed by the value padded to 4 bytes. A record with
+ * key 0 or 0xFFFF ends the row. */
+typedef struct {
+    uint16_t key;
+    uint16_t length;                            /* KV_DELETED for a deleted key */
+    uint32_t crc;                               /* CRC of key, length and value */
+} kv_record_header_t;
+
+/* Where the current record of a key is */
+typedef struct {
+    uint8_t row;                                /* KV_PENDING_ROW, KV_NO_ROW or the row */
+    uint16_t offset;                            /* Offset of the record in the row */
+    uint16_t length;
+} kv_location_t;
+
+/***************************************
+*          Global Variables
+****************************************/
+/* Flash of the store */
+static const kv_flash_ops_t *flash;
+
+/* Records not committed yet, and a row being compacted */
+static uint32_t pending_row[KV_ROW_SIZE / sizeof(uint32_t)];
+static uint16_t pending_used;
+static uint32_t compact_row[KV_ROW_SIZE / sizeof(uint32_t)];
+
+/* Ring of rows: used rows from tail on, the others are empty */
+static uint8_t tail;
+static uint8_t used;
+static uint32_t sequence;
+static uint32_t row_erases[KV_ROWS];
+
+/* Where the current record of each key is, and where its last record in
+ * flash is, the one a reset finds */
+static kv_location_t locations[KV_MAX_KEYS + 1];
+static kv_location_t flash_locations[KV_MAX_KEYS + 1];
+
+/*************** CRC-32 ***************/
+/*
+ * Summary: Continue a CRC-32 (IEEE 802.3) over a block of data. The bitwise
+ * form is used as it needs no table and records are short.
+ *
+ *  @param[in] crc The CRC so far, 0 to start.
+ *  @param[in] data The data.
+ *  @param[in] length Length of the data.
+ *
+ *  @return The CRC including the data.
+ */
+static uint32_t crc32(uint32_t crc, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint8_t bit;
+
+    crc = ~crc;
+    while(length-- > 0)
+    {
+        crc ^= *bytes++;
+        for(bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1UL)));
+        }
+    }
+    return ~crc;
+}
+
+/*************** Record CRC ***************/
+/*
+ * Summary: CRC of a record.
+ *
+ *  @param[in] header The record header, its crc isn't included.
+ *  @param[in] value The value.
+ *
+ *  @return The CRC.
+ */
+static uint32_t record_crc(const kv_record_header_t *header, const void *value)
+{
+    uint32_t crc = crc32(0, &header->key, sizeof(header->key));
+
+    crc = crc32(crc, &header->length, sizeof(header->length));
+    return crc32(crc, value, (header->length == KV_DELETED) ? 0 : header->length);
+}
+
+/*************** Append Record ***************/
+/*
+ * Summary: Add a record to a row buffer.
+ *
+ *  @param[in] row The row buffer.
+ *  @param[in] offset Where the record goes, there has to be room for it.
+ *  @param[in] key The key.
+ *  @param[in] value The value.
+ *  @param[in] length Length of the value or KV_DELETED.
+ */
+static void append_record(uint32_t *row, uint16_t offset, uint16_t key, const void *value, uint16_t length)
+{
+    uint8_t *bytes = (uint8_t *)row;
+    kv_record_header_t header;
+
+    header.key = key;
+    header.length = length;
+    header.crc = record_crc(&header, value);
+    memcpy(&bytes[offset], &header, sizeof(header));
+    if(length != KV_DELETED)
+    {
+        memcpy(&bytes[offset + sizeof(header)], value, length);
+    }
+}
+
+/*************** Write Row ***************/
+/*
+ * Summary: Fill in the header of a row buffer and write it to a row. The
+ * rest of the buffer after the records has to be zero.
+ *
+ *  @param[in] row The row.
+ *  @param[in] buffer The row buffer.
+ *  @param[in] magic KV_ROW_MAGIC for a row of the log, KV_FREE_MAGIC for an
+ *  empty row.
+ *
+ *  @return false if the flash write failed.
+ */
+static bool write_row(uint8_t row, uint32_t *buffer, uint32_t magic)
+{
+    kv_row_header_t header;
+
+    header.magic = magic;
+    header.sequence = (magic == KV_ROW_MAGIC) ? ++sequence : 0;
+    header.erases = ++row_erases[row];      /* The write erases the row first */
+    header.crc = crc32(0, &header, offsetof(kv_row_header_t, crc));
+    memcpy(buffer, &header, sizeof(header));
+
+    return flash->write(row, buffer);
+}
+
+/*************** Program Row ***************/
+/*
+ * Summary: Write a row buffer into the next free row of the ring.
+ *
+ *  @param[in] buffer The row buffer.
+ *
+ *  @return The row written to, KV_NO_ROW if the flash write failed.
+ */
+static uint8_t program_row(uint32_t *buffer)
+{
+    uint8_t next = (uint8_t)((tail + used) % KV_ROWS);
+
+    if(!write_row(next, buffer, KV_ROW_MAGIC))
+    {
+        return KV_NO_ROW;
+    }
+    used++;
+    return next;
+}
+
+/*************** Free Tail Row ***************/
+/*
+ * Summary: Take the oldest row out of the ring and empty it. Its records
+ * can't come back after a reset, which matters for deleted keys.
+ */
+static void free_tail(void)
+{
+    memset(compact_row, 0, sizeof(compact_row));
+    if(!write_row(tail, compact_row, KV_FREE_MAGIC))
+    {
+        ( void )flash->erase(tail);
+    }
+    tail = (uint8_t)((tail + 1) % KV_ROWS);
+    used--;
+}
+
+/*************** Compact Tail Row ***************/
+/*
+ * Summary: Copy the records of the oldest row that are the last ones of
+ * their key in flash into the free row and empty the oldest row. A record
+ * replaced by one that isn't committed yet is copied too, the commit can
+ * still fail. Deleted keys are dropped, there are no older records they have
+ * to hide.
+ *
+ *  @return false if the flash read or write failed.
+ */
+static bool compact_tail(void)
+{
+    uint8_t *bytes = (uint8_t *)compact_row;
+    uint16_t offset = sizeof(kv_row_header_t);
+    uint16_t moved[KV_MAX_KEYS + 1];
+    uint8_t row;
+    uint16_t key;
+
+    memset(compact_row, 0, sizeof(compact_row));
+    for(key = 1; key <= KV_MAX_KEYS; key++)
+    {
+        moved[key] = 0;
+        if(flash_locations[key].row != tail)
+        {
+            continue;
+        }
+        if(flash_locations[key].length == KV_DELETED)
+        {
+            continue;
+        }
+        if(!flash->read(tail, flash_locations[key].offset, &bytes[offset], KV_RECORD_SIZE(flash_locations[key].length)))
+        {
+            return false;
+        }
+        moved[key] = offset;
+        offset += KV_RECORD_SIZE(flash_locations[key].length);
+    }
+
+    if(offset > sizeof(kv_row_header_t))
+    {
+        row = program_row(compact_row);
+        if(row == KV_NO_ROW)
+        {
+            return false;
+        }
+        for(key = 1; key <= KV_MAX_KEYS; key++)
+        {
+            if(moved[key] != 0)
+            {
+                flash_locations[key].row = row;
+                flash_locations[key].offset = moved[key];
+            }
+        }
+    }
+    for(key = 1; key <= KV_MAX_KEYS; key++)
+    {
+        if(flash_locations[key].row == tail)
+        {
+            flash_locations[key].row = KV_NO_ROW;
+        }
+        if(locations[key].row == tail)
+        {
+            locations[key] = flash_locations[key];
+        }
+    }
+    free_tail();
+    return true;
+}
+
+/*************** Commit Records ***************/
+/*
+ * Summary: Program the records in the row buffer into flash.
+ *
+ *  @return false if the store is full or the flash write failed.
+ */
+static bool commit_pending(void)
+{
+    uint8_t attempts;
+    uint8_t row;
+    uint16_t key;
+
+    if(pending_used == sizeof(kv_row_header_t))
+    {
+        return true;
+    }
+
+    /* Keep a free row for compaction, give up if no row has old records */
+    for(attempts = 0; (KV_ROWS - used) < 2; attempts++)
+    {
+        if((attempts >= KV_ROWS) || !compact_tail())
+        {
+            return false;
+        }
+    }
+
+    row = program_row(pending_row);
+    if(row == KV_NO_ROW)
+    {
+        return false;
+    }
+    for(key = 1; key <= KV_MAX_KEYS; key++)
+    {
+        if(locations[key].row == KV_PENDING_ROW)
+        {
+            locations[key].row = row;
+            flash_locations[key] = locations[key];
+        }
+    }
+    memset(pending_row, 0, sizeof(pending_row));
+    pending_used = sizeof(kv_row_header_t);
+    return true;
+}
+
+/*************** Add Record ***************/
+/*
+ * Summary: Add a record to the row buffer, committing the buffer first if
+ * the record doesn't fit.
+ *
+ *  @param[in] key The key.
+ *  @param[in] value The value.
+ *  @param[in] length Length of the value or KV_DELETED.
+ *
+ *  @return false if the key or length is invalid or the commit failed.
+ */
+static bool add_record(uint16_t key, const void *value, uint16_t length)
+{
+    uint16_t size = KV_RECORD_SIZE((length == KV_DELETED) ? 0 : length);
+
+    if((key == 0) || (key > KV_MAX_KEYS) || ((length != KV_DELETED) && (length > KV_MAX_VALUE)))
+    {
+        return false;
+    }
+
+    if(((pending_used + size) > KV_ROW_SIZE) && !commit_pending())
+    {
+        return false;
+    }
+    append_record(pending_row, pending_used, key, value, length);
+    locations[key].row = KV_PENDING_ROW;
+    locations[key].offset = pending_used;
+    locations[key].length = length;
+    pending_used += size;
+    return true;
+}
+
+/*************** Replay Row ***************/
+/*
+ * Summary: Read the records of a row into the key locations. The records
+ * after one with a bad CRC are ignored.
+ *
+ *  @param[in] row The row.
+ */
+static void replay_row(uint8_t row)
+{
+    const uint8_t *bytes = (const uint8_t *)compact_row;
+    kv_record_header_t header;
+    uint16_t offset = sizeof(kv_row_header_t);
+    uint16_t length;
+
+    if(!flash->read(row, 0, compact_row, KV_ROW_SIZE))
+    {
+        return;
+    }
+    while((offset + sizeof(header)) <= KV_ROW_SIZE)
+    {
+        memcpy(&header, &bytes[offset], sizeof(header));
+        if((header.key == 0) || (header.key == 0xFFFF))
+        {
+            break;
+        }
+        length = (header.length == KV_DELETED) ? 0 : header.length;
+        if(((offset + KV_RECORD_SIZE(length)) > KV_ROW_SIZE) ||
+           (header.crc != record_crc(&header, &bytes[offset + sizeof(header)])))
+        {
+            break;
+        }
+        if(header.key <= KV_MAX_KEYS)
+        {
+            locations[header.key].row = row;
+            locations[header.key].offset = offset;
+            locations[header.key].length = header.length;
+            flash_locations[header.key] = locations[header.key];
+        }
+        offset += KV_RECORD_SIZE(length);
+    }
+}
+
+/*************** Initialize Store ***************/
+/*
+ * Summary: Find the rows of the store and the current record of each key.
+ * Call it before any other function of the store.
+ *
+ *  @param[in] ops Access to the flash rows, it has to stay valid.
+ */
+void kv_store_init(const kv_flash_ops_t *ops)
+{
+    kv_row_header_t header;
+    uint32_t row_sequence[KV_ROWS];
+    uint32_t newest = 0;
+    uint32_t oldest = 0;
+    uint32_t last;
+    uint8_t valid = 0;
+    uint8_t head = 0;
+    uint8_t row;
+    uint8_t next;
+
+    flash = ops;
+    memset(pending_row, 0, sizeof(pending_row));
+    pending_used = sizeof(kv_row_header_t);
+    for(row = 0; row <= KV_MAX_KEYS; row++)
+    {
+        locations[row].row = KV_NO_ROW;
+        flash_locations[row].row = KV_NO_ROW;
+    }
+    tail = 0;
+    used = 0;
+    sequence = 0;
+
+    /* Headers tell which rows are in use and their order */
+    for(row = 0; row < KV_ROWS; row++)
+    {
+        row_sequence[row] = 0;
+        row_erases[row] = 0;
+        if(!flash->read(row, 0, &header, sizeof(header)) ||
+           ((header.magic != KV_ROW_MAGIC) && (header.magic != KV_FREE_MAGIC)) ||
+           (header.crc != crc32(0, &header, offsetof(kv_row_header_t, crc))))
+        {
+            continue;
+        }
+        row_erases[row] = header.erases;
+        if((header.magic == KV_FREE_MAGIC) || (header.sequence == 0))
+        {
+            continue;
+        }
+        row_sequence[row] = header.sequence;
+        if((valid == 0) || (header.sequence < oldest))
+        {
+            oldest = header.sequence;
+            tail = row;
+        }
+        if((valid == 0) || (header.sequence > newest))
+        {
+            newest = header.sequence;
+            head = row;
+        }
+        valid++;
+    }
+    if(valid == 0)
+    {
+        return;
+    }
+
+    /* The rows from tail to head are the log. The ring is only full while the
+     * tail is compacted, the newest row then holds copies of the records of
+     * the tail that may be cut short: empty it, the tail still has them. */
+    sequence = newest;
+    used = (uint8_t)(((head + KV_ROWS - tail) % KV_ROWS) + 1);
+    if(used == KV_ROWS)
+    {
+        memset(compact_row, 0, sizeof(compact_row));
+        if(!write_row(head, compact_row, KV_FREE_MAGIC))
+        {
+            ( void )flash->erase(head);
+        }
+        row_sequence[head] = 0;
+        valid--;
+        used--;
+    }
+
+    /* Replay the log from oldest to newest */
+    for(last = 0, next = 0; next < valid; next++)
+    {
+        /* The row with the lowest sequence after the last one replayed */
+        row = KV_NO_ROW;
+        for(head = 0; head < KV_ROWS; head++)
+        {
+            if((row_sequence[head] > last) &&
+               ((row == KV_NO_ROW) || (row_sequence[head] < row_sequence[row])))
+            {
+                row = head;
+            }
+        }
+        replay_row(row);
+        last = row_sequence[row];
+    }
+}
+
+/*************** Set Value ***************/
+/*
+ * Summary: Store the value of a key. The value is kept in RAM until the next
+ * commit, it is then written to flash with the other new values.
+ *
+ *  @param[in] key The key, 1 to KV_MAX_KEYS.
+ *  @param[in] value The value.
+ *  @param[in] length Length of the value, at most KV_MAX_VALUE.
+ *
+ *  @return false if the key or length is invalid or the store is full.
+ */
+bool kv_store_set(uint16_t key, const void *value, uint16_t length)
+{
+    return add_record(key, value, length);
+}
+
+/*************** Get Value ***************/
+/*
+ * Summary: Read the value of a key.
+ *
+ *  @param[in] key The key.
+ *  @param[out] value Buffer for the value.
+ *  @param[in] size Size of the buffer, a longer value is cut short.
+ *
+ *  @return The length of the value, -1 if the key has no value.
+ */
+int32_t kv_store_get(uint16_t key, void *value, uint16_t size)
+{
+    kv_location_t location;
+    int32_t result = -1;
+
+    if((key == 0) || (key > KV_MAX_KEYS))
+    {
+        return -1;
+    }
+
+    location = locations[key];
+    if((location.row != KV_NO_ROW) && (location.length != KV_DELETED))
+    {
+        if(size > location.length)
+        {
+            size = location.length;
+        }
+        if(location.row == KV_PENDING_ROW)
+        {
+            memcpy(value, (uint8_t *)pending_row + location.offset + sizeof(kv_record_header_t), size);
+        }
+        else
+        {
+            if(!flash->read(location.row, (uint16_t)(location.offset + sizeof(kv_record_header_t)), value, size))
+            {
+                return -1;
+            }
+        }
+        result = location.length;
+    }
+    return result;
+}
+
+/*************** Delete Value ***************/
+/*
+ * Summary: Remove the value of a key.
+ *
+ *  @param[in] key The key.
+ *
+ *  @return false if the key is invalid or the store is full.
+ */
+bool kv_store_delete(uint16_t key)
+{
+    return add_record(key, NULL, KV_DELETED);
+}
+
+/*************** Commit Values ***************/
+/*
+ * Summary: Write the values set since the last commit to flash. Every commit
+ * uses a row, so commit once after a batch of changes.
+ *
+ *  @return false if the store is full or the flash write failed.
+ */
+bool kv_store_commit(void)
+{
+    return commit_pending();
+}
+
+/*************** Store Statistics ***************/
+/*
+ * Summary: Read the usage of the store.
+ *
+ *  @param[out] stats The usage.
+ */
+void kv_store_get_stats(kv_stats_t *stats)
+{
+    uint8_t loop;
+
+    stats->rows = KV_ROWS;
+    stats->rows_used = used;
+    stats->pending = (uint16_t)(pending_used - sizeof(kv_row_header_t));
+    stats->keys = 0;
+    for(loop = 1; loop <= KV_MAX_KEYS; loop++)
+    {
+        if((locations[loop].row != KV_NO_ROW) && (locations[loop].length != KV_DELETED))
+        {
+            stats->keys++;
+        }
+    }
+    stats->min_erases = row_erases[0];
+    stats->max_erases = row_erases[0];
+    for(loop = 1; loop < KV_ROWS; loop++)
+    {
+        if(row_erases[loop] < stats->min_erases)
+        {
+            stats->min_erases = row_erases[loop];
+        }
+        if(row_erases[loop] > stats->max_erases)
+        {
+            stats->max_erases = row_erases[loop];
+        }
+    }
+}
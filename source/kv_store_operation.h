@@ -0,0 +1,70 @@
+/******************************************************************************
+* File Name: kv_store_operation.h
+*
+* Description: This file contains declarations related to the log of records
+* of the key-value store. It reaches the flash through kv_flash_ops_t only, so
+* it doesn't depend on the HAL or the RTOS.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_KV_STORE_OPERATION_H_
+#define SOURCE_KV_STORE_OPERATION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/***************************************
+*            Defines
+****************************************/
+/* Flash rows of the store. A row is CY_FLASH_SIZEOF_ROW of the PSoC 6,
+ * kv_operation.c checks that they match. */
+#define KV_ROW_SIZE                             (512)
+#define KV_ROWS                                 (32)
+
+/* RAM taken by the row buffers of the store */
+#define KV_RAM_BYTES                            (2 * KV_ROW_SIZE)
+
+/* Keys are 1 to KV_MAX_KEYS */
+#define KV_MAX_KEYS                             (8)
+
+/* Largest value, a record has to fit in a row with its headers */
+#define KV_MAX_VALUE                            (KV_ROW_SIZE - 24)
+
+/***************************************
+*            Types
+****************************************/
+/* Access to the flash rows of the store. Each function returns false if the
+ * flash failed. */
+typedef struct {
+    /* Read length bytes at offset of a row */
+    bool (*read)(uint8_t row, uint16_t offset, void *data, uint16_t length);
+    /* Erase a row and program all of it, erased flash reads as 0 */
+    bool (*write)(uint8_t row, const uint32_t *data);
+    /* Erase a row */
+    bool (*erase)(uint8_t row);
+} kv_flash_ops_t;
+
+/* Usage of the store */
+typedef struct {
+    uint8_t rows;                               /* Rows of the store */
+    uint8_t rows_used;                          /* Rows holding records */
+    uint8_t keys;                               /* Keys with a value */
+    uint16_t pending;                           /* Bytes of records not committed yet */
+    uint32_t min_erases;                        /* Fewest erases of a row */
+    uint32_t max_erases;                        /* Most erases of a row */
+} kv_stats_t;
+
+/***************************************
+*      Function Declarations
+****************************************/
+/* Log of records, the caller serializes the calls */
+void kv_store_init(const kv_flash_ops_t *ops);
+bool kv_store_set(uint16_t key, const void *value, uint16_t length);
+int32_t kv_store_get(uint16_t key, void *value, uint16_t size);
+bool kv_store_delete(uint16_t key);
+bool kv_store_commit(void);
+void kv_store_get_stats(kv_stats_t *stats);
+
+#endif /* SOURCE_KV_STORE_OPERATION_H_ */
@@ -17,6 +17,12 @@
 #include "iot_mqtt.h"
 #include "cJSON.h"
 #include "mqtt_operation.h"
+#include "history_operation.h"
+#include "fleet_operation.h"
+#include "notify_operation.h"
+#include "heap_operation.h"
+#include "snapshot_operation.h"
+#include "filter_operation.h"
 
 /* Set up logging for this demo. */
 #include "iot_demo_logging.h"
@@ -34,15 +40,145 @@
 #define MQTT_TIMEOUT_MS                         (5000)
 #define PUBLISH_RETRY_LIMIT                     (10)
 #define PUBLISH_RETRY_MS                        (1000)
-#define MAX_JSON_MESSAGE_LENGTH                 (100)
+#define MAX_JSON_MESSAGE_LENGTH                 (192)
 #define MAX_TOPIC_LENGTH                        (50)
 
-/* IP String length to copy from JSON message */
-#define IP_STR_LEN                              (16)
-
 /* Publish command size */
 #define PUBLISH_CMD_SIZE_BYTES                  (4)
 
+/* Limits for incoming shadow documents, AWS IoT caps a shadow at 8 KB and
+ * update/documents nests previous.state.reported.<key> plus metadata */
+#define MAX_SHADOW_DOCUMENT_LENGTH              (8192)
+#define MAX_SHADOW_DOCUMENT_DEPTH               (8)
+
+/*************** Write Fleet Channel ***************/
+/*
+ * Summary: Write the minimum, mean and maximum of a channel of the fleet
+ * summary as an array.
+ *
+ *  @param[in] writer The writer of the message.
+ *  @param[in] key The key of the array.
+ *  @param[in] fleet The fleet summary.
+ *  @param[in] channel The channel.
+ *  @param[in] scale The fixed-point scale of the channel.
+ *  @param[in] decimals The number of decimals to write.
+ */
+static void write_fleet_channel(cJSON_Writer *writer, const char *key, const fleet_summary_t *fleet,
+                                uint8_t channel, int32_t scale, int decimals)
+{
+    cJSON_WriteKey(writer, key);
+    cJSON_WriteArrayStart(writer);
+    cJSON_WriteFixed(writer, (double)fleet->min[channel] / scale, decimals);
+    cJSON_WriteFixed(writer, (double)fleet->mean[channel] / scale, decimals);
+    cJSON_WriteFixed(writer, (double)fleet->max[channel] / scale, decimals);
+    cJSON_WriteArrayEnd(writer);
+}
+
+/*************** Publish Snapshot Chunk ***************/
+/*
+ * Summary: Snapshot sink that publishes a chunk.
+ *
+ *  @param[in] chunk The chunk.
+ *  @param[in] length Length of the chunk.
+ *  @param[in] context The topic to publish on.
+ */
+static void publish_snapshot_chunk(const char *chunk, uint16_t length, void *context)
+{
+    char *topic = (char *)context;
+
+    PublishMessage( mqtt_connection,
+                    topic,
+                    (uint16_t)strlen(topic),
+                    (char *)chunk,
+                    length);
+}
+
+/*************** Build Reported State ***************/
+/*
+ * Summary: Write the shadow update for a publish command into a buffer with
+ * the cJSON writer, which doesn't allocate memory or use format strings.
+ *
+ *  @param[out] json Buffer for the message.
+ *  @param[in] length Size of the buffer.
+ *  @param[in] command The publish command.
+ *
+ *  @return Length of the message, 0 if it didn't fit or the command is unknown.
+ */
+static uint16_t build_reported_state(char *json, size_t length, uint8_t command)
+{
+    cJSON_Writer writer;
+    char ip_str[IP_STR_LEN];
+    iot_data_t thing;
+    fleet_summary_t fleet;
+
+    /* Publish a consistent set of values */
+    iot_data_snapshot(MY_THING, &thing);
+
+    cJSON_WriterInit(&writer, json, length);
+    cJSON_WriteObjectStart(&writer);
+    cJSON_WriteKey(&writer, "state");
+    cJSON_WriteObjectStart(&writer);
+    cJSON_WriteKey(&writer, "reported");
+    cJSON_WriteObjectStart(&writer);
+
+    switch(command)
+    {
+        case WEATHER_CMD:     /* publish temperature and humidity */
+            cJSON_WriteKey(&writer, "temperature");
+            cJSON_WriteFixed(&writer, (double)thing.temp / IOT_TEMPERATURE_SCALE, 1);
+            cJSON_WriteKey(&writer, "humidity");
+            cJSON_WriteFixed(&writer, (double)thing.humidity / IOT_HUMIDITY_SCALE, 1);
+            cJSON_WriteKey(&writer, "light");
+            cJSON_WriteFixed(&writer, (double)thing.light / IOT_LIGHT_SCALE, 0);
+            cJSON_WriteKey(&writer, "weatherAlert");
+            cJSON_WriteBool(&writer, thing.alert);
+            break;
+        case TEMPERATURE_CMD:     /* publish temperature */
+            cJSON_WriteKey(&writer, "temperature");
+            cJSON_WriteFixed(&writer, (double)thing.temp / IOT_TEMPERATURE_SCALE, 1);
+            break;
+        case HUMIDITY_CMD:     /* publish humidity */
+            cJSON_WriteKey(&writer, "humidity");
+            cJSON_WriteFixed(&writer, (double)thing.humidity / IOT_HUMIDITY_SCALE, 1);
+            break;
+        case LIGHT_CMD:  /* publish light value */
+            cJSON_WriteKey(&writer, "light");
+            cJSON_WriteFixed(&writer, (double)thing.light / IOT_LIGHT_SCALE, 1);
+            break;
+        case ALERT_CMD: /* weather alert */
+            cJSON_WriteKey(&writer, "weatherAlert");
+            cJSON_WriteBool(&writer, thing.alert);
+            break;
+        case IP_CMD:    /* IP address */
+            cJSON_WriteKey(&writer, "IPAddress");
+            iot_data_format_ip(thing.ip, ip_str);
+            cJSON_WriteString(&writer, ip_str);
+            break;
+        case FLEET_CMD: /* summary of all things, [min, mean, max] per value */
+            fleet_get_summary(&fleet);
+            cJSON_WriteKey(&writer, "fleet");
+            cJSON_WriteObjectStart(&writer);
+            cJSON_WriteKey(&writer, "things");
+            cJSON_WriteInteger(&writer, fleet.reporting);
+            cJSON_WriteKey(&writer, "alerts");
+            cJSON_WriteInteger(&writer, fleet.alerts);
+            write_fleet_channel(&writer, "temperature", &fleet, IOT_TEMPERATURE, IOT_TEMPERATURE_SCALE, 1);
+            write_fleet_channel(&writer, "humidity", &fleet, IOT_HUMIDITY, IOT_HUMIDITY_SCALE, 1);
+            write_fleet_channel(&writer, "light", &fleet, IOT_LIGHT, IOT_LIGHT_SCALE, 0);
+            cJSON_WriteObjectEnd(&writer);
+            break;
+        default:
+            return 0;
+    }
+
+    cJSON_WriteObjectEnd(&writer);
+    cJSON_WriteObjectEnd(&writer);
+    cJSON_WriteObjectEnd(&writer);
+
+    /* Any failed call above makes this return 0 */
+    return (uint16_t)cJSON_WriterFinish(&writer);
+}
+
 /*************** Publish Thread ***************/
 /*
  * Summary: Thread to publish data to the cloud
@@ -59,6 +195,9 @@ void publishThread(void* arg)
     /* json message to send */
     char json[MAX_JSON_MESSAGE_LENGTH];
 
+    /* Snapshot of all things, too large for the stack */
+    static char snapshot[SNAPSHOT_MQTT_BUFFER_BYTES];
+
     /* Command pushed onto the queue to determine what to publish */
     uint8_t pubCmd[PUBLISH_CMD_SIZE_BYTES];
 
@@ -90,38 +229,30 @@ void publishThread(void* arg)
         topicLength = snprintf(topic, sizeof(topic), "%s%02d/shadow/update", TOPIC_HEAD, MY_THING);
 
         /* Setup the JSON message based on the command */
-        switch(command[0])
+        if(command[0] == SNAPSHOT_CMD)  /* Answer a request for the snapshot of all things */
         {
-            case WEATHER_CMD:     /* publish temperature and humidity */
-                messageLength = snprintf(json, sizeof(json), "{\"state\" : {\"reported\" : {\"temperature\":%.1f,\"humidity\":%.1f,\"light\":%.0f,\"weatherAlert\":%s}}}", iot_data[MY_THING].temp, iot_data[MY_THING].humidity, iot_data[MY_THING].light, iot_data[MY_THING].alert ? "true" : "false");
-                break;
-            case TEMPERATURE_CMD:     /* publish temperature */
-                messageLength = snprintf(json, sizeof(json), "{\"state\" : {\"reported\" : {\"temperature\":%.1f} } }", iot_data[MY_THING].temp);
-                break;
-            case HUMIDITY_CMD:     /* publish humidity */
-                messageLength = snprintf(json, sizeof(json), "{\"state\" : {\"reported\" : {\"humidity\":%.1f} } }", iot_data[MY_THING].humidity);
-                break;
-            case LIGHT_CMD:  /* publish light value */
-                messageLength = snprintf(json, sizeof(json), "{\"state\" : {\"reported\" : {\"light\":%.1f} } }", iot_data[MY_THING].light);
-                break;
-            case ALERT_CMD: /* weather alert */
-                if(iot_data[MY_THING].alert)
-                {
-                    messageLength = snprintf(json, sizeof(json), "{\"state\" : {\"reported\" : {\"weatherAlert\":true} } }");
-                }
-                else
-                {
-                    messageLength = snprintf(json, sizeof(json), "{\"state\" : {\"reported\" : {\"weatherAlert\":false} } }");
-                }
-                break;
-            case IP_CMD:    /* IP address */
-                messageLength = snprintf(json, sizeof(json), "{\"state\" : {\"reported\" : {\"IPAddress\":\"%s\"} } }", iot_data[MY_THING].ip_str);
-                break;
-            case GET_CMD:   /* Get starting state of other things */
-                messageLength = snprintf(json, sizeof(json), "{}");
-                /* Override the topic to do a get of the specified thing's shadow */
-                topicLength = snprintf(topic, sizeof(topic), "%s%02d/shadow/get", TOPIC_HEAD, command[1]);
-                break;
+            snprintf(topic, sizeof(topic), "%sThing_%02d/fleet/snapshot", FLEET_TOPIC_HEAD, MY_THING);
+            if(snapshot_write(snapshot, sizeof(snapshot), publish_snapshot_chunk, topic) == 0)
+            {
+                configPRINTF(("Failed to write the snapshot\r\n"));
+            }
+            vTaskDelay(pdMS_TO_TICKS(PUBLISH_THREAD_LOOP_DELAY_MS));
+            continue;
+        }
+        else if(command[0] == GET_CMD)   /* Get starting state of other things */
+        {
+            messageLength = snprintf(json, sizeof(json), "{}");
+            /* Override the topic to do a get of the specified thing's shadow */
+            topicLength = snprintf(topic, sizeof(topic), "%s%02d/shadow/get", TOPIC_HEAD, command[1]);
+        }
+        else
+        {
+            messageLength = build_reported_state(json, sizeof(json), command[0]);
+            if(messageLength == 0)
+            {
+                configPRINTF(("Failed to build the message for command %d\r\n", command[0]));
+                continue;
+            }
         }
 
         /* PUBLISH (and wait) for all messages. */
@@ -135,6 +266,284 @@ void publishThread(void* arg)
     }
 }
 
+/*************** Shadow Document Mirror ***************/
+/*
+ * The latest reported value of each key read from every other thing is kept
+ * in its shadow mirror. Incoming documents are parsed lazily, so "previous",
+ * "metadata", ... are only skipped, and the reported keys of their reported
+ * object are merged into the mirror like an RFC 7386 merge patch: a key left
+ * out keeps its value and null removes it. Other keys are ignored, so the
+ * mirrors have a fixed size whatever the other things publish. Only the
+ * fields that really changed are copied into the thing data and reported as
+ * changes to the consumers. A removed key sets its field back to the value of
+ * a thing that never reported it: 0, alert off and no IP address.
+ */
+/* Keys of the reported state that are read from other things */
+enum
+{
+    TEMPERATURE_KEY,
+    HUMIDITY_KEY,
+    LIGHT_KEY,
+    ALERT_KEY,
+    IP_KEY,
+    REPORTED_KEY_COUNT
+};
+
+_Static_assert(REPORTED_KEY_COUNT == SHADOW_MIRROR_KEYS, "A shadow mirror has a value for each reported key");
+
+/* Change notification of the reported keys, in the order of the enum above */
+static const uint32_t reported_fields[REPORTED_KEY_COUNT] =
+{
+    NOTIFY_TEMPERATURE,
+    NOTIFY_HUMIDITY,
+    NOTIFY_LIGHT,
+    NOTIFY_ALERT,
+    NOTIFY_IP
+};
+
+/* Names of the reported keys, in the order of the enum above */
+static const char * const reported_keys[REPORTED_KEY_COUNT] =
+{
+    "temperature",
+    "humidity",
+    "light",
+    "weatherAlert",
+    "IPAddress"
+};
+
+/* Keys that appear in every shadow document, parsed trees point at these
+ * instead of allocating a copy of each key */
+static const char * const shadow_keys[] =
+{
+    "state", "reported", "desired", "current", "previous", "metadata",
+    "timestamp", "version", "temperature", "humidity", "light",
+    "weatherAlert", "IPAddress"
+};
+
+/* Compiled paths to the reported object in the subscribed shadow documents */
+static cJSON_Path get_accepted_query;
+static cJSON_Path update_documents_query;
+
+/* Reported state of the other things, nothing is reported before their first document */
+static shadow_mirror_t shadow_mirror[MAX_THING + 1];
+
+/*************** Compile Shadow Queries ***************/
+/*
+ * Summary: Compile the paths to the reported object. The shadow documents are
+ * generated by AWS so the fast case sensitive comparison is used.
+ *
+ *  @return true if all paths were compiled.
+ */
+static bool compile_shadow_queries(void)
+{
+    return cJSON_CompilePath(&get_accepted_query, "state.reported", true) &&
+           cJSON_CompilePath(&update_documents_query, "current.state.reported", true);
+}
+
+/*************** Merge Reported Value ***************/
+/*
+ * Summary: Merge the value of a reported key into a thing's mirror.
+ *
+ *  @param[in] mirror The thing's mirror.
+ *  @param[in] key The reported key.
+ *  @param[in] value The value of the key in the shadow document.
+ *
+ *  @return true if the key has a new value or null removed it, false if the
+ *  value is the same or the key wasn't there to remove.
+ */
+static bool merge_reported_value(shadow_mirror_t *mirror, uint8_t key, const cJSON *value)
+{
+    uint8_t type = (uint8_t)(value->type & 0xFF);
+    bool changed = (mirror->type[key] != type);
+
+    switch(type)
+    {
+        case cJSON_NULL:
+            changed = (mirror->type[key] != cJSON_Invalid);
+            mirror->type[key] = cJSON_Invalid;
+            return changed;
+        case cJSON_Number:
+            changed = changed || (mirror->number[key] != value->valuedouble);
+            mirror->number[key] = value->valuedouble;
+            break;
+        case cJSON_String:
+            /* Only the IP address is read from a string, other strings are
+             * rejected anyway */
+            if(key == IP_KEY)
+            {
+                if(strlen(value->valuestring) >= SHADOW_MIRROR_STRING_SIZE)
+                {
+                    changed = changed || (mirror->ip[0] != '\0');
+                    mirror->ip[0] = '\0';
+                }
+                else
+                {
+                    changed = changed || (strcmp(mirror->ip, value->valuestring) != 0);
+                    strcpy(mirror->ip, value->valuestring);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    mirror->type[key] = type;
+    return changed;
+}
+
+/*************** Copy Reported Value ***************/
+/*
+ * Summary: Convert the value of a reported key and store it in a thing's data.
+ * Null clears the field.
+ *
+ *  @param[out] data The thing's data.
+ *  @param[in] key The reported key.
+ *  @param[in] value The value of the key in the shadow document.
+ *
+ *  @return true if the value had the expected type or was null.
+ */
+static bool copy_reported_value(iot_data_t *data, uint8_t key, const cJSON *value)
+{
+    if(cJSON_IsNull(value))
+    {
+        value = NULL;
+    }
+
+    switch(key)
+    {
+        case TEMPERATURE_KEY:
+        case HUMIDITY_KEY:
+        case LIGHT_KEY:
+            if((value != NULL) && !cJSON_IsNumber(value))
+            {
+                return false;
+            }
+            if(key == TEMPERATURE_KEY)
+            {
+                data->temp = (value != NULL) ? iot_data_to_fixed((float)value->valuedouble, IOT_TEMPERATURE_SCALE) : 0;
+            }
+            else if(key == HUMIDITY_KEY)
+            {
+                data->humidity = (value != NULL) ? iot_data_to_fixed((float)value->valuedouble, IOT_HUMIDITY_SCALE) : 0;
+            }
+            else
+            {
+                data->light = (value != NULL) ? iot_data_to_fixed((float)value->valuedouble, IOT_LIGHT_SCALE) : 0;
+            }
+            return true;
+        case ALERT_KEY:
+            if(value == NULL)
+            {
+                data->alert = false;
+            }
+            else if(cJSON_IsBool(value))
+            {
+                data->alert = cJSON_IsTrue(value);
+            }
+            else if(cJSON_IsNumber(value))
+            {
+                data->alert = (value->valuedouble != 0);
+            }
+            else
+            {
+                return false;
+            }
+            return true;
+        case IP_KEY:
+            if(value == NULL)
+            {
+                data->ip = 0;
+                return true;
+            }
+            return cJSON_IsString(value) && iot_data_parse_ip(value->valuestring, &data->ip);
+        default:
+            return false;
+    }
+}
+
+/*************** Read Reported State ***************/
+/*
+ * Summary: Merge the reported state of a shadow document into the thing's
+ * mirror, copy the fields that changed into the thing's data structure and
+ * notify the consumers of the change.
+ *
+ *  @param[in] thingNumber The number of the thing the document belongs to.
+ *  @param[in] pPayload The shadow document (not null terminated).
+ *  @param[in] payloadLength Length of the shadow document.
+ *  @param[in] query Compiled path to the reported object.
+ *
+ *  @return Bit mask of the reported keys that changed, 0 if none did or the
+ *  document couldn't be used.
+ */
+static uint8_t read_reported_state(uint32_t thingNumber,
+                                   const char *pPayload,
+                                   size_t payloadLength,
+                                   const cJSON_Path *query)
+{
+    shadow_mirror_t *mirror = &shadow_mirror[thingNumber];
+    iot_data_t thing;
+    cJSON *document = NULL;
+    cJSON *reported = NULL;
+    cJSON *value;
+    size_t errorOffset = 0;
+    uint32_t fields;
+    uint8_t changed = 0;
+    uint8_t loop;
+
+    /* Reject garbage before any of it is parsed */
+    if((payloadLength > MAX_SHADOW_DOCUMENT_LENGTH) ||
+       !cJSON_Validate(pPayload, payloadLength, MAX_SHADOW_DOCUMENT_DEPTH, &errorOffset))
+    {
+        configPRINTF(("Rejected shadow document of Thing_%02"PRIu32" (%u bytes, error at %u)\r\n",
+                      thingNumber, (unsigned int)payloadLength, (unsigned int)errorOffset));
+        return 0;
+    }
+
+    document = cJSON_ParseLazy(pPayload, payloadLength, NULL);
+    if(document == NULL)
+    {
+        return 0;
+    }
+    if((cJSON_ResolvePaths(document, query, 1, &reported) != 1) || !cJSON_IsObject(reported))
+    {
+        cJSON_Delete(document);
+        return 0;
+    }
+
+    /* Convert the changed fields into a copy and publish it in one go */
+    iot_data_snapshot((uint8_t)thingNumber, &thing);
+    for(loop = 0; loop < REPORTED_KEY_COUNT; loop++)
+    {
+        value = cJSON_GetObjectItemCaseSensitive(reported, reported_keys[loop]);
+        if((value != NULL) &&
+           merge_reported_value(mirror, loop, value) &&
+           copy_reported_value(&thing, loop, value))
+        {
+            changed |= (1u << loop);
+        }
+    }
+    cJSON_Delete(document);
+
+    if(changed != 0)
+    {
+        iot_data_write_begin((uint8_t)thingNumber);
+        iot_data_store((uint8_t)thingNumber, &thing);
+        iot_data_write_end((uint8_t)thingNumber);
+        history_append((uint8_t)thingNumber, thing.temp, thing.humidity, thing.light);
+
+        /* Tell the consumers which fields changed */
+        fields = 0;
+        for(loop = 0; loop < REPORTED_KEY_COUNT; loop++)
+        {
+            if(changed & (1u << loop))
+            {
+                fields |= reported_fields[loop];
+            }
+        }
+        notify_publish((uint8_t)thingNumber, fields);
+    }
+    return changed;
+}
+
 /***************  MQTT Subscription callback ***************/
 /*
  * Summary: Called by the MQTT library when an incoming PUBLISH message is received.
@@ -152,18 +561,48 @@ void MqttSubscriptionCallback( void * param1,
     char topicStr[MAX_TOPIC_LENGTH] = {0};    /* String to copy the topic into */
     char pubType[20] =  {0};    /* String to compare to the publish type */
     uint32_t thingNumber;           /* The number of the thing that published a message */
+    uint8_t pubCmd[PUBLISH_CMD_SIZE_BYTES] = {0};  /* Command pushed onto the publish queue */
+    const char *pPayload = (const char *)pPublish->u.message.info.pPayload;
+    size_t payloadLength = pPublish->u.message.info.payloadLength;
 
     /* Copy the topic name to a null terminated string */
+    if(pPublish->u.message.info.topicNameLength >= sizeof(topicStr))
+    {
+        return;
+    }
     memcpy(topicStr, pPublish->u.message.info.pTopicName, pPublish->u.message.info.topicNameLength);
     topicStr[pPublish->u.message.info.topicNameLength] = 0; /* Add termination */
 
-    /* Copy the message to a null terminated string */
-    char *pPayload = (char*)pvPortMalloc(pPublish->u.message.info.payloadLength + 1);
-    memcpy(pPayload, pPublish->u.message.info.pPayload, pPublish->u.message.info.payloadLength);
-    topicStr[pPublish->u.message.info.topicNameLength] = 0; /* Add termination */
+    /* Check to see if it is a request for the snapshot of all things */
+    if((sscanf(topicStr, FLEET_TOPIC_HEAD "Thing_%2"PRIu32"/fleet/%19s", &thingNumber, pubType) == 2) &&
+       (thingNumber == MY_THING) && (strcmp(pubType, "get") == 0))
+    {
+        /* Answered by the publish thread, don't block the MQTT library */
+        pubCmd[0] = SNAPSHOT_CMD;
+        if(xQueueSend(pub_queue, pubCmd, 0) != pdTRUE)
+        {
+            configPRINTF(("Publish queue full, snapshot request dropped\r\n"));
+        }
+        return;
+    }
+
+    /* Check to see if it is new settings of the filters of the weather data */
+    if((sscanf(topicStr, FLEET_TOPIC_HEAD "Thing_%2"PRIu32"/filter/%19s", &thingNumber, pubType) == 2) &&
+       (thingNumber == MY_THING) && (strcmp(pubType, "set") == 0))
+    {
+        if(!filter_parse_config(pPayload, payloadLength))
+        {
+            configPRINTF(("Rejected filter settings, some channels may be unchanged\r\n"));
+        }
+        return;
+    }
 
     /* Scan the topic to see if it is one of the things we are interested in */
-    sscanf(topicStr, "$aws/things/Thing_%2"PRIu32"/shadow/%19s", &thingNumber, pubType);
+    if((sscanf(topicStr, "$aws/things/Thing_%2"PRIu32"/shadow/%19s", &thingNumber, pubType) != 2) ||
+       (thingNumber > MAX_THING))
+    {
+        return;
+    }
 
     /* Check to see if it is an initial get of the values of other things */
     if(strcmp(pubType,"get/accepted") == 0)
@@ -171,19 +610,7 @@ void MqttSubscriptionCallback( void * param1,
         if(thingNumber != MY_THING) /* Only do the rest if it isn't the local thing */
         {
             /* Parse JSON message for the weather station data */
-            cJSON *root = cJSON_Parse(pPayload);
-            cJSON *state = cJSON_GetObjectItem(root,"state");
-            cJSON *reported = cJSON_GetObjectItem(state,"reported");
-            cJSON *ipValue = cJSON_GetObjectItem(reported,"IPAddress");
-            if(ipValue->type == cJSON_String) /* Make sure we have a string */
-            {
-                strncpy(iot_data[thingNumber].ip_str, ipValue->valuestring, IP_STR_LEN);
-            }
-            iot_data[thingNumber].temp = (float) cJSON_GetObjectItem(reported,"temperature")->valuedouble;
-            iot_data[thingNumber].humidity = (float) cJSON_GetObjectItem(reported,"humidity")->valuedouble;
-            iot_data[thingNumber].light = (float) cJSON_GetObjectItem(reported,"light")->valuedouble;
-            iot_data[thingNumber].alert = (bool) cJSON_GetObjectItem(reported,"weatherAlert")->valueint;
-            cJSON_Delete(root);
+            ( void )read_reported_state(thingNumber, pPayload, payloadLength, &get_accepted_query);
         }
     }
     /* Check to see if it is an update published by another thing */
@@ -192,32 +619,31 @@ void MqttSubscriptionCallback( void * param1,
         if(thingNumber != MY_THING) /* Only do the rest if it isn't the local thing */
         {
             /* Parse JSON message for the weather station data */
-            cJSON *root = cJSON_Parse(pPayload);
-            cJSON *current = cJSON_GetObjectItem(root,"current");
-            cJSON *state = cJSON_GetObjectItem(current,"state");
-            cJSON *reported = cJSON_GetObjectItem(state,"reported");
-            cJSON *ipValue = cJSON_GetObjectItem(reported,"IPAddress");
-            if(ipValue->type == cJSON_String) /* Make sure we have a string */
+            if(read_reported_state(thingNumber, pPayload, payloadLength, &update_documents_query) != 0)
             {
-                strncpy(iot_data[thingNumber].ip_str, ipValue->valuestring, IP_STR_LEN);
-            }
-            iot_data[thingNumber].temp = (float) cJSON_GetObjectItem(reported,"temperature")->valuedouble;
-            iot_data[thingNumber].humidity = (float) cJSON_GetObjectItem(reported,"humidity")->valuedouble;
-            iot_data[thingNumber].light = (float) cJSON_GetObjectItem(reported,"light")->valuedouble;
-            iot_data[thingNumber].alert = (bool) cJSON_GetObjectItem(reported,"weatherAlert")->valueint;
-            cJSON_Delete(root);
-            if(print_all)
-            {
-                print_thing_info(thingNumber);
-            }
-            /* Update the display if we are displaying this thing's data */
-            if(thingNumber == disp_thing)
-            {
-                xSemaphoreGive(display_semaphore);
+                if(print_all)
+                {
+                    print_thing_info(thingNumber);
+                }
             }
         }
     }
-    vPortFree(pPayload);
+}
+
+/*************** cJSON Pool Lock ***************/
+/*
+ * Summary: The cJSON pool is used by the MQTT, publish and command threads.
+ * Its free lists are only touched for a few instructions at a time, so the
+ * scheduler is suspended instead of taking a mutex.
+ */
+static void cjson_pool_lock(void)
+{
+    vTaskSuspendAll();
+}
+
+static void cjson_pool_unlock(void)
+{
+    ( void )xTaskResumeAll();
 }
 
 /*************** Initialize MQTT library***************/
@@ -227,6 +653,14 @@ int InitializeMqtt( void )
     int status = EXIT_SUCCESS;
     IotMqttError_t mqttInitStatus = IOT_MQTT_SUCCESS;
 
+#if APP_HEAP
+    /* Allocations that miss the cJSON pool go to the heap of the application */
+    cJSON_Hooks hooks = { pvPortMalloc, vPortFree };
+    cJSON_InitHooks(&hooks);
+#endif
+    cJSON_SetPoolLock(cjson_pool_lock, cjson_pool_unlock);
+    ( void )cJSON_InternKeys(shadow_keys, (int)(sizeof(shadow_keys) / sizeof(shadow_keys[0])));
+
     mqttInitStatus = IotMqtt_Init();
 
     if( mqttInitStatus != IOT_MQTT_SUCCESS )
@@ -235,6 +669,11 @@ int InitializeMqtt( void )
         configPRINTF(("Failed to initialize MQTT library\r\n"));
         status = EXIT_FAILURE;
     }
+    else if(!compile_shadow_queries())
+    {
+        configPRINTF(("Failed to compile the shadow document queries\r\n"));
+        status = EXIT_FAILURE;
+    }
     return status;
 }
 
@@ -13,7 +13,31 @@
 #include "common_resource.h"
 
 /* MQTT Broker info */
-#define TOPIC_FILTER_COUNT                      (2)
+#define TOPIC_FILTER_COUNT                      (4)
+
+/* Topics of the snapshot of all things, a request on <head>NN/fleet/get is
+ * answered on <head>NN/fleet/snapshot where NN is MY_THING. The filters of
+ * the weather data are set with <head>NN/filter/set. */
+#define FLEET_TOPIC_HEAD                        "weatherstation/"
+
+/* Reported keys kept in the shadow mirror of a thing and the longest string
+ * value, an IP address, with its terminator */
+#define SHADOW_MIRROR_KEYS                      (5)
+#define SHADOW_MIRROR_STRING_SIZE               (16)
+
+/* RAM of the shadow mirrors of the other things */
+#define SHADOW_MIRROR_RAM_BYTES                 ((MAX_THING + 1) * sizeof(shadow_mirror_t))
+
+/***************************************
+*            Types
+****************************************/
+/* Last reported value of each key of a thing, compared with every new shadow
+ * document so only the keys that changed are copied into the thing data */
+typedef struct {
+    uint8_t type[SHADOW_MIRROR_KEYS];           /* cJSON type of the value, cJSON_Invalid if not reported */
+    double number[SHADOW_MIRROR_KEYS];          /* Value of the numbers */
+    char ip[SHADOW_MIRROR_STRING_SIZE];         /* Value of the IP address, empty if it didn't fit */
+} shadow_mirror_t;
 
 /***************************************
 *      Function Declarations
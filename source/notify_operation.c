@@ -0,0 +1,180 @@
+/******************************************************************************
+* File Name: notify_operation.c
+*
+* Description: This file contains the change notifications. Producers of
+* thing data say which things and fields they changed. The changes are
+* accumulated per consumer in bitmaps and the consumer task is woken with a
+* task notification, so a consumer only does the work for what changed.
+*
+* A change is always added to the bitmaps before the task is notified and the
+* consumer takes the notification before it takes the bitmaps, so no change
+* is ever lost. A consumer can wake up to changes it already handled, it then
+* gets empty bitmaps.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <string.h>
+#include "cyhal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "notify_operation.h"
+
+/***************************************
+*            Types
+****************************************/
+/* Consumer task and the changes it hasn't taken yet */
+typedef struct {
+    TaskHandle_t task;
+    uint32_t interest;                          /* Fields the consumer wants to hear about */
+    notify_changes_t pending;
+} notify_subscriber_t;
+
+/***************************************
+*          Global Variables
+****************************************/
+static notify_subscriber_t subscribers[NOTIFY_MAX_SUBSCRIBERS];
+static uint8_t subscriber_count;
+
+/*************** Add Changes ***************/
+/*
+ * Summary: Add a change to the pending changes of the interested consumers.
+ * Call it inside a critical section.
+ *
+ *  @param[in] thingNumber The number of the thing or NOTIFY_NO_THING.
+ *  @param[in] fields The fields that changed.
+ *
+ *  @return Bit set for each consumer that has to be woken.
+ */
+static uint32_t add_changes(uint8_t thingNumber, uint32_t fields)
+{
+    notify_subscriber_t *subscriber;
+    uint32_t wake = 0;
+    uint8_t loop;
+
+    for(loop = 0; loop < subscriber_count; loop++)
+    {
+        subscriber = &subscribers[loop];
+        if((subscriber->interest & fields) == 0)
+        {
+            continue;
+        }
+        subscriber->pending.fields |= (subscriber->interest & fields);
+        if(thingNumber != NOTIFY_NO_THING)
+        {
+            subscriber->pending.things[THING_WORD(thingNumber)] |= THING_BIT(thingNumber);
+        }
+        wake |= (1UL << loop);
+    }
+    return wake;
+}
+
+/*************** Subscribe ***************/
+/*
+ * Summary: Register the calling task as a consumer of changes. Changes made
+ * before the call aren't reported.
+ *
+ *  @param[in] fields The NOTIFY_xxx bits of the fields to hear about.
+ *
+ *  @return The subscriber to pass to notify_wait, -1 if all are taken.
+ */
+int8_t notify_subscribe(uint32_t fields)
+{
+    int8_t subscriber = -1;
+
+    taskENTER_CRITICAL();
+    if(subscriber_count < NOTIFY_MAX_SUBSCRIBERS)
+    {
+        subscriber = (int8_t)subscriber_count;
+        memset(&subscribers[subscriber], 0, sizeof(subscribers[subscriber]));
+        subscribers[subscriber].task = xTaskGetCurrentTaskHandle();
+        subscribers[subscriber].interest = fields;
+        subscriber_count++;
+    }
+    taskEXIT_CRITICAL();
+    return subscriber;
+}
+
+/*************** Publish Change ***************/
+/*
+ * Summary: Report a change from a task.
+ *
+ *  @param[in] thingNumber The number of the thing that changed or
+ *  NOTIFY_NO_THING.
+ *  @param[in] fields The NOTIFY_xxx bits of the fields that changed.
+ */
+void notify_publish(uint8_t thingNumber, uint32_t fields)
+{
+    uint32_t wake;
+    uint8_t loop;
+
+    taskENTER_CRITICAL();
+    wake = add_changes(thingNumber, fields);
+    taskEXIT_CRITICAL();
+
+    for(loop = 0; wake != 0; loop++, wake >>= 1)
+    {
+        if(wake & 1UL)
+        {
+            xTaskNotifyGive(subscribers[loop].task);
+        }
+    }
+}
+
+/*************** Publish Change from ISR ***************/
+/*
+ * Summary: Report a change from an ISR.
+ *
+ *  @param[in] thingNumber The number of the thing that changed or
+ *  NOTIFY_NO_THING.
+ *  @param[in] fields The NOTIFY_xxx bits of the fields that changed.
+ *  @param[out] pxHigherPriorityTaskWoken Set to pdTRUE if a consumer of
+ *  higher priority was woken.
+ */
+void notify_publish_from_isr(uint8_t thingNumber, uint32_t fields, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    UBaseType_t savedInterruptStatus;
+    uint32_t wake;
+    uint8_t loop;
+
+    savedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    wake = add_changes(thingNumber, fields);
+    taskEXIT_CRITICAL_FROM_ISR(savedInterruptStatus);
+
+    for(loop = 0; wake != 0; loop++, wake >>= 1)
+    {
+        if(wake & 1UL)
+        {
+            vTaskNotifyGiveFromISR(subscribers[loop].task, pxHigherPriorityTaskWoken);
+        }
+    }
+}
+
+/*************** Wait for Changes ***************/
+/*
+ * Summary: Wait until a change is reported and take all changes reported
+ * since the last call. Call it from the task that subscribed.
+ *
+ *  @param[in] subscriber The value returned by notify_subscribe.
+ *  @param[out] changes The changes, empty if they were taken by an earlier
+ *  call.
+ *  @param[in] timeout Ticks to wait for a change.
+ *
+ *  @return false if the wait timed out.
+ */
+bool notify_wait(int8_t subscriber, notify_changes_t *changes, TickType_t timeout)
+{
+    configASSERT((subscriber >= 0) && (subscriber < subscriber_count));
+
+    if(ulTaskNotifyTake(pdTRUE, timeout) == 0)
+    {
+        memset(changes, 0, sizeof(*changes));
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    *changes = subscribers[subscriber].pending;
+    memset(&subscribers[subscriber].pending, 0, sizeof(subscribers[subscriber].pending));
+    taskEXIT_CRITICAL();
+    return true;
+}
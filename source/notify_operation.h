@@ -0,0 +1,55 @@
+/******************************************************************************
+* File Name: notify_operation.h
+*
+* Description: This file contains declarations related to the change
+* notifications sent from the producers of thing data to its consumers.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_NOTIFY_OPERATION_H_
+#define SOURCE_NOTIFY_OPERATION_H_
+
+#include "common_resource.h"
+#include "task.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Fields that changed */
+#define NOTIFY_TEMPERATURE                      (1UL << 0)
+#define NOTIFY_HUMIDITY                         (1UL << 1)
+#define NOTIFY_LIGHT                            (1UL << 2)
+#define NOTIFY_ALERT                            (1UL << 3)
+#define NOTIFY_IP                               (1UL << 4)
+#define NOTIFY_VIEW                             (1UL << 5)  /* The selection on the display changed */
+#define NOTIFY_ALL_FIELDS                       (0x3FUL)
+
+/* Thing number of a change that isn't about a thing, e.g. NOTIFY_VIEW */
+#define NOTIFY_NO_THING                         (0xFF)
+
+/* Maximum number of consumer tasks, the Display and Persist threads */
+#define NOTIFY_MAX_SUBSCRIBERS                  (2)
+
+/***************************************
+*            Types
+****************************************/
+/* Changes accumulated since a consumer last looked */
+typedef struct {
+    uint32_t things[THING_BITSET_WORDS];        /* Bit set for each thing that changed */
+    uint32_t fields;                            /* NOTIFY_xxx bits of the fields that changed */
+} notify_changes_t;
+
+/* Check if a thing is among the changes */
+#define NOTIFY_THING_CHANGED(changes, thingNumber) \
+    (((changes)->things[THING_WORD(thingNumber)] & THING_BIT(thingNumber)) != 0)
+
+/***************************************
+*      Function Declarations
+****************************************/
+int8_t notify_subscribe(uint32_t fields);
+void notify_publish(uint8_t thingNumber, uint32_t fields);
+void notify_publish_from_isr(uint8_t thingNumber, uint32_t fields, BaseType_t *pxHigherPriorityTaskWoken);
+bool notify_wait(int8_t subscriber, notify_changes_t *changes, TickType_t timeout);
+
+#endif /* SOURCE_NOTIFY_OPERATION_H_ */
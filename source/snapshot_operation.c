@@ -0,0 +1,144 @@
+/******************************************************************************
+* File Name: snapshot_operation.c
+*
+* Description: This file contains the snapshot document of the data of all
+* things. It is written in one pass over the things straight into a buffer of
+* the caller with the cJSON writer, so it takes no heap. When the buffer is
+* full the document written so far is handed to a sink as a chunk and the
+* next chunk starts in the same buffer.
+*
+* Each chunk is a JSON document:
+*   {"part":0,"fields":["thing","weatherAlert","temperature","humidity","light","IPAddress"],
+*    "things":[[3,false,21.5,40.2,310,"192.168.1.23"],...],"last":false}
+* "fields" is only in the first part. Things that haven't reported are left
+* out. Each thing is read with the sequence lock, so its values are
+* consistent, but things can change while the document is written.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include "cyhal.h"
+#include "FreeRTOS.h"
+#include "cJSON.h"
+#include "snapshot_operation.h"
+#include "fleet_operation.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* End of a chunk, ],"last":false} */
+#define SNAPSHOT_END_BYTES                      (16)
+
+/*************** Start Chunk ***************/
+/*
+ * Summary: Start a chunk up to the array of the things.
+ *
+ *  @param[in] writer The writer of the chunk.
+ *  @param[in] buffer The buffer of the chunk.
+ *  @param[in] size Size of the buffer.
+ *  @param[in] part The number of the chunk.
+ */
+static void start_chunk(cJSON_Writer *writer, char *buffer, size_t size, uint8_t part)
+{
+    cJSON_WriterInit(writer, buffer, size);
+    cJSON_WriteObjectStart(writer);
+    cJSON_WriteKey(writer, "part");
+    cJSON_WriteInteger(writer, part);
+    if(part == 0)
+    {
+        cJSON_WriteKey(writer, "fields");
+        cJSON_WriteRaw(writer, "[\"thing\",\"weatherAlert\",\"temperature\",\"humidity\",\"light\",\"IPAddress\"]");
+    }
+    cJSON_WriteKey(writer, "things");
+    cJSON_WriteArrayStart(writer);
+}
+
+/*************** End Chunk ***************/
+/*
+ * Summary: Close a chunk and hand it to the sink.
+ *
+ *  @param[in] writer The writer of the chunk.
+ *  @param[in] buffer The buffer of the chunk.
+ *  @param[in] last true if no chunk follows.
+ *  @param[in] sink The sink.
+ *  @param[in] context Passed to the sink.
+ *
+ *  @return false if the chunk didn't fit.
+ */
+static bool end_chunk(cJSON_Writer *writer, const char *buffer, bool last, snapshot_sink_t sink, void *context)
+{
+    size_t length;
+
+    cJSON_WriteArrayEnd(writer);
+    cJSON_WriteKey(writer, "last");
+    cJSON_WriteBool(writer, last);
+    cJSON_WriteObjectEnd(writer);
+
+    length = cJSON_WriterFinish(writer);
+    if(length == 0)
+    {
+        return false;
+    }
+    sink(buffer, (uint16_t)length, context);
+    return true;
+}
+
+/*************** Write Snapshot ***************/
+/*
+ * Summary: Write the data of all things that have reported as one or more
+ * chunks.
+ *
+ *  @param[in] buffer Buffer for a chunk, reused for each chunk.
+ *  @param[in] size Size of the buffer, at least SNAPSHOT_MIN_BUFFER_BYTES and
+ *  at most 65535.
+ *  @param[in] sink Called with each chunk.
+ *  @param[in] context Passed to the sink.
+ *
+ *  @return The number of chunks handed to the sink, 0 if the buffer is too
+ *  small.
+ */
+uint8_t snapshot_write(char *buffer, size_t size, snapshot_sink_t sink, void *context)
+{
+    cJSON_Writer writer;
+    char ip_str[IP_STR_LEN];
+    iot_data_t thing;
+    uint8_t part = 0;
+    uint8_t thingNumber;
+
+    if((size < SNAPSHOT_MIN_BUFFER_BYTES) || (size > UINT16_MAX))
+    {
+        return 0;
+    }
+
+    start_chunk(&writer, buffer, size, part);
+    for(thingNumber = 0; thingNumber <= MAX_THING; thingNumber++)
+    {
+        if(!fleet_is_reporting(thingNumber))
+        {
+            continue;
+        }
+
+        /* Hand over the chunk once the largest thing might not fit */
+        if((cJSON_WriterLength(&writer) + SNAPSHOT_THING_BYTES + SNAPSHOT_END_BYTES) > size)
+        {
+            if(!end_chunk(&writer, buffer, false, sink, context))
+            {
+                return part;
+            }
+            start_chunk(&writer, buffer, size, ++part);
+        }
+
+        iot_data_snapshot(thingNumber, &thing);
+        iot_data_format_ip(thing.ip, ip_str);
+        cJSON_WriteArrayStart(&writer);
+        cJSON_WriteInteger(&writer, thingNumber);
+        cJSON_WriteBool(&writer, thing.alert);
+        cJSON_WriteFixed(&writer, (double)thing.temp / IOT_TEMPERATURE_SCALE, 1);
+        cJSON_WriteFixed(&writer, (double)thing.humidity / IOT_HUMIDITY_SCALE, 1);
+        cJSON_WriteFixed(&writer, (double)thing.light / IOT_LIGHT_SCALE, 0);
+        cJSON_WriteString(&writer, ip_str);
+        cJSON_WriteArrayEnd(&writer);
+    }
+
+    return end_chunk(&writer, buffer, true, sink, context) ? (uint8_t)(part + 1) : part;
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+* File Name: snapshot_operation.h
+*
+* Description: This file contains declarations related to the snapshot
+* document of the data of all things.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef SOURCE_SNAPSHOT_OPERATION_H_
+#define SOURCE_SNAPSHOT_OPERATION_H_
+
+#include "common_resource.h"
+
+/***************************************
+*            Defines
+****************************************/
+/* Largest thing in a chunk, [39,false,-3276.8,-3276.8,-32768,"255.255.255.255"]
+ * and the comma before it */
+#define SNAPSHOT_THING_BYTES                    (56)
+
+/* Smallest buffer that holds a chunk with one thing */
+#define SNAPSHOT_MIN_BUFFER_BYTES               (192)
+
+/* Buffers of the snapshot: one MQTT message holds all things of the default
+ * fleet, console chunks have to fit in one log message with the time and task
+ * name the logging task puts in front */
+#define SNAPSHOT_MQTT_BUFFER_BYTES              (2560)
+#define SNAPSHOT_CONSOLE_BUFFER_BYTES           (configLOGGING_MAX_MESSAGE_LENGTH - 48)
+#define SNAPSHOT_RAM_BYTES                      (SNAPSHOT_MQTT_BUFFER_BYTES + SNAPSHOT_CONSOLE_BUFFER_BYTES)
+
+/***************************************
+*            Types
+****************************************/
+/* Receives each chunk of the snapshot, a complete JSON document */
+typedef void (*snapshot_sink_t)(const char *chunk, uint16_t length, void *context);
+
+/***************************************
+*      Function Declarations
+****************************************/
+uint8_t snapshot_write(char *buffer, size_t size, snapshot_sink_t sink, void *context);
+
+#endif /* SOURCE_SNAPSHOT_OPERATION_H_ */
@@ -14,6 +14,10 @@
 *******************************************************************************
 * $ Copyright 2020-2021 Cypress Semiconductor $
 *******************************************************************************/
+#include <string.h>
+#if defined(__GNUC__) && !defined(__ARMCC_VERSION)
+#include <malloc.h>
+#endif
 #include "cyhal.h"
 #include "cybsp.h"
 #include "FreeRTOS.h"
@@ -27,21 +31,29 @@
 #include "mqtt_operation.h"
 #include "console_operation.h"
 #include "afe_shield_operation.h"
+#include "history_operation.h"
+#include "fleet_operation.h"
+#include "notify_operation.h"
+#include "kv_operation.h"
+#include "display_interface.h"
+#include "heap_operation.h"
+#include "snapshot_operation.h"
+#include "filter_operation.h"
 
 /***************************************
 *            Defines
 ****************************************/
 /* Thread stack size and priorities */
-#define CAPSENSE_THREAD_STACK_SIZE              (1024*2)
-#define CAPSENSE_THREAD_PRIORITY                (tskIDLE_PRIORITY + 2)
-#define WEATHER_DATA_THREAD_STACK_SIZE          (1024)
-#define WEATHER_DATA_THREAD_PRIORITY            (tskIDLE_PRIORITY + 2)
+#define AFE_THREAD_STACK_SIZE                   (1024)
+#define AFE_THREAD_PRIORITY                     (tskIDLE_PRIORITY + 2)
 #define DISPLAY_THREAD_STACK_SIZE               (1024*4)
 #define DISPLAY_THREAD_PRIORITY                 (tskIDLE_PRIORITY + 3)
 #define PUBLISH_THREAD_STACK_SIZE               (1024*2)
 #define PUBLISH_THREAD_PRIORITY                 (tskIDLE_PRIORITY + 1)
 #define COMMAND_THREAD_STACK_SIZE               (1024*2)
 #define COMMAND_THREAD_PRIORITY                 (tskIDLE_PRIORITY + 3)
+#define PERSIST_THREAD_STACK_SIZE               (1024)
+#define PERSIST_THREAD_PRIORITY                 (tskIDLE_PRIORITY + 1)
 
 /* Publish weather data every 30 seconds */
 #define MESSAGE_PUBLISH_INTERVAL_MS             (30000)
@@ -54,19 +66,90 @@
 #define MECH_BTN1                               (CYBSP_D4)
 #define MECH_BTN2                               (CYBSP_D12)
 
+/* Mutexes and semaphores of the application: I2C grants of the AFE and the
+ * display, I2C transfer complete, history, key-value store, console and emWin */
+#define APP_SEMAPHORES                          (7)
+
+/* RAM budget, the RTOS objects and buffers that STATIC_ALLOCATION puts in
+ * static memory and the other large buffers of the application */
+#define THREAD_RAM_BYTES(stack_size)            (((stack_size) * sizeof(StackType_t)) + sizeof(StaticTask_t))
+#define QUEUE_RAM_BYTES                         ((QUEUE_SIZE * PUBLISH_CMD_SIZE_BYTES) + sizeof(StaticQueue_t))
+#define TIMER_RAM_BYTES                         (sizeof(StaticTimer_t))
+#define SEMAPHORE_RAM_BYTES                     (APP_SEMAPHORES * sizeof(StaticSemaphore_t))
+#define DISPLAY_RAM_BYTES                       (GUI_NUMBYTES + DISPLAY_STREAM_BYTES + 1)
+#define RAM_BUDGET_TOTAL_BYTES                  (THREAD_RAM_BYTES(AFE_THREAD_STACK_SIZE) + \
+                                                 THREAD_RAM_BYTES(DISPLAY_THREAD_STACK_SIZE) + \
+                                                 THREAD_RAM_BYTES(PERSIST_THREAD_STACK_SIZE) + \
+                                                 THREAD_RAM_BYTES(PUBLISH_THREAD_STACK_SIZE) + \
+                                                 THREAD_RAM_BYTES(COMMAND_THREAD_STACK_SIZE) + \
+                                                 QUEUE_RAM_BYTES + TIMER_RAM_BYTES + SEMAPHORE_RAM_BYTES + \
+                                                 DISPLAY_RAM_BYTES + sizeof(iot_fleet_t) + \
+                                                 HISTORY_RAM_BYTES + KV_RAM_BYTES + SNAPSHOT_RAM_BYTES + \
+                                                 SHADOW_MIRROR_RAM_BYTES + HEAP_RAM_BYTES)
+
+#if STATIC_ALLOCATION
+_Static_assert(RAM_BUDGET_TOTAL_BYTES <= STATIC_RAM_BUDGET_BYTES,
+               "The static RAM of the application is over STATIC_RAM_BUDGET_BYTES");
+
+/* Memory of a thread created with start_thread */
+#define THREAD_MEMORY(name)                     (name##_stack), (&name##_task)
+#else
+#define THREAD_MEMORY(name)                     NULL, NULL
+#endif
+
 /***************************************
 *          Global Variables
 ****************************************/
-iot_data_t iot_data[MAX_THING + 1];  /* Array to hold data from all IoT things */
+iot_fleet_t iot_fleet;  /* Data from all IoT things */
 /* Handle of the MQTT connection used in this demo. */
 IotMqttConnection_t mqtt_connection = IOT_MQTT_CONNECTION_INITIALIZER;
 
 /* RTOS constructs */
-SemaphoreHandle_t display_semaphore;
-SemaphoreHandle_t i2c_mutex;
 QueueHandle_t pub_queue;
 TimerHandle_t message_timer;
 
+#if STATIC_ALLOCATION
+/* Memory of the RTOS constructs */
+static StackType_t afe_stack[AFE_THREAD_STACK_SIZE];
+static StaticTask_t afe_task;
+static StackType_t display_stack[DISPLAY_THREAD_STACK_SIZE];
+static StaticTask_t display_task;
+static StackType_t persist_stack[PERSIST_THREAD_STACK_SIZE];
+static StaticTask_t persist_task;
+static StackType_t publish_stack[PUBLISH_THREAD_STACK_SIZE];
+static StaticTask_t publish_task;
+static StackType_t command_stack[COMMAND_THREAD_STACK_SIZE];
+static StaticTask_t command_task;
+static uint8_t pub_queue_storage[QUEUE_SIZE * PUBLISH_CMD_SIZE_BYTES];
+static StaticQueue_t pub_queue_buffer;
+static StaticTimer_t message_timer_buffer;
+#endif
+
+/* RAM budget, printed by the console */
+const ram_budget_t ram_budget[] =
+{
+    { "AFE thread",             THREAD_RAM_BYTES(AFE_THREAD_STACK_SIZE) },
+    { "Display thread",         THREAD_RAM_BYTES(DISPLAY_THREAD_STACK_SIZE) },
+    { "Persist thread",         THREAD_RAM_BYTES(PERSIST_THREAD_STACK_SIZE) },
+    { "Publish thread",         THREAD_RAM_BYTES(PUBLISH_THREAD_STACK_SIZE) },
+    { "Command thread",         THREAD_RAM_BYTES(COMMAND_THREAD_STACK_SIZE) },
+    { "Publish queue",          QUEUE_RAM_BYTES },
+    { "Publish timer",          TIMER_RAM_BYTES },
+    { "Semaphores",             SEMAPHORE_RAM_BYTES },
+    { "Display",                DISPLAY_RAM_BYTES },
+    { "Thing data",             sizeof(iot_fleet_t) },
+    { "History",                HISTORY_RAM_BYTES },
+    { "Key-value store",        KV_RAM_BYTES },
+    { "Snapshot buffers",       SNAPSHOT_RAM_BYTES },
+    { "Shadow mirrors",         SHADOW_MIRROR_RAM_BYTES },
+    { "Heap pool",              HEAP_RAM_BYTES },
+    { "Total",                  RAM_BUDGET_TOTAL_BYTES },
+};
+const uint8_t ram_budget_lines = sizeof(ram_budget) / sizeof(ram_budget[0]);
+
+/* Heap in use once all threads are started */
+size_t heap_used_after_init;
+
 /***************************************
 *          Forward Declaration
 ****************************************/
@@ -77,6 +160,9 @@ void alert_button_isr(void *callback_arg, cyhal_gpio_event_t event);
 /* Callback functions */
 void publish30sec(TimerHandle_t xTimer);
 
+static void start_thread(TaskFunction_t thread, const char *name, uint32_t stack_size,
+                         UBaseType_t priority, StackType_t *stack, StaticTask_t *task);
+
 int RunApplication(bool awsIotMqttMode,
                    const char * pIdentifier,
                    void * pNetworkServerInfo,
@@ -129,74 +215,78 @@ int RunApplication(bool awsIotMqttMode,
     /* variable to store IP address */
     uint8_t ucTempIp[4] = { 0 };
 
-    /* variable to control loop statements */
-    int loop;
-
     /* Topics used as both topic filters and topic names in this demo. */
     const char * pTopics[ TOPIC_FILTER_COUNT ] =
     {
         "$aws/things/+/shadow/update/documents",
-        "$aws/things/+/shadow/get/accepted"
+        "$aws/things/+/shadow/get/accepted",
+        FLEET_TOPIC_HEAD "+/fleet/get",
+        FLEET_TOPIC_HEAD "+/filter/set"
     };
 
     /* Length of topic names as per pTopics array */
     const uint16_t pTopicsSize[ TOPIC_FILTER_COUNT ] =
     {
         (uint16_t)sizeof("$aws/things/+/shadow/update/documents") - 1,
-        (uint16_t)sizeof("$aws/things/+/shadow/get/accepted") - 1
+        (uint16_t)sizeof("$aws/things/+/shadow/get/accepted") - 1,
+        (uint16_t)sizeof(FLEET_TOPIC_HEAD "+/fleet/get") - 1,
+        (uint16_t)sizeof(FLEET_TOPIC_HEAD "+/filter/set") - 1
     };
 
+#if STATIC_ALLOCATION
+    /* Setup Thread Control entities */
+    pub_queue = xQueueCreateStatic( QUEUE_SIZE, PUBLISH_CMD_SIZE_BYTES, pub_queue_storage, &pub_queue_buffer );
+#else
     /* Setup Thread Control entities */
-    display_semaphore = xSemaphoreCreateBinary();
     pub_queue = xQueueCreate( QUEUE_SIZE, PUBLISH_CMD_SIZE_BYTES );
+#endif
 
-    /* Mutex to secure I2C object use */
-    i2c_mutex = xSemaphoreCreateMutex();
+    /* Initialize the data of all things: no alert, no values and IP 0.0.0.0 */
+    memset(&iot_fleet, 0, sizeof(iot_fleet));
+    fleet_init();
+    filter_init();
 
-    /* Initialize all of the thing data structures */
-    for(loop = 0; loop <= MAX_THING; loop++)
+    /* Warm start with the settings and the data of all things saved in flash */
+    if(kv_init())
+    {
+        kv_restore_state();
+    }
+    else
     {
-        iot_data[loop].thingNumber = loop;
-        snprintf(iot_data[loop].ip_str, sizeof(iot_data[loop].ip_str), "0.0.0.0");
-        iot_data[loop].alert = false;
-        iot_data[loop].temp = 0.0;
-        iot_data[loop].humidity = 0.0;
-        iot_data[loop].light = 0.0;
+        configPRINTF(("Failed to open the key-value store\r\n"));
     }
 
+    /* Start with an empty history of the weather data */
+    history_init();
+
     /* Get IP Address for MyThing and save in the Thing data structure */
     WIFI_GetIP( ucTempIp );
-    snprintf(iot_data[MY_THING].ip_str,
-             sizeof(iot_data[MY_THING].ip_str),
-             "%d.%d.%d.%d",
-             ucTempIp[ 0 ],
-             ucTempIp[ 1 ],
-             ucTempIp[ 2 ],
-             ucTempIp[ 3 ]);
+    iot_fleet.ip[MY_THING] = ((uint32_t)ucTempIp[ 0 ] << 24) |
+                             ((uint32_t)ucTempIp[ 1 ] << 16) |
+                             ((uint32_t)ucTempIp[ 2 ] << 8)  |
+                             (uint32_t)ucTempIp[ 3 ];
 
     /* Initialize emWin GUI */
     GUI_Init();
 
     /* Start threads that interact with the shield (PSoC and OLED) */
-    /* Start threads that interact with the shield (PSoC and OLED) */
-    xTaskCreate( getCapSenseThread,
-                 "CapSense Thread",
-                 CAPSENSE_THREAD_STACK_SIZE,
-                 0,
-                 CAPSENSE_THREAD_PRIORITY,
-                 0);
-    xTaskCreate( getWeatherDataThread,
-                 "Weather Data Thread",
-                 WEATHER_DATA_THREAD_STACK_SIZE,
-                 0,
-                 WEATHER_DATA_THREAD_PRIORITY,
-                 0);
-    xTaskCreate( displayThread,
-                 "Display Thread",
-                 DISPLAY_THREAD_STACK_SIZE,
-                 0,
-                 DISPLAY_THREAD_PRIORITY,
-                 0);
+    start_thread( afeThread,
+                  "AFE Thread",
+                  AFE_THREAD_STACK_SIZE,
+                  AFE_THREAD_PRIORITY,
+                  THREAD_MEMORY(afe));
+    start_thread( displayThread,
+                  "Display Thread",
+                  DISPLAY_THREAD_STACK_SIZE,
+                  DISPLAY_THREAD_PRIORITY,
+                  THREAD_MEMORY(display));
+
+    /* Start the thread that saves the state to flash */
+    start_thread( persistThread,
+                  "Persist Thread",
+                  PERSIST_THREAD_STACK_SIZE,
+                  PERSIST_THREAD_PRIORITY,
+                  THREAD_MEMORY(persist));
 
      /* Initialize the MQTT libraries required for this demo. */
     InitializeMqtt();
@@ -217,24 +307,26 @@ int RunApplication(bool awsIotMqttMode,
                          NULL );
 
     /* Start the publish thread */
-   xTaskCreate( publishThread,
-                "Publish Thread",
-                PUBLISH_THREAD_STACK_SIZE,
-                0,
-                PUBLISH_THREAD_PRIORITY,
-                0);
+    start_thread( publishThread,
+                  "Publish Thread",
+                  PUBLISH_THREAD_STACK_SIZE,
+                  PUBLISH_THREAD_PRIORITY,
+                  THREAD_MEMORY(publish));
 
      /* Create and start timer to publish weather data every 30 seconds */
+#if STATIC_ALLOCATION
+    message_timer = xTimerCreateStatic("Timer", MESSAGE_PUBLISH_INTERVAL_MS, true, NULL, publish30sec, &message_timer_buffer);
+#else
     message_timer = xTimerCreate("Timer", MESSAGE_PUBLISH_INTERVAL_MS, true, NULL, publish30sec);
+#endif
     xTimerStart(message_timer, 0);
 
     /*Start command thread to display help info on terminal window */
-    xTaskCreate( commandThread,
-                 "Command Thread",
-                 COMMAND_THREAD_STACK_SIZE,
-                 0,
-                 COMMAND_THREAD_PRIORITY,
-                 0);
+    start_thread( commandThread,
+                  "Command Thread",
+                  COMMAND_THREAD_STACK_SIZE,
+                  COMMAND_THREAD_PRIORITY,
+                  THREAD_MEMORY(command));
 
     /* Configure and setup interrupts for the 2 mechanical buttons */
     cyhal_gpio_init(MECH_BTN1, CYHAL_GPIO_DIR_INPUT, CYHAL_GPIO_DRIVE_PULLUP, 1);
@@ -245,12 +337,64 @@ int RunApplication(bool awsIotMqttMode,
     cyhal_gpio_register_callback(MECH_BTN2, publish_button_isr, NULL);
     cyhal_gpio_enable_event(MECH_BTN2, CYHAL_GPIO_IRQ_FALL, 3, true);
 
+    /* Everything the application allocates is allocated by now */
+    heap_used_after_init = heap_used();
+
     /* Suspend this task to prevent network connection resources from being cleaned up */
     vTaskSuspend( NULL );
 
     return 0;
 }
 
+/*************** Start Thread ***************/
+/*
+ * Summary: Create a thread, in the given memory with STATIC_ALLOCATION and on
+ * the heap otherwise.
+ *
+ *  @param[in] thread The function of the thread.
+ *  @param[in] name The name of the thread.
+ *  @param[in] stack_size The stack size in words.
+ *  @param[in] priority The priority of the thread.
+ *  @param[in] stack The stack of stack_size words, NULL without STATIC_ALLOCATION.
+ *  @param[in] task The task control block, NULL without STATIC_ALLOCATION.
+ */
+static void start_thread(TaskFunction_t thread, const char *name, uint32_t stack_size,
+                         UBaseType_t priority, StackType_t *stack, StaticTask_t *task)
+{
+#if STATIC_ALLOCATION
+    xTaskCreateStatic(thread, name, stack_size, NULL, priority, stack, task);
+#else
+    ( void )stack; /* Suppress compiler warning */
+    ( void )task;
+    xTaskCreate(thread, name, (uint16_t)stack_size, NULL, priority, NULL);
+#endif
+}
+
+/*************** Heap Used ***************/
+/*
+ * Summary: Get the bytes allocated from the heap, by the application and the
+ * libraries. The heap is the heap of the application with APP_HEAP and the C
+ * library heap (heap_3) otherwise. Only the C library of GCC_ARM (newlib) has
+ * mallinfo, so with IAR and ARM the C library heap isn't measured.
+ *
+ *  @return Bytes in use, 0 if the heap isn't measured.
+ */
+size_t heap_used(void)
+{
+#if APP_HEAP
+    heap_stats_t stats;
+
+    heap_get_stats(&stats);
+    return stats.used_bytes;
+#elif defined(__GNUC__) && !defined(__ARMCC_VERSION)
+    struct mallinfo info = mallinfo();
+
+    return (size_t)info.uordblks;
+#else
+    return 0;
+#endif
+}
+
 /*************** Weather Publish Button ISR ***************/
 /*
  * Summary: ISR called when publish button is pressed.
@@ -293,25 +437,21 @@ void alert_button_isr(void *callback_arg, cyhal_gpio_event_t event)
     /* Command pushed onto the queue to determine what to publish */
     char pubCmd[PUBLISH_CMD_SIZE_BYTES];
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    UBaseType_t savedInterruptStatus;
 
     if(0UL != ( CYHAL_GPIO_IRQ_FALL & event))
     {
-        if(iot_data[MY_THING].alert == true)
-         {
-            iot_data[MY_THING].alert = false;
-         }
-         else
-         {
-             iot_data[MY_THING].alert = true;
-         }
+        savedInterruptStatus = iot_data_write_begin_from_isr(MY_THING);
+        iot_fleet.alert[THING_WORD(MY_THING)] ^= THING_BIT(MY_THING);
+        iot_data_write_end_from_isr(MY_THING, savedInterruptStatus);
 
         pubCmd[0] = ALERT_CMD;
 
         /* Publish the alert */
         xQueueSendFromISR(pub_queue, pubCmd, &xHigherPriorityTaskWoken);
 
-        /* Set a semaphore for the OLED to update the display */
-        xSemaphoreGiveFromISR(display_semaphore, &xHigherPriorityTaskWoken);
+        /* Tell the OLED to update the alert */
+        notify_publish_from_isr(MY_THING, NOTIFY_ALERT, &xHigherPriorityTaskWoken);
     }
 
     /* If xHigherPriorityTaskWoken was set to true you we should yield. */
@@ -335,3 +475,252 @@ void publish30sec(TimerHandle_t xTimer)
     pubCmd[0] = WEATHER_CMD;
     xQueueSend(pub_queue, pubCmd, portMAX_DELAY); /* Push value onto queue*/
 }
+
+/*************** Thing Data Sequence Lock ***************/
+/*
+ * Summary: The thing records are protected by a sequence counter per thing.
+ * Writers make the counter odd, update the record and make it even again, all
+ * inside a critical section so that writers never interleave. Readers copy
+ * the record without locking and retry if the counter was odd or changed
+ * while they copied, so they always get a consistent snapshot. The fleet
+ * aggregates take the old data of the thing out at the begin of a write and
+ * add the new data at the end.
+ */
+static volatile uint32_t iot_data_sequence[MAX_THING + 1];
+
+/*************** Begin Thing Data Write ***************/
+/*
+ * Summary: Start an update of a thing record from a task. Keep the update
+ * short, it runs inside a critical section.
+ *
+ *  @param[in] thingNumber The number of the thing to update.
+ */
+void iot_data_write_begin(uint8_t thingNumber)
+{
+    taskENTER_CRITICAL();
+    iot_data_sequence[thingNumber]++;
+    __DMB();
+    fleet_remove(thingNumber);
+}
+
+/*************** End Thing Data Write ***************/
+/*
+ * Summary: Publish an update started with iot_data_write_begin.
+ *
+ *  @param[in] thingNumber The number of the thing that was updated.
+ */
+void iot_data_write_end(uint8_t thingNumber)
+{
+    fleet_add(thingNumber);
+    __DMB();
+    iot_data_sequence[thingNumber]++;
+    taskEXIT_CRITICAL();
+}
+
+/*************** Begin Thing Data Write from ISR ***************/
+/*
+ * Summary: Start an update of a thing record from an ISR.
+ *
+ *  @param[in] thingNumber The number of the thing to update.
+ *
+ *  @return The interrupt mask to pass to iot_data_write_end_from_isr.
+ */
+UBaseType_t iot_data_write_begin_from_isr(uint8_t thingNumber)
+{
+    UBaseType_t savedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+
+    iot_data_sequence[thingNumber]++;
+    __DMB();
+    fleet_remove(thingNumber);
+    return savedInterruptStatus;
+}
+
+/*************** End Thing Data Write from ISR ***************/
+/*
+ * Summary: Publish an update started with iot_data_write_begin_from_isr.
+ *
+ *  @param[in] thingNumber The number of the thing that was updated.
+ *  @param[in] savedInterruptStatus The value returned by the begin call.
+ */
+void iot_data_write_end_from_isr(uint8_t thingNumber, UBaseType_t savedInterruptStatus)
+{
+    fleet_add(thingNumber);
+    __DMB();
+    iot_data_sequence[thingNumber]++;
+    taskEXIT_CRITICAL_FROM_ISR(savedInterruptStatus);
+}
+
+/*************** Thing Data Snapshot ***************/
+/*
+ * Summary: Copy a thing record without locking. The copy is repeated until no
+ * write overlapped it.
+ *
+ *  @param[in] thingNumber The number of the thing to read.
+ *  @param[out] snapshot Consistent copy of the thing record.
+ */
+void iot_data_snapshot(uint8_t thingNumber, iot_data_t *snapshot)
+{
+    uint32_t sequence;
+
+    do
+    {
+        sequence = iot_data_sequence[thingNumber];
+        __DMB();
+        snapshot->thingNumber = thingNumber;
+        snapshot->alert = ((iot_fleet.alert[THING_WORD(thingNumber)] & THING_BIT(thingNumber)) != 0);
+        snapshot->temp = iot_fleet.temp[thingNumber];
+        snapshot->humidity = iot_fleet.humidity[thingNumber];
+        snapshot->light = iot_fleet.light[thingNumber];
+        snapshot->ip = iot_fleet.ip[thingNumber];
+        __DMB();
+    } while((sequence & 1u) || (sequence != iot_data_sequence[thingNumber]));
+}
+
+/*************** Store Thing Data ***************/
+/*
+ * Summary: Write all fields of a thing record. Call it between
+ * iot_data_write_begin and iot_data_write_end.
+ *
+ *  @param[in] thingNumber The number of the thing to update.
+ *  @param[in] thing The new data of the thing.
+ */
+void iot_data_store(uint8_t thingNumber, const iot_data_t *thing)
+{
+    if(thing->alert)
+    {
+        iot_fleet.alert[THING_WORD(thingNumber)] |= THING_BIT(thingNumber);
+    }
+    else
+    {
+        iot_fleet.alert[THING_WORD(thingNumber)] &= ~THING_BIT(thingNumber);
+    }
+    iot_fleet.temp[thingNumber] = thing->temp;
+    iot_fleet.humidity[thingNumber] = thing->humidity;
+    iot_fleet.light[thingNumber] = thing->light;
+    iot_fleet.ip[thingNumber] = thing->ip;
+}
+
+/*************** Convert to Fixed Point ***************/
+/*
+ * Summary: Scale and round a weather value, saturating at the int16 range.
+ *
+ *  @param[in] value The value to convert.
+ *  @param[in] scale The fixed-point scale of the value.
+ *
+ *  @return The fixed-point value.
+ */
+int16_t iot_data_to_fixed(float value, int32_t scale)
+{
+    float scaled = value * (float)scale;
+
+    if(scaled >= (float)INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if(scaled <= (float)INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)((scaled < 0) ? (scaled - 0.5f) : (scaled + 0.5f));
+}
+
+/*************** Format IP Address ***************/
+/*
+ * Summary: Write an IPv4 address in dotted decimal.
+ *
+ *  @param[in] ip The address, first octet in the top byte.
+ *  @param[out] ip_str Buffer of IP_STR_LEN characters.
+ */
+void iot_data_format_ip(uint32_t ip, char *ip_str)
+{
+    snprintf(ip_str, IP_STR_LEN, "%u.%u.%u.%u",
+             (unsigned int)((ip >> 24) & 0xFF),
+             (unsigned int)((ip >> 16) & 0xFF),
+             (unsigned int)((ip >> 8) & 0xFF),
+             (unsigned int)(ip & 0xFF));
+}
+
+/*************** Parse IP Address ***************/
+/*
+ * Summary: Read an IPv4 address in dotted decimal.
+ *
+ *  @param[in] ip_str The address as a string.
+ *  @param[out] ip The address, first octet in the top byte.
+ *
+ *  @return false if the string isn't four octets separated by dots.
+ */
+bool iot_data_parse_ip(const char *ip_str, uint32_t *ip)
+{
+    uint32_t address = 0;
+    uint32_t octet;
+    uint8_t digits;
+    uint8_t loop;
+
+    for(loop = 0; loop < 4; loop++)
+    {
+        octet = 0;
+        for(digits = 0; (*ip_str >= '0') && (*ip_str <= '9'); digits++, ip_str++)
+        {
+            octet = (octet * 10) + (uint32_t)(*ip_str - '0');
+            if((digits >= 3) || (octet > 255))
+            {
+                return false;
+            }
+        }
+        if((digits == 0) || (*ip_str != ((loop < 3) ? '.' : '\0')))
+        {
+            return false;
+        }
+        ip_str++;
+        address = (address << 8) | octet;
+    }
+
+    *ip = address;
+    return true;
+}
+
+/*************** Count Alerts ***************/
+/*
+ * Summary: Count the things with the weather alert on, a word of the alert
+ * bitset at a time.
+ *
+ *  @return The number of things with the alert on.
+ */
+uint8_t iot_fleet_alert_count(void)
+{
+    uint32_t word;
+    uint8_t count = 0;
+    uint8_t loop;
+
+    for(loop = 0; loop < THING_BITSET_WORDS; loop++)
+    {
+        for(word = iot_fleet.alert[loop]; word != 0; word &= word - 1)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*************** Find Hottest Thing ***************/
+/*
+ * Summary: Find the thing with the highest temperature. The values are read
+ * without the sequence lock, which is fine for a scan as each one is read in
+ * a single access.
+ *
+ *  @return The number of the hottest thing, the lowest number on a tie.
+ */
+uint8_t iot_fleet_hottest(void)
+{
+    uint8_t hottest = 0;
+    uint8_t loop;
+
+    for(loop = 1; loop <= MAX_THING; loop++)
+    {
+        if(iot_fleet.temp[loop] > iot_fleet.temp[hottest])
+        {
+            hottest = loop;
+        }
+    }
+    return hottest;
+}
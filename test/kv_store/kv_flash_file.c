@@ -0,0 +1,192 @@
+/******************************************************************************
+* File Name: kv_flash_file.c
+*
+* Description: This file contains the flash of the key-value store emulated
+* in a file on the host. Like the PSoC 6 flash, a row write erases the row to
+* 0 and then programs it. A power cut can be set up to stop a row write after
+* some bytes: the rest of the row stays erased and the flash fails until the
+* power is back.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "kv_flash_file.h"
+
+/***************************************
+*          Global Variables
+****************************************/
+static FILE *flash_file;
+
+/* Power cut: writes to let through, then bytes of the next write to program */
+static bool cut_armed;
+static uint32_t cut_writes;
+static uint16_t cut_bytes;
+static bool power_lost;
+
+/*************** Program Bytes ***************/
+/*
+ * Summary: Put bytes into a row of the file.
+ *
+ *  @param[in] row The row.
+ *  @param[in] offset Offset in the row.
+ *  @param[in] data The bytes.
+ *  @param[in] length Number of bytes.
+ *
+ *  @return false if the file couldn't be written.
+ */
+static bool program_bytes(uint8_t row, uint16_t offset, const void *data, uint16_t length)
+{
+    if(fseek(flash_file, ((long)row * KV_ROW_SIZE) + offset, SEEK_SET) != 0)
+    {
+        return false;
+    }
+    return (fwrite(data, 1, length, flash_file) == length) && (fflush(flash_file) == 0);
+}
+
+/*************** Flash Read ***************/
+/*
+ * Summary: Read from a row of the file.
+ *
+ *  @param[in] row The row.
+ *  @param[in] offset Offset in the row.
+ *  @param[out] data Buffer for the bytes.
+ *  @param[in] length Number of bytes.
+ *
+ *  @return false if the power is lost or the read failed.
+ */
+static bool flash_read(uint8_t row, uint16_t offset, void *data, uint16_t length)
+{
+    if(power_lost || (row >= KV_ROWS) || ((offset + length) > KV_ROW_SIZE))
+    {
+        return false;
+    }
+    if(fseek(flash_file, ((long)row * KV_ROW_SIZE) + offset, SEEK_SET) != 0)
+    {
+        return false;
+    }
+    return (fread(data, 1, length, flash_file) == length);
+}
+
+/*************** Flash Erase ***************/
+/*
+ * Summary: Erase a row of the file to 0.
+ *
+ *  @param[in] row The row.
+ *
+ *  @return false if the power is lost or the write failed.
+ */
+static bool flash_erase(uint8_t row)
+{
+    static const uint8_t erased[KV_ROW_SIZE] = { 0 };
+
+    if(power_lost || (row >= KV_ROWS))
+    {
+        return false;
+    }
+    return program_bytes(row, 0, erased, KV_ROW_SIZE);
+}
+
+/*************** Flash Write ***************/
+/*
+ * Summary: Erase a row of the file and program it, or only the start of it
+ * if the power is cut during this write.
+ *
+ *  @param[in] row The row.
+ *  @param[in] data KV_ROW_SIZE bytes for the row.
+ *
+ *  @return false if the power is lost or the write failed.
+ */
+static bool flash_write(uint8_t row, const uint32_t *data)
+{
+    if(!flash_erase(row))
+    {
+        return false;
+    }
+    if(cut_armed && (cut_writes-- == 0))
+    {
+        cut_armed = false;
+        power_lost = true;
+        ( void )program_bytes(row, 0, data, cut_bytes);
+        return false;
+    }
+    return program_bytes(row, 0, data, KV_ROW_SIZE);
+}
+
+/* Flash of the store in the file */
+const kv_flash_ops_t kv_flash_file_ops = { flash_read, flash_write, flash_erase };
+
+/*************** Open Flash File ***************/
+/*
+ * Summary: Create the file of the flash with all rows erased.
+ *
+ *  @param[in] path Path of the file.
+ *
+ *  @return false if the file couldn't be created.
+ */
+bool kv_flash_file_open(const char *path)
+{
+    uint8_t row;
+
+    flash_file = fopen(path, "w+b");
+    if(flash_file == NULL)
+    {
+        return false;
+    }
+    kv_flash_file_power_on();
+    for(row = 0; row < KV_ROWS; row++)
+    {
+        if(!flash_erase(row))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*************** Close Flash File ***************/
+/*
+ * Summary: Close the file of the flash.
+ */
+void kv_flash_file_close(void)
+{
+    fclose(flash_file);
+    flash_file = NULL;
+}
+
+/*************** Cut Power ***************/
+/*
+ * Summary: Cut the power during a later row write.
+ *
+ *  @param[in] writes Row writes that complete before the cut.
+ *  @param[in] bytes Bytes of the cut write that are programmed, below
+ *  KV_ROW_SIZE.
+ */
+void kv_flash_file_cut(uint32_t writes, uint16_t bytes)
+{
+    cut_armed = true;
+    cut_writes = writes;
+    cut_bytes = bytes;
+}
+
+/*************** Power Lost ***************/
+/*
+ * Summary: Tell if the power was cut.
+ *
+ *  @return true from the cut until the power is back.
+ */
+bool kv_flash_file_power_lost(void)
+{
+    return power_lost;
+}
+
+/*************** Power On ***************/
+/*
+ * Summary: Bring the power back and drop a cut that didn't happen.
+ */
+void kv_flash_file_power_on(void)
+{
+    power_lost = false;
+    cut_armed = false;
+}
@@ -0,0 +1,27 @@
+/******************************************************************************
+* File Name: kv_flash_file.h
+*
+* Description: This file contains declarations related to the flash of the
+* key-value store emulated in a file on the host, with power cuts in the
+* middle of a row write.
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#ifndef TEST_KV_FLASH_FILE_H_
+#define TEST_KV_FLASH_FILE_H_
+
+#include "kv_store_operation.h"
+
+/***************************************
+*      Function Declarations
+****************************************/
+bool kv_flash_file_open(const char *path);
+void kv_flash_file_close(void);
+void kv_flash_file_cut(uint32_t writes, uint16_t bytes);
+bool kv_flash_file_power_lost(void);
+void kv_flash_file_power_on(void);
+
+extern const kv_flash_ops_t kv_flash_file_ops;
+
+#endif /* TEST_KV_FLASH_FILE_H_ */
@@ -0,0 +1,304 @@
+/******************************************************************************
+* File Name: kv_store_test.c
+*
+* Description: This file contains a host test of the log of records of the
+* key-value store on the flash emulated in a file.
+*
+* Random sets, deletes and commits are checked against a model of the keys,
+* and the store is read back from the file after commits. Then the power is
+* cut in the middle of row writes, also of the rows written by compaction,
+* and after reading the file back every key has to hold its value of the last
+* commit or a value set after it.
+*
+* Usage: kv_store_test [seed]
+*
+*******************************************************************************
+* $ Copyright 2020-2021 Cypress Semiconductor $
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kv_flash_file.h"
+
+/***************************************
+*            Defines
+****************************************/
+#define FLASH_FILE                              "kv_flash.bin"
+
+/* Steps of the test without and with power cuts */
+#define STEPS                                   (20000)
+#define CUTS                                    (3000)
+
+/* Values a key can have after a power cut */
+#define CANDIDATES                              (32)
+
+/* Length of a deleted key in the model */
+#define DELETED                                 (0xFFFF)
+
+/* Stop the test when a check fails */
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if(!(condition))                                                        \
+        {                                                                       \
+            printf("%s:%d: check failed: %s (seed %lu, step %lu)\n",            \
+                   __FILE__, __LINE__, #condition, seed, step);                 \
+            exit(1);                                                            \
+        }                                                                       \
+    } while(0)
+
+/***************************************
+*            Types
+****************************************/
+/* A value of a key, the bytes follow from the stamp */
+typedef struct {
+    uint32_t stamp;
+    uint16_t length;                            /* DELETED for a deleted key */
+} value_t;
+
+/* A key in the model */
+typedef struct {
+    value_t current;                            /* Value of the last set or delete */
+    value_t candidates[CANDIDATES];             /* Values it may have after a power cut */
+    uint8_t count;
+} model_key_t;
+
+/***************************************
+*          Global Variables
+****************************************/
+static unsigned long seed = 1;
+static unsigned long step;
+static uint32_t random_state;
+static uint32_t stamp;
+
+static model_key_t model[KV_MAX_KEYS + 1];
+
+/*************** Random Number ***************/
+/*
+ * Summary: Next number of a xorshift generator.
+ *
+ *  @param[in] range Numbers are below it.
+ *
+ *  @return The number.
+ */
+static uint32_t random_below(uint32_t range)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state % range;
+}
+
+/*************** Fill Value ***************/
+/*
+ * Summary: Bytes of a value.
+ *
+ *  @param[in] key The key.
+ *  @param[in] value The value.
+ *  @param[out] bytes Buffer for the bytes.
+ */
+static void fill_value(uint16_t key, const value_t *value, uint8_t *bytes)
+{
+    uint16_t loop;
+
+    for(loop = 0; loop < value->length; loop++)
+    {
+        bytes[loop] = (uint8_t)((value->stamp * 31u) + (loop * 7u) + key);
+    }
+}
+
+/*************** Holds Value ***************/
+/*
+ * Summary: Tell if the store holds a value for a key.
+ *
+ *  @param[in] key The key.
+ *  @param[in] value The value.
+ *
+ *  @return true if the value in the store is the same.
+ */
+static bool holds_value(uint16_t key, const value_t *value)
+{
+    uint8_t expected[KV_MAX_VALUE];
+    uint8_t actual[KV_MAX_VALUE];
+    int32_t length = kv_store_get(key, actual, sizeof(actual));
+
+    if(value->length == DELETED)
+    {
+        return (length == -1);
+    }
+    fill_value(key, value, expected);
+    return (length == value->length) && (memcmp(expected, actual, value->length) == 0);
+}
+
+/*************** Checkpoint ***************/
+/*
+ * Summary: Take the current values of the model as the only values the keys
+ * can have after a power cut.
+ */
+static void checkpoint(void)
+{
+    uint16_t key;
+
+    for(key = 1; key <= KV_MAX_KEYS; key++)
+    {
+        model[key].candidates[0] = model[key].current;
+        model[key].count = 1;
+    }
+}
+
+/*************** Reset ***************/
+/*
+ * Summary: Bring the power back and read the store from the file.
+ */
+static void reset(void)
+{
+    kv_flash_file_power_on();
+    kv_store_init(&kv_flash_file_ops);
+}
+
+/*************** Random Step ***************/
+/*
+ * Summary: Set, delete or commit. The power can be cut during it.
+ *
+ *  @return true if the step was a commit that completed.
+ */
+static bool random_step(void)
+{
+    uint8_t data[KV_MAX_VALUE];
+    uint16_t key = (uint16_t)(1 + random_below(KV_MAX_KEYS));
+    uint32_t choice = random_below(100);
+    value_t value;
+    bool done;
+
+    if((choice >= 75) || (model[key].count == CANDIDATES))
+    {
+        done = kv_store_commit();
+        CHECK(done || kv_flash_file_power_lost());
+        return done;
+    }
+
+    value.stamp = ++stamp;
+    if(choice >= 60)
+    {
+        value.length = DELETED;
+        done = kv_store_delete(key);
+    }
+    else
+    {
+        value.length = (uint16_t)((random_below(4) == 0) ? random_below(KV_MAX_VALUE + 1) : random_below(33));
+        fill_value(key, &value, data);
+        done = kv_store_set(key, data, value.length);
+    }
+    CHECK(done || kv_flash_file_power_lost());
+    if(done)
+    {
+        model[key].current = value;
+        model[key].candidates[model[key].count++] = value;
+        CHECK(holds_value(key, &value));
+    }
+    return false;
+}
+
+/*************** Main ***************/
+/*
+ * Summary: Run the test.
+ *
+ *  @param[in] argc Number of arguments.
+ *  @param[in] argv The seed, optional.
+ *
+ *  @return 0 if all checks passed.
+ */
+int main(int argc, char *argv[])
+{
+    uint8_t data[KV_MAX_VALUE];
+    kv_stats_t stats;
+    uint32_t cuts = 0;
+    uint16_t key;
+    uint8_t loop;
+    uint8_t match;
+
+    if(argc > 1)
+    {
+        seed = strtoul(argv[1], NULL, 0);
+    }
+    random_state = (uint32_t)((seed << 1) | 1u);
+
+    CHECK(kv_flash_file_open(FLASH_FILE));
+    reset();
+    for(key = 1; key <= KV_MAX_KEYS; key++)
+    {
+        model[key].current.length = DELETED;
+    }
+    checkpoint();
+
+    /* Without power cuts the store reads back the same after every commit */
+    for(step = 0; step < STEPS; step++)
+    {
+        if(!random_step())
+        {
+            continue;
+        }
+        checkpoint();
+        if(random_below(4) == 0)
+        {
+            reset();
+            for(key = 1; key <= KV_MAX_KEYS; key++)
+            {
+                CHECK(holds_value(key, &model[key].current));
+            }
+        }
+    }
+
+    /* Rows are written in turn, so they wear evenly */
+    kv_store_get_stats(&stats);
+    printf("%lu steps: %u rows used, erases %lu to %lu\n", step, stats.rows_used,
+           (unsigned long)stats.min_erases, (unsigned long)stats.max_erases);
+    CHECK(stats.min_erases > 0);
+    CHECK((stats.max_erases - stats.min_erases) <= 2);
+
+    /* Cut the power during one of the next row writes and replay the rows */
+    while(cuts < CUTS)
+    {
+        kv_flash_file_cut(random_below(3), (uint16_t)random_below(KV_ROW_SIZE));
+        for(loop = 0; (loop < 50) && !kv_flash_file_power_lost(); loop++, step++)
+        {
+            if(random_step())
+            {
+                checkpoint();
+            }
+        }
+        if(!kv_flash_file_power_lost())
+        {
+            continue;
+        }
+        cuts++;
+
+        reset();
+        for(key = 1; key <= KV_MAX_KEYS; key++)
+        {
+            for(match = 0; match < model[key].count; match++)
+            {
+                if(holds_value(key, &model[key].candidates[match]))
+                {
+                    break;
+                }
+            }
+            CHECK(match < model[key].count);
+            model[key].current = model[key].candidates[match];
+        }
+        checkpoint();
+
+        /* The store keeps working after the cut */
+        model[1].current.stamp = ++stamp;
+        model[1].current.length = 16;
+        fill_value(1, &model[1].current, data);
+        CHECK(kv_store_set(1, data, model[1].current.length) && kv_store_commit());
+        checkpoint();
+    }
+
+    kv_store_get_stats(&stats);
+    printf("%lu power cuts: %u rows used, %u keys\n", (unsigned long)cuts, stats.rows_used, stats.keys);
+    kv_flash_file_close();
+    remove(FLASH_FILE);
+    printf("PASSED (seed %lu)\n", seed);
+    return 0;
+}